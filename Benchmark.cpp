@@ -0,0 +1,628 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <vector>
+#include <atomic>
+
+#include "Host.h"
+#include "Server.h"
+#include "Message.h"
+#include "protocol.h"
+#include "histogram.h"
+#include "buffer_pool.h"
+
+#define DEFAULT_PORT 7001
+#define DEFAULT_CONNECTIONS 1000
+#define DEFAULT_FAN_OUT 100
+#define DEFAULT_RATE 10000
+#define DEFAULT_SIZE 64
+#define DEFAULT_SECONDS 5
+
+/**
+ * number of hex digits of the send time written at the start of every chat
+ *   message.
+ */
+#define STAMP_LEN 16
+
+/**
+ * longest time to wait for connections to be set up, or for messages in
+ *   flight to be delivered, in milliseconds.
+ */
+#define WAIT_TIMEOUT 30000
+
+/**
+ * returns the current time in nanoseconds.
+ */
+static unsigned long long now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+/**
+ * raises the open file limit as far as it goes; both ends of every
+ *   connection are open in this process.
+ */
+static void raise_file_limit()
+{
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE,&limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE,&limit);
+    }
+}
+
+/**
+ * opens connections to the server. the first numReceivers of them join the
+ *   chat room and time the messages they receive; the rest are senders, so
+ *   every message is delivered to exactly numReceivers clients.
+ *
+ * with rooms, every connection joins the chat, and one of the rooms in turn;
+ *   senders say things in their own room, so each message is delivered to
+ *   the other members of that room only.
+ */
+class LoadClient : public Net::Host
+{
+public:
+    LoadClient(int numReceivers, int caps, int numRooms);
+    ~LoadClient();
+    std::vector<int> senderSockets();
+    std::vector<int> senderRooms();
+
+    /**
+     * time it took to deliver each message, in nanoseconds.
+     */
+    Histogram latency;
+
+    /**
+     * number of connections that onConnect was called for.
+     */
+    std::atomic<unsigned long long> connected;
+
+    /**
+     * number of ADD_CLIENT messages received; once every receiver has
+     *   joined, this is numReceivers*(numReceivers+1)/2.
+     */
+    std::atomic<unsigned long long> joined;
+
+    /**
+     * number of JOIN_ROOM messages received; once every connection has
+     *   joined its room, this is k*(k+1)/2 summed over rooms of k members.
+     */
+    std::atomic<unsigned long long> roomJoins;
+
+    /**
+     * number and total size of the chat messages received.
+     */
+    std::atomic<unsigned long long> delivered;
+    std::atomic<unsigned long long> deliveredBytes;
+
+    /**
+     * time that the last chat message was received at.
+     */
+    std::atomic<unsigned long long> lastDelivery;
+
+    /**
+     * number of connections closed by the server.
+     */
+    std::atomic<int> disconnects;
+
+    /**
+     * number of heartbeats that the server sent to idle connections.
+     */
+    std::atomic<unsigned long long> pings;
+
+    /**
+     * number of connections that couldn't be established.
+     */
+    std::atomic<int> connectFailures;
+protected:
+    virtual void onConnect(int socket);
+    virtual void onMessage(int socket, Net::Message& msg);
+    virtual void onDisconnect(int socket, int remote);
+    virtual void onConnectFailed(const char* remoteName, short remotePort,
+        int error);
+private:
+    int numReceivers;
+    int caps;
+    int numRooms;
+    std::vector<int> receivers;
+    std::vector<int> senders;
+    std::vector<int> rooms;
+    pthread_mutex_t socketsLock;
+};
+
+/**
+ * @param numReceivers number of connections that join the chat room.
+ * @param caps CAP_ flags that the receivers offer the server.
+ * @param numRooms number of rooms that the connections are spread over; 0 to
+ *   send every message to the whole chat.
+ */
+LoadClient::LoadClient(int numReceivers, int caps, int numRooms) :
+    Host(AUTO_REACTORS)
+{
+    this->numReceivers = numReceivers;
+    this->caps = caps;
+    this->numRooms = numRooms;
+    histogram_init(&latency);
+    connected = 0;
+    joined = 0;
+    roomJoins = 0;
+    delivered = 0;
+    deliveredBytes = 0;
+    lastDelivery = 0;
+    disconnects = 0;
+    pings = 0;
+    connectFailures = 0;
+    pthread_mutex_init(&socketsLock,0);
+    setVerbose(0);
+}
+
+LoadClient::~LoadClient()
+{
+    pthread_mutex_destroy(&socketsLock);
+}
+
+std::vector<int> LoadClient::senderSockets()
+{
+    pthread_mutex_lock(&socketsLock);
+    std::vector<int> sockets = senders;
+    pthread_mutex_unlock(&socketsLock);
+    return sockets;
+}
+
+/**
+ * returns the room that each of senderSockets is in.
+ */
+std::vector<int> LoadClient::senderRooms()
+{
+    pthread_mutex_lock(&socketsLock);
+    std::vector<int> senderRooms = rooms;
+    pthread_mutex_unlock(&socketsLock);
+    return senderRooms;
+}
+
+void LoadClient::onConnect(int socket)
+{
+    pthread_mutex_lock(&socketsLock);
+    int isReceiver = (int) receivers.size() < numReceivers;
+    if(isReceiver)
+    {
+        receivers.push_back(socket);
+    }
+    else
+    {
+        senders.push_back(socket);
+    }
+    int index = receivers.size()+senders.size();
+    int room = numRooms ? (index-1)%numRooms : 0;
+    if(!isReceiver)
+    {
+        rooms.push_back(room);
+    }
+    pthread_mutex_unlock(&socketsLock);
+    connected.fetch_add(1);
+
+    // only receivers join the chat room, unless everyone joins a room
+    if(isReceiver || numRooms)
+    {
+        char name[32];
+        int len = snprintf(name,sizeof(name)-1,"bench%d",index);
+        name[len+1] = (char) caps;
+        send(socket,Net::Message(CHECK_USR_NAME,name,len+2));
+    }
+    if(numRooms)
+    {
+        char name[32];
+        int len = snprintf(name,sizeof(name),"room%d",room);
+        send(socket,Net::Message(JOIN_ROOM,name,len+1));
+    }
+}
+
+void LoadClient::onMessage(int socket, Net::Message& msg)
+{
+    if(msg.type == SET_USR_NAME && msg.data != 0 &&
+        (((unsigned char*) msg.data)[msg.len-1]&CAP_COMPRESSION))
+    {
+        setCompression(socket,1);
+    }
+    else if(msg.type == ADD_CLIENT)
+    {
+        joined.fetch_add(1,std::memory_order_relaxed);
+    }
+    else if(msg.type == JOIN_ROOM)
+    {
+        roomJoins.fetch_add(1,std::memory_order_relaxed);
+    }
+    else if(msg.type == PING)
+    {
+        send(socket,Net::Message(PONG,msg.data,msg.len));
+        pings.fetch_add(1,std::memory_order_relaxed);
+    }
+    else if((msg.type == SHOW_MSG || msg.type == ROOM_MSG) &&
+        msg.len >= STAMP_LEN)
+    {
+        // the text of a room message follows the room's name
+        const char* text = (const char*) msg.data;
+        if(msg.type == ROOM_MSG)
+        {
+            text += strnlen(text,msg.len)+1;
+        }
+        char stamp[STAMP_LEN+1];
+        memcpy(stamp,text,STAMP_LEN);
+        stamp[STAMP_LEN] = 0;
+
+        unsigned long long now = now_ns();
+        histogram_record(&latency,now-strtoull(stamp,0,16));
+        delivered.fetch_add(1,std::memory_order_relaxed);
+        deliveredBytes.fetch_add(msg.len,std::memory_order_relaxed);
+        lastDelivery.store(now,std::memory_order_relaxed);
+    }
+}
+
+void LoadClient::onDisconnect(int, int remote)
+{
+    if(remote)
+    {
+        disconnects.fetch_add(1);
+    }
+}
+
+void LoadClient::onConnectFailed(const char* remoteName, short remotePort,
+    int error)
+{
+    fprintf(stderr,"failed to connect to %s:%d: %s\n",remoteName,remotePort,
+        strerror(error));
+    connectFailures.fetch_add(1);
+}
+
+/**
+ * fills a message with words picked at random, so it compresses about as
+ *   well as a large paste of chat would.
+ */
+static void fill_text(char* text, int size)
+{
+    static const char* words[] =
+    {
+        "the","server","message","is","a","of","to","and","chat","room",
+        "client","sent","we","it","that","for","on","with","queue","socket",
+        "latency","was","this","not","be","are","from","or","have","buffer"
+    };
+    unsigned int state = 2463534242u;
+    int len = 0;
+    while(len < size-1)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const char* word = words[state%(sizeof(words)/sizeof(words[0]))];
+        while(*word != 0 && len < size-1)
+        {
+            text[len++] = *word++;
+        }
+        if(len < size-1)
+        {
+            text[len++] = ' ';
+        }
+    }
+    text[size-1] = 0;
+}
+
+/**
+ * waits until the counter reaches the target.
+ *
+ * @return non-zero if the target was reached before WAIT_TIMEOUT.
+ */
+static int wait_for(std::atomic<unsigned long long>* counter,
+    unsigned long long target)
+{
+    for(int waited = 0; waited < WAIT_TIMEOUT; ++waited)
+    {
+        if(counter->load() >= target)
+        {
+            return 1;
+        }
+        usleep(1000);
+    }
+    return counter->load() >= target;
+}
+
+static void usage(char* program)
+{
+    fprintf(stderr,
+        "usage: %s [-p port] [-c connections] [-f fan-out] [-r rate] "
+        "[-s size] [-t seconds] [-u] [-w workers] [-b bytes] [-n frames] "
+        "[-v version] [-k us] [-z] [-g rooms] [-l dir] [-i ms] [-x path]\n"
+        "  -c  connections to open (default %d)\n"
+        "  -f  clients that receive each message (default %d); the other "
+        "connections send\n"
+        "  -r  messages sent per second, 0 to send as fast as possible "
+        "(default %d)\n"
+        "  -s  size of each message in bytes (default %d)\n"
+        "  -t  seconds to send for (default %d)\n"
+        "  -u  run the server on the io_uring backend\n"
+        "  -w  handle the server's messages on this many worker threads\n"
+        "  -b  bytes the server reads from a socket per turn (default %d)\n"
+        "  -n  frames the server dispatches for a socket per turn "
+        "(default %d)\n"
+        "  -v  newest framing that both ends offer (default %d)\n"
+        "  -k  microseconds the server holds broadcasts back for, to send "
+        "them together (default off)\n"
+        "  -z  compress payloads of at least %d bytes sent to receivers\n"
+        "  -g  spread every connection over this many chat rooms, and send "
+        "to a room\n      rather than to the receivers (default off)\n"
+        "  -l  log the chat to segment files in this directory\n"
+        "  -i  milliseconds a connection may be quiet for before the server "
+        "pings it;\n      it is disconnected after three times as long "
+        "(default off)\n"
+        "  -x  connect through a unix domain socket at this path, rather than "
+        "over TCP\n",
+        program,DEFAULT_CONNECTIONS,DEFAULT_FAN_OUT,DEFAULT_RATE,
+        DEFAULT_SIZE,DEFAULT_SECONDS,DEFAULT_READ_BUDGET,DEFAULT_FRAME_BUDGET,
+        WIRE_MAX_VERSION,DEFAULT_COMPRESS_THRESHOLD);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    int port = DEFAULT_PORT;
+    int numConnections = DEFAULT_CONNECTIONS;
+    int fanOut = DEFAULT_FAN_OUT;
+    long rate = DEFAULT_RATE;
+    int size = DEFAULT_SIZE;
+    int seconds = DEFAULT_SECONDS;
+    int backend = EPOLL_BACKEND;
+    int numWorkers = INLINE_HANDLERS;
+    int readBudget = DEFAULT_READ_BUDGET;
+    int frameBudget = DEFAULT_FRAME_BUDGET;
+    int wireVersion = WIRE_MAX_VERSION;
+    int coalesceWindow = NO_COALESCING;
+    int caps = 0;
+    int numRooms = 0;
+    const char* logDir = 0;
+    int idleTimeout = NO_IDLE_TIMEOUT;
+    const char* localPath = 0;
+
+    int opt;
+    while((opt = getopt(argc,argv,"p:c:f:r:s:t:uw:b:n:v:k:zg:l:i:x:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'p': port = atoi(optarg); break;
+        case 'c': numConnections = atoi(optarg); break;
+        case 'f': fanOut = atoi(optarg); break;
+        case 'r': rate = atol(optarg); break;
+        case 's': size = atoi(optarg); break;
+        case 't': seconds = atoi(optarg); break;
+        case 'u': backend = URING_BACKEND; break;
+        case 'w': numWorkers = atoi(optarg); break;
+        case 'b': readBudget = atoi(optarg); break;
+        case 'n': frameBudget = atoi(optarg); break;
+        case 'v': wireVersion = atoi(optarg); break;
+        case 'k': coalesceWindow = atoi(optarg); break;
+        case 'z': caps |= CAP_COMPRESSION; break;
+        case 'g': numRooms = atoi(optarg); break;
+        case 'l': logDir = optarg; break;
+        case 'i': idleTimeout = atoi(optarg); break;
+        case 'x': localPath = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if(fanOut < 1 || fanOut >= numConnections || rate < 0 ||
+        size <= STAMP_LEN || seconds < 1 || numWorkers < 0 ||
+        readBudget < 1 || frameBudget < 1 || wireVersion < WIRE_V0 ||
+        wireVersion > WIRE_MAX_VERSION || coalesceWindow < 0 ||
+        numRooms < 0 || idleTimeout < 0)
+    {
+        usage(argv[0]);
+    }
+
+    raise_file_limit();
+
+    // start the server that's being measured
+    Server* svr = new Server(backend,numWorkers);
+    svr->setVerbose(0);
+    svr->setReadBudget(readBudget,frameBudget);
+    svr->setWireVersion(wireVersion);
+    svr->setCoalescing(coalesceWindow);
+    svr->setIdleTimeout(idleTimeout,idleTimeout*3);
+    if(logDir != 0 && svr->openLog(logDir) != SUCCESS)
+    {
+        perror("failed to open the chat log");
+        return 1;
+    }
+    if(svr->startListeningRoutine(port,localPath) != SUCCESS)
+    {
+        fprintf(stderr,"failed to listen on port %d\n",port);
+        return 1;
+    }
+
+    // connect the clients all at once, and wait for the receivers to join
+    // the chat room
+    LoadClient* load = new LoadClient(fanOut,caps,numRooms);
+    load->setWireVersion(wireVersion);
+    unsigned long long connectStart = now_ns();
+    for(int i = 0; i < numConnections; ++i)
+    {
+        if(localPath == 0)
+        {
+            load->connectAsync("localhost",port);
+        }
+        else if(load->connectLocal(localPath) != SUCCESS)
+        {
+            perror("failed to connect to the local socket");
+            return 1;
+        }
+    }
+    int numJoined = numRooms ? numConnections : fanOut;
+    unsigned long long joins = (unsigned long long) numJoined*(numJoined+1)/2;
+    std::vector<int> roomSizes(numRooms);
+    unsigned long long roomJoins = 0;
+    for(int i = 0; i < numRooms; ++i)
+    {
+        roomSizes[i] = numConnections/numRooms+(i < numConnections%numRooms);
+        roomJoins += (unsigned long long) roomSizes[i]*(roomSizes[i]+1)/2;
+    }
+    if(!wait_for(&load->connected,numConnections) ||
+        !wait_for(&load->joined,joins) ||
+        !wait_for(&load->roomJoins,roomJoins))
+    {
+        fprintf(stderr,"timed out waiting for clients to join; %d of %d "
+            "connections failed\n",load->connectFailures.load(),
+            numConnections);
+        return 1;
+    }
+    double joinMs = (now_ns()-connectStart)/1e6;
+    std::vector<int> senders = load->senderSockets();
+    std::vector<int> senderRooms = load->senderRooms();
+
+    printf("%s server with %d workers, %d connections: %d receivers, "
+        "%d senders; v%d framing, %d us coalescing, %scompressed, "
+        "%d byte messages, ",
+        (svr->getBackend() == URING_BACKEND) ? "io_uring" : "epoll",
+        numWorkers,numConnections,fanOut,(int) senders.size(),wireVersion,
+        coalesceWindow,(caps&CAP_COMPRESSION) ? "" : "un",size);
+    if(logDir != 0)
+    {
+        printf("logged to %s, ",logDir);
+    }
+    if(rate)
+    {
+        printf("%ld msgs/s\n",rate);
+    }
+    else
+    {
+        printf("unthrottled\n");
+    }
+    if(numRooms)
+    {
+        printf("%d rooms of about %d members\n",numRooms,
+            numConnections/numRooms);
+    }
+    printf("connected, and every receiver joined, in %.1f ms\n",joinMs);
+
+    // every message is text starting with its send time, padded to size; a
+    // room message has the room's name in front of it
+    char* text = (char*) malloc(size);
+    char* roomPayload = (char*) malloc(size+32);
+    fill_text(text,size);
+
+    unsigned long long sent = 0;
+    unsigned long long dropped = 0;
+    unsigned long long expected = 0;
+    unsigned long long start = now_ns();
+    unsigned long long end = start+seconds*1000000000ULL;
+    unsigned long long now;
+    while((now = now_ns()) < end)
+    {
+        unsigned long long due = rate ?
+            (now-start)*rate/1000000000ULL : sent+senders.size();
+        while(sent < due)
+        {
+            char stamp[STAMP_LEN+1];
+            snprintf(stamp,sizeof(stamp),"%016llx",now_ns());
+            memcpy(text,stamp,STAMP_LEN);
+
+            int sender = sent%senders.size();
+            Net::Message msg(SHOW_MSG,text,size);
+            int fanOutOfMsg = fanOut;
+            if(numRooms)
+            {
+                int room = senderRooms[sender];
+                int roomLen = snprintf(roomPayload,32,"room%d",room)+1;
+                memcpy(roomPayload+roomLen,text,size);
+                msg = Net::Message(ROOM_MSG,roomPayload,roomLen+size);
+                fanOutOfMsg = roomSizes[room]-1;
+            }
+
+            if(load->send(senders[sender],msg) != SUCCESS)
+            {
+                ++dropped;
+            }
+            else
+            {
+                expected += fanOutOfMsg;
+            }
+            ++sent;
+        }
+        if(rate)
+        {
+            usleep(100);
+        }
+    }
+    double sendSeconds = (now_ns()-start)/1e9;
+
+    // wait for the messages in flight; receivers that were disconnected for
+    // falling behind won't get theirs
+    wait_for(&load->delivered,expected);
+    unsigned long long delivered = load->delivered.load();
+    double deliverSeconds = (load->lastDelivery.load()-start)/1e9;
+
+    printf("sent      %12llu msgs %12.0f msgs/s %12.0f bytes/s\n",
+        sent,sent/sendSeconds,sent*(double) size/sendSeconds);
+    printf("delivered %12llu msgs %12.0f msgs/s %12.0f bytes/s\n",
+        delivered,delivered/deliverSeconds,
+        load->deliveredBytes.load()/deliverSeconds);
+    printf("dropped by full send queues: %llu; receivers disconnected: %d\n",
+        dropped,load->disconnects.load());
+    if(idleTimeout != NO_IDLE_TIMEOUT)
+    {
+        printf("idle connections pinged: %llu\n",load->pings.load());
+    }
+    printf("delivery latency (us):\n");
+    histogram_print(&load->latency,stdout,1000.0);
+
+    Net::ReceiveStats stats;
+    svr->getReceiveStats(&stats);
+    printf("server received %llu frames, %llu bytes in %llu reads; "
+        "%llu sockets carried over\n",
+        stats.frames,stats.bytes,stats.reads,stats.carryOvers);
+
+    // how many broadcasts reached the receivers per read
+    load->getReceiveStats(&stats);
+    printf("clients received %llu frames, %llu bytes in %llu reads\n",
+        stats.frames,stats.bytes,stats.reads);
+
+    // how fairly the server's reactors took turns between sockets
+    Histogram service;
+    histogram_init(&service);
+    svr->getServiceLatency(&service);
+    printf("server wait for a turn to read (us):\n");
+    histogram_print(&service,stdout,1000.0);
+
+    // what the fan-out cost the server to write
+    Net::SendStats sendStats;
+    svr->getSendStats(&sendStats);
+    printf("server sent %llu frames, %llu bytes in %llu writes; "
+        "%llu queued\n",sendStats.frames,sendStats.bytes,sendStats.writes,
+        sendStats.queuedFrames);
+    Histogram stage;
+    histogram_init(&stage);
+    svr->getDispatchLatency(&stage);
+    printf("server time in onMessage (us):\n");
+    histogram_print(&stage,stdout,1000.0);
+    histogram_init(&stage);
+    svr->getSendLatency(&stage);
+    printf("server time in each write (us):\n");
+    histogram_print(&stage,stdout,1000.0);
+
+    PoolStats poolStats;
+    pool_get_stats(&poolStats);
+    printf("buffer pool: %llu allocations, %llu mallocs, %llu frees\n",
+        poolStats.allocs,poolStats.mallocs,poolStats.frees);
+
+    free(roomPayload);
+    free(text);
+    delete load;
+    svr->stopListeningRoutine();
+    delete svr;
+
+    return 0;
+}
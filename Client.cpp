@@ -4,6 +4,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 Client::Client()
@@ -18,16 +19,19 @@ Client::~Client()
 void Client::onConnect(int socket)
 {
     Host::onConnect(socket);
-    // send the server your user name
-    Net::Message msg;
-    msg.type = CHECK_USR_NAME;
-    msg.data = name;
-    msg.len = strlen(name)+1;
+    // send the server your user name, and the capabilities that the client
+    // supports after it
+    int nameLen = strlen(name)+1;
+    char* request = (char*) malloc(nameLen+1);
+    memcpy(request,name,nameLen);
+    request[nameLen] = CAP_COMPRESSION;
+    Net::Message msg(CHECK_USR_NAME,request,nameLen+1);
     send(socket,msg);
+    free(request);
     svrSock = socket;
 }
 
-void Client::onMessage(int socket, Net::Message msg)
+void Client::onMessage(int socket, Net::Message& msg)
 {
     Host::onMessage(socket,msg);
     switch(msg.type)
@@ -42,7 +46,21 @@ void Client::onMessage(int socket, Net::Message msg)
         onShowMessage((char*)msg.data);
         break;
     case SET_USR_NAME:
-        onSetName((char*)msg.data);
+        onSetName(socket,msg);
+        break;
+    case JOIN_ROOM:
+    case LEAVE_ROOM:
+        onRoomEvent(msg);
+        break;
+    case ROOM_MSG:
+        onRoomMessage(msg);
+        break;
+    case PING:
+        send(socket,Net::Message(PONG,msg.data,msg.len));
+        break;
+    case STATS:
+        printf("%.*s",(int) strnlen((char*) msg.data,msg.len),
+            (char*) msg.data);
         break;
     }
 }
@@ -54,13 +72,45 @@ void Client::onDisconnect(int socket, int remote)
 
 void Client::sendChatMessage(char* chatMsg)
 {
-    Net::Message msg;
-    msg.type = SHOW_MSG;
-    msg.data = chatMsg;
-    msg.len = strlen(chatMsg)+1;
+    Net::Message msg(SHOW_MSG,chatMsg,strlen(chatMsg)+1);
+    send(svrSock,msg);
+}
+
+void Client::joinRoom(char* room)
+{
+    Net::Message msg(JOIN_ROOM,room,strlen(room)+1);
     send(svrSock,msg);
 }
 
+void Client::leaveRoom(char* room)
+{
+    Net::Message msg(LEAVE_ROOM,room,strlen(room)+1);
+    send(svrSock,msg);
+}
+
+/**
+ * says something in a chat room that the client has joined.
+ */
+void Client::sendRoomMessage(char* room, char* chatMsg)
+{
+    int roomLen = strlen(room)+1;
+    int msgLen = strlen(chatMsg)+1;
+    char* payload = (char*) malloc(roomLen+msgLen);
+    memcpy(payload,room,roomLen);
+    memcpy(payload+roomLen,chatMsg,msgLen);
+    Net::Message msg(ROOM_MSG,payload,roomLen+msgLen);
+    send(svrSock,msg);
+    free(payload);
+}
+
+/**
+ * asks the server for its metrics; the report is printed once it arrives.
+ */
+void Client::requestStats()
+{
+    send(svrSock,Net::Message(STATS,0,0));
+}
+
 void Client::onAddClient(char* clientName)
 {
     printf("%s has connected.\n",clientName);
@@ -76,9 +126,44 @@ void Client::onShowMessage(char* message)
     printf("%s\n",message);
 }
 
-void Client::onSetName(char* newName)
+/**
+ * someone has joined or left a chat room that the client is in; the payload
+ *   is the room's name, then the member's.
+ */
+void Client::onRoomEvent(Net::Message& msg)
 {
-    printf("your name is %s.\n",newName);
+    char* room = (char*) msg.data;
+    int roomLen = strnlen(room,msg.len);
+    char* member = room+roomLen+1;
+    int memberLen = (roomLen < msg.len) ?
+        strnlen(member,msg.len-roomLen-1) : 0;
+    printf("%.*s has %s #%.*s.\n",memberLen,member,
+        (msg.type == JOIN_ROOM) ? "joined" : "left",roomLen,room);
+}
+
+void Client::onRoomMessage(Net::Message& msg)
+{
+    char* room = (char*) msg.data;
+    int roomLen = strnlen(room,msg.len);
+    char* text = room+roomLen+1;
+    int textLen = (roomLen < msg.len) ? strnlen(text,msg.len-roomLen-1) : 0;
+    printf("#%.*s: %.*s\n",roomLen,room,textLen,text);
+}
+
+/**
+ * the server has assigned the client its name, and said which of the
+ *   client's capabilities it accepted.
+ */
+void Client::onSetName(int socket, Net::Message& msg)
+{
+    char* newName = (char*) msg.data;
+    int nameLen = strnlen(newName,msg.len)+1;
+    int caps = (nameLen < msg.len) ? ((unsigned char*) msg.data)[nameLen] : 0;
+    if(caps&CAP_COMPRESSION)
+    {
+        setCompression(socket,1);
+    }
+    printf("your name is %.*s.\n",nameLen-1,newName);
 }
 
 int main(void)
@@ -102,8 +187,33 @@ int main(void)
             break;
         }
 
-        // send the message to the server
-        clnt->sendChatMessage((char*)chatMsg.data);
+        // "/join room" and "/leave room" change the rooms that the client is
+        // in, and "#room text" says something in one of them; "/stats" shows
+        // the server's metrics
+        char* line = (char*) chatMsg.data;
+        char* space = strchr(line,' ');
+        if(strncmp(line,"/join ",6) == 0)
+        {
+            clnt->joinRoom(line+6);
+        }
+        else if(strncmp(line,"/leave ",7) == 0)
+        {
+            clnt->leaveRoom(line+7);
+        }
+        else if(strcmp(line,"/stats") == 0)
+        {
+            clnt->requestStats();
+        }
+        else if(line[0] == '#' && space != 0)
+        {
+            *space = 0;
+            clnt->sendRoomMessage(line+1,space+1);
+        }
+        else
+        {
+            // send the message to the server
+            clnt->sendChatMessage(line);
+        }
     }
 
     delete clnt;
@@ -12,15 +12,21 @@ public:
     Client();
     ~Client();
     void sendChatMessage(char* chatMsg);
+    void joinRoom(char* room);
+    void leaveRoom(char* room);
+    void sendRoomMessage(char* room, char* chatMsg);
+    void requestStats();
 protected:
     virtual void onConnect(int socket);
-    virtual void onMessage(int socket, Net::Message msg);
+    virtual void onMessage(int socket, Net::Message& msg);
     virtual void onDisconnect(int socket, int remote);
 private:
     void onAddClient(char* clientName);
     void onRmClient(char* clientName);
     void onShowMessage(char* message);
-    void onSetName(char* newUsername);
+    void onRoomEvent(Net::Message& msg);
+    void onRoomMessage(Net::Message& msg);
+    void onSetName(int socket, Net::Message& msg);
     char* name;
     /**
      * socket that's connected to the chat server.
@@ -1,7 +1,12 @@
 #include "Host.h"
 #include "net_helper.h"
 #include "select_helper.h"
+#include "frame_decoder.h"
+#include "outbound_queue.h"
+#include "shared_frame.h"
 #include "Message.h"
+#include "uring.h"
+#include "wire_header.h"
 
 #include <stdio.h>
 #include <netdb.h>
@@ -12,37 +17,239 @@
 #include <strings.h>
 #include <arpa/inet.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <time.h>
 #include <vector>
+#include <deque>
 #include <set>
+#include <map>
 
 /**
- * communicate to the receive thread through the receive pipe, to read a socket
- *   from the receive pipe, and add it to the set of sockets to select.
+ * command to a reactor's thread, to add the command's socket to the set of
+ *   sockets to select.
  */
 #define ADD_SOCK 0
 
 /**
- * communicate to the receive thread through the receive pipe, to read a socket
- *   from the receive pipe, and remove it from the set of sockets to select.
+ * command to a reactor's thread, to shut down the command's socket, and remove
+ *   it from the set of sockets to select once it closes.
  */
 #define RM_SOCK 1
 
+/**
+ * command to a reactor's thread, to close all its sockets, and terminate; or,
+ *   when the host hands off, to leave them open, with their state, and
+ *   terminate once nothing received on them is left unhandled.
+ */
+#define STOP_REACTOR 2
+
+/**
+ * command to a reactor's thread, to wait for the command's socket to become
+ *   writable, and flush its send queue when it does; only used by
+ *   URING_BACKEND, where only the reactor's thread may submit requests.
+ */
+#define WATCH_SOCK 3
+
+/**
+ * command to a reactor's thread, to send the broadcasts held back for the
+ *   command's socket once the coalescing window is over.
+ */
+#define CORK_SOCK 4
+
+/**
+ * command to a reactor's thread, to arm the timer of the command's
+ *   DeferredTask.
+ */
+#define DEFER_TASK 5
+
+/**
+ * command to a reactor's thread, to wait for the command's socket to be
+ *   connected, and hand it over to addSocket, or report that it failed.
+ */
+#define CONNECT_SOCK 6
+
+/**
+ * command to a reactor's thread, to add a socket taken over from another host
+ *   to the set of sockets to select, and handle what the other host received
+ *   on it, but didn't handle.
+ */
+#define ADOPT_SOCK 7
+
+/**
+ * number of submission queue entries of each io_uring.
+ */
+#define URING_ENTRIES 1024
+
+/**
+ * number and size of the buffers that each reactor's io_uring receives into.
+ */
+#define URING_NUM_BUFFERS 256
+#define URING_BUFFER_SIZE 16384
+
+/**
+ * what a request submitted to an io_uring is for; kept in the top byte of the
+ *   request's user data.
+ */
+#define URING_EVENT 1       // reactor's eventfd is readable
+#define URING_RECV 2        // data received on a connected socket
+#define URING_WRITABLE 3    // connected socket is writable
+#define URING_CANCEL 4      // requests on a closed socket are cancelled
+#define URING_ACCEPT 5      // connection accepted on the server socket
+#define URING_STOP 6        // listen routine's control pipe is readable
+#define URING_UNCORK 7      // coalescing window of a connected socket is over
+#define URING_CONNECT 8     // connecting socket is connected, or failed
+
+/**
+ * callbacks that a worker calls on a socket's behalf.
+ */
+#define EVENT_CONNECT 0
+#define EVENT_MESSAGE 1
+#define EVENT_DISCONNECT 2
+#define EVENT_IDLE 3
+#define EVENT_TAKEOVER 4
+
+/**
+ * most callbacks of one socket that a worker calls in a row, before giving
+ *   the other sockets' callbacks a turn.
+ */
+#define STRAND_BATCH 64
+
+/**
+ * type of the message that a host describes its framing with when it
+ *   connects. it is always sent in WIRE_V0 framing, and handled by the
+ *   receiving host itself, rather than passed to onMessage.
+ *
+ * its payload is the newest framing that the sender reads, and the framing
+ *   that the sender's messages after this one are in. a host switches to a
+ *   newer framing by sending another hello, once it knows the peer reads it.
+ */
+#define WIRE_HELLO -1
+#define WIRE_HELLO_LEN 2
+
+/**
+ * what serving a socket within its read budget ended with.
+ */
+#define SERVE_DONE 0        // everything received has been dispatched
+#define SERVE_MORE 1        // budget used up, with work left over
+#define SERVE_CLOSED 2      // socket closed, or sent an invalid frame
+
+/**
+ * records that a host handing off sends its successor, in this order: a
+ *   hello, the server sockets, every connection, and the end.
+ */
+#define HANDOFF_HELLO 0         // HANDOFF_VERSION, as an int
+#define HANDOFF_SERVER 1        // with svrSock
+#define HANDOFF_LOCAL 2         // with localSock, and localPath
+#define HANDOFF_CONNECTION 3    // with a socket, and its SavedConnection
+#define HANDOFF_DONE 4
+
+/**
+ * version of the records; hosts only hand off to successors of the same one.
+ */
+#define HANDOFF_VERSION 1
+
+/**
+ * one in this many writes on each socket is timed for the send stage's
+ *   histogram; a broadcast makes a write per recipient, so timing every one
+ *   would cost more than the rest of the counting.
+ */
+#define SEND_SAMPLE_RATE 8
+
 using namespace Net;
 
 // forward declarations
 static void fatal_error(const char* errstr);
+static unsigned long long uring_user_data(int op, unsigned int generation,
+    int fd);
+static unsigned long long now_ns();
+static unsigned long long now_ms();
+static void print_latency(FILE* file, const char* stage,
+    Histogram* histogram);
+static void count(std::atomic<unsigned long long>* counter,
+    unsigned long long n);
 
 /**
  * constructs a new {Server}.
+ *
+ * @param numReactors number of receive loops that connected sockets are spread
+ *   across; AUTO_REACTORS to run one per online processor.
+ * @param backend EPOLL_BACKEND or URING_BACKEND.
+ * @param numWorkers number of worker threads that call the handlers;
+ *   INLINE_HANDLERS to call them on the reactor threads.
  */
-Host::Host()
+Host::Host(int numReactors, int backend, int numWorkers)
 {
+    if(backend == URING_BACKEND && !uring_supported())
+    {
+        backend = EPOLL_BACKEND;
+    }
+
+    if(numReactors == AUTO_REACTORS)
+    {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numReactors = (numCpus > 0) ? numCpus : 1;
+    }
+
     svrSock = -1;
+    localSock = -1;
+    handOffSock = -1;
+    handingOff = 0;
+    isHandedOff = 0;
+    reactorsStopped = 0;
+    statsInterval = 0;
+    statsThread = 0;
     listenThread  = 0;
-    receiveThread = 0;
+    this->backend = backend;
+    this->numWorkers = numWorkers;
+    if(numWorkers != INLINE_HANDLERS)
+    {
+        workers_start(&workers,numWorkers);
+    }
+    this->numReactors = numReactors;
+    reactors = new Reactor[numReactors];
+    for(int i = 0; i < numReactors; ++i)
+    {
+        reactors[i].host = this;
+        reactors[i].thread = 0;
+        reactors[i].numSockets = 0;
+        reactors[i].reads = 0;
+        reactors[i].frames = 0;
+        reactors[i].bytes = 0;
+        reactors[i].numCommands = 0;
+        reactors[i].wakeups = 0;
+        reactors[i].carryOvers = 0;
+        reactors[i].framesSent = 0;
+        reactors[i].bytesSent = 0;
+        reactors[i].writes = 0;
+        reactors[i].framesQueued = 0;
+        histogram_init(&reactors[i].serviceLatency);
+        histogram_init(&reactors[i].dispatchLatency);
+        histogram_init(&reactors[i].sendLatency);
+    }
+    pthread_mutex_init(&connectionsLock,0);
+    pthread_mutex_init(&drainLock,0);
+    pthread_cond_init(&drained,0);
+    nextReactor = 0;
+    highWaterMark = DEFAULT_HIGH_WATER_MARK;
+    readBudget = DEFAULT_READ_BUDGET;
+    frameBudget = DEFAULT_FRAME_BUDGET;
+    wireVersion = WIRE_MAX_VERSION;
+    coalesceWindow = NO_COALESCING;
+    coalesceTimeout.tv_sec = 0;
+    coalesceTimeout.tv_nsec = 0;
+    coalesceBytes = DEFAULT_COALESCE_BYTES;
+    compressThreshold = DEFAULT_COMPRESS_THRESHOLD;
+    pingTimeout = NO_IDLE_TIMEOUT;
+    closeTimeout = NO_IDLE_TIMEOUT;
+    resolver_init(&resolver,RESOLVER_DEFAULT_TTL);
+    connectTimeout = DEFAULT_CONNECT_TIMEOUT;
+    verbose = 1;
     startReceiveRoutine();
 }
 
@@ -51,29 +258,102 @@ Host::Host()
  */
 Host::~Host()
 {
+    stop();
+    resolver_destroy(&resolver);
+
+    // nothing can post commands anymore; drop those that were posted after
+    // the reactors stopped
+    for(int i = 0; i < numReactors; ++i)
+    {
+        dropCommands(&reactors[i]);
+        close(reactors[i].eventFd);
+    }
+    pthread_mutex_destroy(&connectionsLock);
+    pthread_mutex_destroy(&drainLock);
+    pthread_cond_destroy(&drained);
+    delete[] reactors;
+}
+
+/**
+ * stops serving: the stats and listen routines are stopped, names still
+ *   being resolved for connectAsync fail, the receive routines are stopped,
+ *   and the callbacks already queued for the handlers are run, so none is
+ *   called afterwards. a subclass calls it first thing in its destructor, before it
+ *   frees what its handlers use. calling it again does nothing.
+ */
+void Host::stop()
+{
+    stopRoutine(&statsThread,statsPipe);
+    stopListeningRoutine();
+    resolver_stop(&resolver);
     stopReceiveRoutine();
+    if(numWorkers != INLINE_HANDLERS && workers.threads != 0)
+    {
+        workers_stop(&workers);
+    }
 }
 
 /**
  * initializes the server to listen for incoming connections on the
- *   given port
+ *   given port, and optionally on a unix domain path as well, so peers on the
+ *   same host skip the TCP/IP stack. connections accepted either way are
+ *   handled alike.
+ *
+ * a host that has taken over from another one listens on the server sockets
+ *   that it was handed instead, and starts serving the connections that it
+ *   was handed.
  *
  * @param  port to connect to
+ * @param  localPath path to listen on for local connections; 0 for none. a
+ *   path starting with '@' is in the abstract namespace.
  *
  * @return integer indicating the outcome of the operation
  */
-int Host::startListeningRoutine(short port)
+int Host::startListeningRoutine(short port, const char* localPath)
 {
-    // open the server socket
-    if(listenThread == 0)
+    if(listenThread != 0)
+    {
+        return INVALID_OPERATION;
+    }
+
+    // open the server sockets, unless they were taken over
+    if(svrSock == -1)
     {
-        if((svrSock = make_tcp_server_socket(port)) == -1)
+        if((svrSock = make_tcp_server_socket(port,false)) == -1)
         {
             return SOCK_OP_FAIL;
         }
+        if(localPath != 0)
+        {
+            if((localSock = make_unix_server_socket(localPath)) == -1)
+            {
+                perror("failed to bind local server socket");
+                close(svrSock);
+                svrSock = -1;
+                return SOCK_OP_FAIL;
+            }
+            this->localPath = localPath;
+        }
+    }
+
+    // wait for a successor to hand off to, if there is a path for it
+    if(!handOffPath.empty() &&
+        (handOffSock = make_unix_server_socket(handOffPath.c_str())) == -1)
+    {
+        perror("failed to bind hand-off socket");
     }
 
-    return startRoutine(&listenThread,listenRoutine,listenPipe,this);
+    int result = startRoutine(&listenThread,
+        (backend == URING_BACKEND) ? uringListenRoutine : listenRoutine,
+        listenPipe,this);
+
+    // serve the connections that were taken over, now that the host is ready
+    for(size_t i = 0; i < takenOver.size(); ++i)
+    {
+        adoptSocket(takenOver[i].socket,takenOver[i].saved);
+    }
+    takenOver.clear();
+    return result;
 }
 
 /**
@@ -89,164 +369,2997 @@ int Host::stopListeningRoutine()
 /**
  * sends a message to the remote host, using the protocol that hosts use.
  *
+ * the header and payload go out in a single gathered write. whatever the
+ *   socket doesn't accept right away is queued, and sent by the socket's
+ *   reactor once the socket is writable, so the calling thread never blocks.
+ *   a message that owns its encoded frame, such as one received from another
+ *   host, is queued by reference instead of being copied.
+ *
  * @param socket socket to send the data to.
  * @param msg message to send to the remote host.
+ *
+ * @return SUCCESS if the message was sent or queued; QUEUE_FULL if it was
+ *   dropped because the peer's send queue is over the high-water mark,
+ *   SOCK_OP_FAIL if the socket isn't connected, and INVALID_OPERATION if the
+ *   message's type doesn't fit the framing that the peer uses.
  */
-void Host::send(int socket, Message msg)
+int Host::send(int socket, const Message& msg)
 {
-    write(socket,&msg.type,sizeof(msg.type));
-    write(socket,&msg.len,sizeof(msg.len));
-    write(socket,msg.data,msg.len);
+    Outgoing out(msg);
+    return sendFrame(socket,&out,0);
 }
 
-int Host::connect(char* remoteName, short remotePort)
+/**
+ * sends the same message to many remote hosts. sockets that take the whole
+ *   message right away are written to straight from the message's memory.
+ *   the first socket that can't is the only time the message is encoded; every
+ *   socket queues a reference to that one frame, rather than a copy of it.
+ *   likewise, a large payload is compressed once, for the first socket whose
+ *   peer reads compressed frames, and the same bytes go to all of them.
+ *
+ * with coalescing on, the message is queued for every socket instead, and
+ *   sent along with the other broadcasts to it at the end of the coalescing
+ *   window, in one write.
+ *
+ * @param sockets sockets to send the message to.
+ * @param msg message to send to the remote hosts.
+ *
+ * @return number of sockets that the message was sent or queued to.
+ */
+int Host::broadcast(const std::vector<int>& sockets, const Message& msg)
 {
-    // connect to remote host
-    int socket = make_tcp_client_socket(remoteName,0,remotePort,0);
-
-    if(socket != -1)
+    Outgoing out(msg);
+    int numSent = 0;
+    for(auto socket = sockets.begin(); socket != sockets.end(); ++socket)
     {
-        // communicate to receive thread that a new socket is connected
-        char commandType = ADD_SOCK;
-        write(receivePipe[1],&commandType,sizeof(commandType));
-        write(receivePipe[1],&socket,sizeof(socket));
+        if(sendFrame(*socket,&out,coalesceWindow != NO_COALESCING) == SUCCESS)
+        {
+            ++numSent;
+        }
     }
-
-    return (socket != -1) ? SUCCESS : SOCK_OP_FAIL;
+    return numSent;
 }
 
-void Host::disconnect(int socket)
+/**
+ * sends a message that is already encoded in a file, straight from the file
+ *   with sendfile, behind anything already queued for the socket. the frame
+ *   in the file is in WIRE_V0 form; a peer that reads another framing is sent
+ *   the payload behind a header of its own.
+ *
+ * @param socket socket to send the message to.
+ * @param type type of the message.
+ * @param file file that holds the frame; it is kept open until it is sent.
+ * @param offset position of the frame's header in {file}.
+ * @param len number of bytes in the frame's payload.
+ *
+ * @return SUCCESS, QUEUE_FULL, SOCK_OP_FAIL or INVALID_OPERATION, as for
+ *   send.
+ */
+int Host::sendFile(int socket, int type, SharedFile* file, long offset,
+    int len)
 {
-    // communicate to receive thread to remove an existing socket
-    char commandType = RM_SOCK;
-    write(receivePipe[1],&commandType,sizeof(commandType));
-    write(receivePipe[1],&socket,sizeof(socket));
+    std::shared_ptr<Connection> conn = findConnection(socket);
+    if(!conn)
+    {
+        return SOCK_OP_FAIL;
+    }
+
+    int result = SUCCESS;
+    pthread_mutex_lock(&conn->sendLock);
+    int version = conn->sendVersion;
+    char header[WIRE_MAX_HEADER_LEN];
+    int headerLen = 0;
+    if(version != WIRE_V0)
+    {
+        headerLen = wire_encode_header(header,version,type,0,len);
+        offset += FRAME_HEADER_LEN;
+    }
+    else
+    {
+        len += FRAME_HEADER_LEN;
+    }
+
+    if(conn->closed)
+    {
+        result = SOCK_OP_FAIL;
+    }
+    else if(version != WIRE_V0 && (type&~WIRE_MAX_TYPE) != 0)
+    {
+        result = INVALID_OPERATION;
+    }
+    else if(conn->outbound.bytes+headerLen+len > highWaterMark)
+    {
+        result = QUEUE_FULL;
+    }
+    else
+    {
+        outq_push_file(&conn->outbound,file,offset,len,
+            (version == WIRE_V0) ? 0 : header,headerLen);
+        count(&conn->framesSent,1);
+        if(!conn->watchingWritable)
+        {
+            flushQueue(conn.get());
+            if(!outq_empty(&conn->outbound))
+            {
+                conn->watchingWritable = 1;
+                watchWritable(conn.get());
+            }
+        }
+        if(!outq_empty(&conn->outbound))
+        {
+            count(&conn->framesQueued,1);
+        }
+    }
+    pthread_mutex_unlock(&conn->sendLock);
+
+    if(result == QUEUE_FULL)
+    {
+        onQueueFull(socket);
+    }
+    return result;
 }
 
-void Host::onConnect(int socket)
+/**
+ * sends a message with a single gathered write, and queues whatever the socket
+ *   doesn't accept right away.
+ *
+ * @param socket socket to send the message to.
+ * @param out message to send, and the frames made from it so far; frames made
+ *   for this socket are kept in it for the next one.
+ * @param coalesce non-zero to hold the message back until the end of the
+ *   coalescing window.
+ *
+ * @return SUCCESS, QUEUE_FULL, SOCK_OP_FAIL or INVALID_OPERATION, as for
+ *   send.
+ */
+int Host::sendFrame(int socket, Outgoing* out, int coalesce)
 {
-    printf("server: socket %d connected\n",socket);
+    std::shared_ptr<Connection> conn = findConnection(socket);
+    if(!conn)
+    {
+        return SOCK_OP_FAIL;
+    }
+
+    int result = writeFrame(conn.get(),out,coalesce,-1);
+    if(result == QUEUE_FULL)
+    {
+        onQueueFull(socket);
+    }
+    return result;
 }
 
-void Host::onMessage(int socket, Message msg)
+/**
+ * sends a message to a connection in the framing that its peer reads, and
+ *   queues whatever the socket doesn't accept right away.
+ *
+ * @param conn connection to send the message to.
+ * @param out as for sendFrame.
+ * @param coalesce as for sendFrame.
+ * @param nextVersion framing to send the connection's later messages in,
+ *   switched to before any other message can be sent; -1 to keep the current
+ *   one.
+ *
+ * @return SUCCESS, QUEUE_FULL, SOCK_OP_FAIL or INVALID_OPERATION, as for
+ *   send.
+ */
+int Host::writeFrame(Connection* conn, Outgoing* out, int coalesce,
+    int nextVersion)
 {
-    printf("server: socket %d: msg.type: %d, msg.data: ",socket,msg.type);
-    for(int i = 0; i < msg.len; ++i)
+    const Message& msg = out->msg;
+    int result = SUCCESS;
+    int bytesSent = 0;
+    int tried = 0;
+    pthread_mutex_lock(&conn->sendLock);
+
+    // compress the payload for peers that read compressed frames, unless it
+    // is too small, or was found not to compress for an earlier peer; only
+    // framings with a flags byte can say that it is compressed
+    int version = conn->sendVersion;
+    SharedFrame* packed = 0;
+    if(conn->compress && version != WIRE_V0 && msg.len >= compressThreshold)
     {
-        printf("%c",((char*)msg.data)[i]);
+        if(!out->packTried)
+        {
+            out->packTried = 1;
+            out->packed = frame_compress(msg);
+        }
+        packed = out->packed;
     }
-    printf("\n");
+
+    // describe the frame's memory; the encoded frame if the peer reads it as
+    // it is, otherwise a header of the peer's framing, then the payload
+    char header[WIRE_MAX_HEADER_LEN];
+    int headerLen = 0;
+    struct iovec iov[2];
+    int iovCount;
+    SharedFrame** frame = &out->frame;
+    if(packed != 0)
+    {
+        int packedLen = packed->len-FRAME_HEADER_LEN;
+        headerLen = wire_encode_header(header,version,msg.type,
+            WIRE_COMPRESSED,packedLen);
+        iov[0].iov_base = header;
+        iov[0].iov_len = headerLen;
+        iov[1].iov_base = packed->data+FRAME_HEADER_LEN;
+        iov[1].iov_len = packedLen;
+        iovCount = 2;
+        frame = &out->packed;
+    }
+    else if(version == WIRE_V0 && *frame != 0)
+    {
+        iov[0].iov_base = (*frame)->data;
+        iov[0].iov_len = (*frame)->len;
+        iovCount = 1;
+    }
+    else
+    {
+        headerLen = wire_encode_header(header,version,msg.type,0,msg.len);
+        iov[0].iov_base = header;
+        iov[0].iov_len = headerLen;
+        iov[1].iov_base = (*frame != 0) ?
+            (*frame)->data+FRAME_HEADER_LEN : msg.data;
+        iov[1].iov_len = msg.len;
+        iovCount = 2;
+    }
+    int frameLen = (iovCount == 1) ? (int) iov[0].iov_len :
+        headerLen+(int) iov[1].iov_len;
+
+    if(conn->closed)
+    {
+        result = SOCK_OP_FAIL;
+    }
+    else if(version != WIRE_V0 && (msg.type&~WIRE_MAX_TYPE) != 0)
+    {
+        result = INVALID_OPERATION;
+    }
+    else if(outq_empty(&conn->outbound) && !coalesce)
+    {
+        // nothing queued; try to send the whole frame right away
+        tried = 1;
+        unsigned long long start = startWrite(conn);
+        if((bytesSent = send_iov(conn->socket,iov,iovCount)) == -1)
+        {
+            bytesSent = 0;
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                result = SOCK_OP_FAIL;
+            }
+        }
+        countWrite(conn,start,bytesSent);
+    }
+    else if(conn->outbound.bytes+frameLen > highWaterMark)
+    {
+        // peer isn't keeping up; drop the message
+        result = QUEUE_FULL;
+    }
+
+    // the part of the frame that wasn't sent is queued from a frame of its
+    // own; without memory for it, the peer would only get part of the frame,
+    // so the connection is closed
+    if(result == SUCCESS && bytesSent < frameLen && *frame == 0 &&
+        (*frame = frame_encode(msg)) == 0)
+    {
+        shutdown(conn->socket,SHUT_RDWR);
+        result = SOCK_OP_FAIL;
+    }
+    if(result == SUCCESS)
+    {
+        count(&conn->framesSent,1);
+    }
+
+    // queue whatever wasn't sent, behind anything that is already queued
+    if(result == SUCCESS && bytesSent < frameLen)
+    {
+        count(&conn->framesQueued,1);
+        outq_push_frame(&conn->outbound,*frame,
+            (version == WIRE_V0) ? 0 : header,headerLen,bytesSent);
+
+        if(conn->watchingWritable)
+        {
+            // the reactor sends it once the socket takes what's before it
+        }
+        else if(coalesce && conn->outbound.bytes < coalesceBytes)
+        {
+            // hold it back, so the broadcasts that follow within the window
+            // go out along with it
+            if(!conn->corked)
+            {
+                conn->corked = 1;
+                postCommand(&reactors[conn->owner],CORK_SOCK,conn->socket);
+            }
+        }
+        else
+        {
+            // send it along with whatever was held back before it, unless
+            // the socket just refused it
+            if(!tried)
+            {
+                flushQueue(conn);
+            }
+            if(!outq_empty(&conn->outbound))
+            {
+                conn->watchingWritable = 1;
+                watchWritable(conn);
+            }
+        }
+    }
+    if(result == SUCCESS && nextVersion != -1)
+    {
+        conn->sendVersion = nextVersion;
+    }
+    pthread_mutex_unlock(&conn->sendLock);
+
+    return result;
 }
 
-void Host::onDisconnect(int socket, int remote)
+/**
+ * sets the number of bytes that may be queued for a peer before sends to it
+ *   fail with QUEUE_FULL.
+ *
+ * @param bytes the new high-water mark.
+ */
+void Host::setHighWaterMark(long bytes)
 {
-    printf("server: socket %d disconnected by %s host\n",
-        socket,remote?"remote":"local");
+    highWaterMark = bytes;
 }
 
-int Host::startReceiveRoutine()
+/**
+ * sets the newest framing that the host offers to its peers; each connection
+ *   uses the newest one that both ends read. WIRE_V0 talks to peers the way
+ *   hosts did before framing was negotiated, without offering anything. set it
+ *   before connecting.
+ *
+ * @param version WIRE_V0 or WIRE_V1.
+ */
+void Host::setWireVersion(int version)
 {
-    return startRoutine(&receiveThread,receiveRoutine,receivePipe,this);
+    if(version < WIRE_V0 || version > WIRE_MAX_VERSION)
+    {
+        version = WIRE_MAX_VERSION;
+    }
+    wireVersion = version;
 }
 
-int Host::stopReceiveRoutine()
+/**
+ * turns coalescing of broadcasts on or off. with it on, broadcasts to a peer
+ *   are held back for up to the window, and go out together in one write,
+ *   which saves a system call and a packet for each of them in busy rooms.
+ *   messages passed to send go out right away, along with anything held back
+ *   before them. set it before connecting.
+ *
+ * @param windowUs longest time to hold a broadcast back for, in
+ *   microseconds; NO_COALESCING to send broadcasts right away. EPOLL_BACKEND
+ *   rounds it up to whole milliseconds.
+ * @param bytes number of held back bytes that a peer's broadcasts are sent
+ *   at, before the window is over.
+ */
+void Host::setCoalescing(int windowUs, long bytes)
 {
-    return stopRoutine(&receiveThread,receivePipe);
+    coalesceWindow = (windowUs > 0) ? windowUs : NO_COALESCING;
+    coalesceTimeout.tv_sec = coalesceWindow/1000000;
+    coalesceTimeout.tv_nsec = coalesceWindow%1000000*1000LL;
+    coalesceBytes = bytes;
 }
 
 /**
- * starts the passed routine on a new thread. the thread id will be assigned to
- *   the passed thread id pointer.
- *
- * @function   Host::startRoutine
- *
- * @date       2015-03-18
+ * turns compression of large payloads sent to a peer on or off. turn it on
+ *   once the peer has said that it reads compressed frames; every host does,
+ *   but hosts that predate compression don't. payloads are only compressed
+ *   while the connection uses a framing newer than WIRE_V0.
  *
- * @revision   none
+ * @param socket socket of the peer.
+ * @param enabled non-zero to compress payloads sent to the peer.
  *
- * @designer   EricTsang
+ * @return SUCCESS, or SOCK_OP_FAIL if the socket isn't connected.
+ */
+int Host::setCompression(int socket, int enabled)
+{
+    std::shared_ptr<Connection> conn = findConnection(socket);
+    if(!conn)
+    {
+        return SOCK_OP_FAIL;
+    }
+    pthread_mutex_lock(&conn->sendLock);
+    conn->compress = enabled;
+    pthread_mutex_unlock(&conn->sendLock);
+    return SUCCESS;
+}
+
+/**
+ * sets the size of the smallest payload that is compressed for peers that
+ *   read compressed frames.
  *
- * @programmer EricTsang
+ * @param bytes the new threshold.
+ */
+void Host::setCompressThreshold(int bytes)
+{
+    compressThreshold = bytes;
+}
+
+/**
+ * sets how long a connection may go without receiving anything. half-open
+ *   connections, whose peer is gone without a word, are only noticed this
+ *   way; a peer that is merely quiet can be asked for a sign of life from
+ *   onIdle, e.g. a heartbeat message that it answers. set it before
+ *   connecting.
  *
- * @note       none
+ * @param pingMs time after which onIdle is called for the connection, and
+ *   again every as long while it stays idle, in milliseconds;
+ *   NO_IDLE_TIMEOUT to never call it.
+ * @param closeMs time after which the connection is closed, in milliseconds;
+ *   NO_IDLE_TIMEOUT to never close it.
+ */
+void Host::setIdleTimeout(int pingMs, int closeMs)
+{
+    pingTimeout = (pingMs > 0) ? pingMs : NO_IDLE_TIMEOUT;
+    closeTimeout = (closeMs > 0) ? closeMs : NO_IDLE_TIMEOUT;
+}
+
+/**
+ * runs a task on the first reactor's thread once a delay is over. tasks must
+ *   be quick, since the reactor reads none of its sockets meanwhile. tasks
+ *   still waiting when the host is deleted are dropped without being run.
+ *   may be called from any thread.
  *
- * @signature  int Host::startRoutine(pthread_t* thread, void* routine, int*
- *   controlPipe, void* params)
+ * @param delayMs time to wait for, in milliseconds.
+ * @param task function to run.
+ * @param arg passed to {task}.
+ */
+void Host::defer(int delayMs, void (*task)(void*), void* arg)
+{
+    DeferredTask* deferred = new DeferredTask;
+    wheel_timer_init(&deferred->timer,deferredTaskFired,deferred);
+    deferred->delay = (delayMs > 0) ? delayMs : 0;
+    deferred->task = task;
+    deferred->arg = arg;
+    postCommand(&reactors[0],DEFER_TASK,-1,deferred);
+}
+
+/**
+ * loads host names for connectAsync to resolve from a file laid out like
+ *   /etc/hosts, rather than from DNS; for tests. set it before connecting.
  *
- * @param      thread pointer to the thread id variable.
- * @param      routine function to execute on the thread.
- * @param      controlPipe pointer to an int[2] that holds the file descriptors
- *   of a unnamed FIFO unnamed pipe.
- * @param      params parameters to pass to the new thread.
+ * @param path path of the file.
  *
- * @return     [file_header] [class_header] [description]
+ * @return SUCCESS, or SYS_ERROR if the file can't be read; check errno for
+ *   details.
  */
-int Host::startRoutine(pthread_t* thread, void*(*routine)(void*), int* controlPipe, void* params)
+int Host::setHostsFile(const char* path)
 {
-    // return immediately if the routine is already running
+    return (resolver_load_hosts(&resolver,path) == -1) ? SYS_ERROR : SUCCESS;
+}
+
+/**
+ * sets how long connectAsync caches a resolved host name for. set it before
+ *   connecting.
+ *
+ * @param ttlMs the new time to live, in milliseconds.
+ */
+void Host::setResolveTtl(int ttlMs)
+{
+    resolver.ttl = (ttlMs > 0) ? ttlMs : 0;
+}
+
+/**
+ * sets how long connectAsync waits for a connection to be established, once
+ *   the remote host's name is resolved.
+ *
+ * @param timeoutMs the new timeout, in milliseconds.
+ */
+void Host::setConnectTimeout(int timeoutMs)
+{
+    connectTimeout = (timeoutMs > 0) ? timeoutMs : DEFAULT_CONNECT_TIMEOUT;
+}
+
+/**
+ * sets the unix domain path that the listen routine waits for a successor on.
+ *   a successor that connects, with takeOver, is handed the server sockets,
+ *   and every connection with its state, and the host serves nothing after
+ *   that; so a new version of a server can replace a running one without
+ *   its clients noticing. set it before the listen routine is started.
+ *
+ * @param path the path; 0 to not wait for a successor.
+ */
+void Host::setHandOffPath(const char* path)
+{
+    handOffPath = (path != 0) ? path : "";
+}
+
+/**
+ * takes over from a host that waits for a successor on a path, like one given
+ *   to setHandOffPath. the server sockets and connections that it hands off
+ *   are served from when the listen routine is started, which listens on the
+ *   server sockets that were handed off, rather than opening new ones; the
+ *   state saved by the other host's onHandOff is passed to onTakeOver for
+ *   each connection, in place of onConnect.
+ *
+ * @param path path that the other host waits for a successor on.
+ *
+ * @return SUCCESS once everything is handed off; SOCK_OP_FAIL if there is no
+ *   host to take over from, or it stopped part of the way, in which case
+ *   whatever was handed off until then is still served. INVALID_OPERATION if
+ *   the listen routine is already started.
+ */
+int Host::takeOver(const char* path)
+{
+    if(listenThread != 0)
+    {
+        return INVALID_OPERATION;
+    }
+    int predecessor = make_unix_client_socket(path);
+    if(predecessor == -1)
+    {
+        return SOCK_OP_FAIL;
+    }
+
+    int result = SOCK_OP_FAIL;
+    int numConnections = 0;
+    HandOffRecord record;
+    int fd;
+    while(recv_fd(predecessor,&fd,&record,sizeof(record)) ==
+        (int) sizeof(record))
+    {
+        std::string data(record.len > 0 ? record.len : 0,0);
+        if(read_file(predecessor,&data[0],data.size()) != (int) data.size())
+        {
+            if(fd != -1)
+            {
+                close(fd);
+            }
+            break;
+        }
+
+        if(record.type == HANDOFF_HELLO)
+        {
+            int version = -1;
+            if(data.size() == sizeof(version))
+            {
+                memcpy(&version,data.data(),sizeof(version));
+            }
+            if(version != HANDOFF_VERSION)
+            {
+                fprintf(stderr,"can't take over from hand-off version %d\n",
+                    version);
+                break;
+            }
+        }
+        else if(record.type == HANDOFF_SERVER && fd != -1)
+        {
+            svrSock = fd;
+        }
+        else if(record.type == HANDOFF_LOCAL && fd != -1)
+        {
+            localSock = fd;
+            localPath = data;
+        }
+        else if(record.type == HANDOFF_CONNECTION && fd != -1)
+        {
+            TakenOver taken;
+            taken.socket = fd;
+            taken.saved.swap(data);
+            takenOver.push_back(taken);
+            ++numConnections;
+        }
+        else if(record.type == HANDOFF_DONE)
+        {
+            result = SUCCESS;
+            break;
+        }
+        else if(fd != -1)
+        {
+            close(fd);
+        }
+    }
+    close(predecessor);
+
+    if(verbose)
+    {
+        printf("server: took over %d connections\n",numConnections);
+    }
+    return result;
+}
+
+/**
+ * returns non-zero once the host has handed off to a successor.
+ */
+int Host::handedOff()
+{
+    return isHandedOff.load();
+}
+
+/**
+ * sets how much a reactor reads from one socket before serving the next one,
+ *   so a busy peer can't starve the others. set it before connecting.
+ *
+ * @param bytes most bytes to read each time the socket is served.
+ * @param frames most frames to dispatch each time the socket is served.
+ */
+void Host::setReadBudget(int bytes, int frames)
+{
+    readBudget = (bytes > 0) ? bytes : 1;
+    frameBudget = (frames > 0) ? frames : 1;
+}
+
+/**
+ * turns the log lines printed by the default callbacks on or off; they are on
+ *   by default.
+ *
+ * @param verbose non-zero to print a line for every event.
+ */
+void Host::setVerbose(int verbose)
+{
+    this->verbose = verbose;
+}
+
+/**
+ * returns the backend that the host does its I/O with; EPOLL_BACKEND if
+ *   URING_BACKEND was asked for, but isn't supported.
+ */
+int Host::getBackend()
+{
+    return backend;
+}
+
+/**
+ * returns non-zero if callbacks should print a line for every event.
+ */
+int Host::isVerbose()
+{
+    return verbose;
+}
+
+int Host::connect(char* remoteName, short remotePort)
+{
+    // connect to remote host
+    int socket = make_tcp_client_socket(remoteName,0,remotePort,0);
+
+    if(socket != -1)
+    {
+        // communicate to a receive thread that a new socket is connected
+        addSocket(socket);
+    }
+
+    return (socket != -1) ? SUCCESS : SOCK_OP_FAIL;
+}
+
+/**
+ * connects to a host on the same machine through the unix domain path that it
+ *   listens on; the connection is then handled like a TCP one.
+ *
+ * @param localPath path that the host listens on.
+ *
+ * @return SUCCESS, or SOCK_OP_FAIL if the connection can't be established;
+ *   check errno for details.
+ */
+int Host::connectLocal(const char* localPath)
+{
+    int socket = make_unix_client_socket(localPath);
+
+    if(socket != -1)
+    {
+        addSocket(socket);
+    }
+
+    return (socket != -1) ? SUCCESS : SOCK_OP_FAIL;
+}
+
+/**
+ * connects to a remote host without blocking the calling thread. its name is
+ *   resolved through a cache, and looked up by a helper thread if it isn't
+ *   cached, then the connection is established by a reactor, along with its
+ *   other work; onConnect is called for it once it is, like for an accepted
+ *   one, or onConnectFailed if it fails. so opening many connections at once
+ *   doesn't wait for them one by one.
+ *
+ * @param remoteName name or dotted address of the remote host.
+ * @param remotePort the remote host's port.
+ *
+ * @return SUCCESS if connecting has started; INVALID_OPERATION if no name is
+ *   given.
+ */
+int Host::connectAsync(const char* remoteName, short remotePort)
+{
+    if(remoteName == 0)
+    {
+        return INVALID_OPERATION;
+    }
+    PendingConnect* pending = new PendingConnect;
+    pending->host = this;
+    pending->remoteName = strdup(remoteName);
+    pending->remotePort = remotePort;
+    pending->socket = -1;
+    pending->generation = 0;
+    pending->error = 0;
+    wheel_timer_init(&pending->timer,connectTimedOut,pending);
+    resolver_resolve(&resolver,remoteName,remoteResolved,pending);
+    return SUCCESS;
+}
+
+void Host::disconnect(int socket)
+{
+    // look up the reactor that owns the socket
+    std::shared_ptr<Connection> conn = findConnection(socket);
+
+    // communicate to its receive thread to remove an existing socket
+    if(conn)
+    {
+        postCommand(&reactors[conn->owner],RM_SOCK,socket);
+    }
+}
+
+/**
+ * sums up the receive counters of all reactors. dividing frames by reads gives
+ *   the average number of frames decoded per read system call.
+ *
+ * @param stats structure to store the totals in.
+ */
+void Host::getReceiveStats(ReceiveStats* stats)
+{
+    stats->reads = 0;
+    stats->frames = 0;
+    stats->bytes = 0;
+    stats->commands = 0;
+    stats->wakeups = 0;
+    stats->carryOvers = 0;
+    for(int i = 0; i < numReactors; ++i)
+    {
+        stats->reads += reactors[i].reads.load(std::memory_order_relaxed);
+        stats->frames += reactors[i].frames.load(std::memory_order_relaxed);
+        stats->bytes += reactors[i].bytes.load(std::memory_order_relaxed);
+        stats->commands +=
+            reactors[i].numCommands.load(std::memory_order_relaxed);
+        stats->wakeups += reactors[i].wakeups.load(std::memory_order_relaxed);
+        stats->carryOvers +=
+            reactors[i].carryOvers.load(std::memory_order_relaxed);
+    }
+}
+
+/**
+ * looks up how long a connected socket has waited to be served by its
+ *   receive loop.
+ *
+ * @param socket connected socket.
+ * @param stats filled in with the socket's service counters.
+ *
+ * @return SUCCESS; INVALID_OPERATION if the socket isn't connected.
+ */
+int Host::getServiceStats(int socket, ServiceStats* stats)
+{
+    std::shared_ptr<Connection> conn = findConnection(socket);
+    if(!conn)
+    {
+        return INVALID_OPERATION;
+    }
+    stats->services = conn->services.load(std::memory_order_relaxed);
+    stats->totalWait = conn->totalWait.load(std::memory_order_relaxed);
+    stats->maxWait = conn->maxWait.load(std::memory_order_relaxed);
+    return SUCCESS;
+}
+
+/**
+ * adds the time that every socket waited to be served, in nanoseconds, to a
+ *   histogram. with URING_BACKEND, that is the time each receive completion
+ *   waited behind the rest of its batch.
+ *
+ * @param histogram histogram to add the waits of all reactors to.
+ */
+void Host::getServiceLatency(Histogram* histogram)
+{
+    for(int i = 0; i < numReactors; ++i)
+    {
+        histogram_merge(histogram,&reactors[i].serviceLatency);
+    }
+}
+
+/**
+ * sums up the send counters of all sockets, connected or not anymore.
+ *
+ * @param stats structure to store the totals in.
+ */
+void Host::getSendStats(SendStats* stats)
+{
+    stats->writes = 0;
+    stats->frames = 0;
+    stats->bytes = 0;
+    stats->queuedFrames = 0;
+    stats->queuedBytes = 0;
+
+    // the counters of a socket move to its reactor as it is released, so
+    // both are read under the same lock, to count it once
+    std::vector<std::shared_ptr<Connection> > connected;
+    pthread_mutex_lock(&connectionsLock);
+    for(int i = 0; i < numReactors; ++i)
+    {
+        stats->writes += reactors[i].writes.load(std::memory_order_relaxed);
+        stats->frames +=
+            reactors[i].framesSent.load(std::memory_order_relaxed);
+        stats->bytes += reactors[i].bytesSent.load(std::memory_order_relaxed);
+        stats->queuedFrames +=
+            reactors[i].framesQueued.load(std::memory_order_relaxed);
+    }
+    for(size_t i = 0; i < connections.size(); ++i)
+    {
+        Connection* conn = connections[i].get();
+        if(conn != 0)
+        {
+            stats->writes += conn->writes.load(std::memory_order_relaxed);
+            stats->frames += conn->framesSent.load(std::memory_order_relaxed);
+            stats->bytes += conn->bytesSent.load(std::memory_order_relaxed);
+            stats->queuedFrames +=
+                conn->framesQueued.load(std::memory_order_relaxed);
+            connected.push_back(connections[i]);
+        }
+    }
+    pthread_mutex_unlock(&connectionsLock);
+
+    for(size_t i = 0; i < connected.size(); ++i)
+    {
+        pthread_mutex_lock(&connected[i]->sendLock);
+        stats->queuedBytes += connected[i]->outbound.bytes;
+        pthread_mutex_unlock(&connected[i]->sendLock);
+    }
+}
+
+/**
+ * looks up the traffic counters of a connected socket.
+ *
+ * @param socket connected socket.
+ * @param stats filled in with the socket's counters.
+ *
+ * @return SUCCESS; INVALID_OPERATION if the socket isn't connected.
+ */
+int Host::getConnectionStats(int socket, ConnectionStats* stats)
+{
+    std::shared_ptr<Connection> conn = findConnection(socket);
+    if(!conn)
+    {
+        return INVALID_OPERATION;
+    }
+    stats->framesReceived =
+        conn->framesReceived.load(std::memory_order_relaxed);
+    stats->bytesReceived = conn->bytesReceived.load(std::memory_order_relaxed);
+    stats->framesSent = conn->framesSent.load(std::memory_order_relaxed);
+    stats->bytesSent = conn->bytesSent.load(std::memory_order_relaxed);
+    stats->writes = conn->writes.load(std::memory_order_relaxed);
+    pthread_mutex_lock(&conn->sendLock);
+    stats->queuedBytes = conn->outbound.bytes;
+    pthread_mutex_unlock(&conn->sendLock);
+    stats->pendingEvents = conn->numEvents.load();
+    return SUCCESS;
+}
+
+/**
+ * adds the time spent in every call to onMessage, in nanoseconds, to a
+ *   histogram.
+ *
+ * @param histogram histogram to add the calls of all reactors' sockets to.
+ */
+void Host::getDispatchLatency(Histogram* histogram)
+{
+    for(int i = 0; i < numReactors; ++i)
+    {
+        histogram_merge(histogram,&reactors[i].dispatchLatency);
+    }
+}
+
+/**
+ * adds the time that write system calls on connected sockets took, in
+ *   nanoseconds, to a histogram; one in SEND_SAMPLE_RATE of each socket's
+ *   writes is timed.
+ *
+ * @param histogram histogram to add the writes of all reactors' sockets to.
+ */
+void Host::getSendLatency(Histogram* histogram)
+{
+    for(int i = 0; i < numReactors; ++i)
+    {
+        histogram_merge(histogram,&reactors[i].sendLatency);
+    }
+}
+
+/**
+ * prints the host's counters, and the latencies of its receive, dispatch and
+ *   send stages, as lines of text: the totals, then those of each reactor.
+ *
+ * @param file stream to print to.
+ */
+void Host::printStats(FILE* file)
+{
+    ReceiveStats received;
+    SendStats sent;
+    getReceiveStats(&received);
+    getSendStats(&sent);
+    fprintf(file,"received %llu frames, %llu bytes in %llu reads; "
+        "%llu carried over\n",received.frames,received.bytes,received.reads,
+        received.carryOvers);
+    fprintf(file,"sent %llu frames, %llu bytes in %llu writes; "
+        "%llu queued, %llu bytes waiting\n",sent.frames,sent.bytes,
+        sent.writes,sent.queuedFrames,sent.queuedBytes);
+    fprintf(file,"handled %llu commands in %llu wakeups\n",received.commands,
+        received.wakeups);
+
+    Histogram* histogram = new Histogram;
+    histogram_init(histogram);
+    getServiceLatency(histogram);
+    print_latency(file,"receive",histogram);
+    histogram_init(histogram);
+    getDispatchLatency(histogram);
+    print_latency(file,"dispatch",histogram);
+    histogram_init(histogram);
+    getSendLatency(histogram);
+    print_latency(file,"send",histogram);
+    delete histogram;
+
+    for(int i = 0; i < numReactors; ++i)
+    {
+        Reactor* reactor = &reactors[i];
+        pthread_mutex_lock(&connectionsLock);
+        int numSockets = reactor->numSockets;
+        pthread_mutex_unlock(&connectionsLock);
+        fprintf(file,"reactor %d: %d sockets, %llu frames, %llu bytes in "
+            "%llu reads; receive p99 %llu ns, dispatch p99 %llu ns, "
+            "send p99 %llu ns\n",i,numSockets,
+            reactor->frames.load(std::memory_order_relaxed),
+            reactor->bytes.load(std::memory_order_relaxed),
+            reactor->reads.load(std::memory_order_relaxed),
+            histogram_percentile(&reactor->serviceLatency,99.0),
+            histogram_percentile(&reactor->dispatchLatency,99.0),
+            histogram_percentile(&reactor->sendLatency,99.0));
+    }
+}
+
+/**
+ * writes printStats to a file every so often, replacing what was in it, so
+ *   a running host can be watched from outside. the file is written by a
+ *   thread of its own, so the reactors never wait on the disk. call it once.
+ *
+ * @param path file to write to; it is written to a file of the same name
+ *   ending in ".tmp" first, then renamed, so it is never seen half written.
+ * @param intervalMs time between writes, in milliseconds.
+ */
+void Host::setStatsDump(const char* path, int intervalMs)
+{
+    statsPath = path;
+    statsInterval = (intervalMs > 0) ? intervalMs : 1;
+    startRoutine(&statsThread,statsRoutine,statsPipe,this);
+}
+
+/**
+ * writes printStats to the stats file.
+ */
+void Host::dumpStats()
+{
+    std::string tmpPath = statsPath+".tmp";
+    FILE* file = fopen(tmpPath.c_str(),"w");
+    if(file == 0)
+    {
+        perror("failed to write stats");
+        return;
+    }
+    printStats(file);
+    if(fclose(file) == 0)
+    {
+        rename(tmpPath.c_str(),statsPath.c_str());
+    }
+}
+
+/**
+ * writes the stats file every statsInterval milliseconds, until the control
+ *   pipe is closed.
+ *
+ * @param params the host.
+ */
+void* Host::statsRoutine(void* params)
+{
+    Host* dis = (Host*) params;
+    struct pollfd control;
+    control.fd = dis->statsPipe[0];
+    control.events = POLLIN;
+    for(;;)
+    {
+        int numReady = poll(&control,1,dis->statsInterval);
+        if(numReady == 0)
+        {
+            dis->dumpStats();
+        }
+        else if(numReady != -1 || errno != EINTR)
+        {
+            break;
+        }
+    }
+    close(dis->statsPipe[0]);
+    return 0;
+}
+
+void Host::onConnect(int socket)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d connected\n",socket);
+}
+
+void Host::onMessage(int socket, Message& msg)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d: msg.type: %d, msg.data: ",socket,msg.type);
+    for(int i = 0; i < msg.len; ++i)
+    {
+        printf("%c",((char*)msg.data)[i]);
+    }
+    printf("\n");
+}
+
+void Host::onDisconnect(int socket, int remote)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d disconnected by %s host\n",
+        socket,remote?"remote":"local");
+}
+
+/**
+ * called from the sending thread when a message is dropped because the peer's
+ *   send queue is over the high-water mark.
+ *
+ * @param socket socket whose send queue is full.
+ */
+void Host::onQueueFull(int socket)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d send queue full\n",socket);
+}
+
+/**
+ * called when a connection that connectAsync started fails, from a worker, or
+ *   from the thread that noticed the failure without a worker pool.
+ *
+ * @param remoteName name of the remote host, as passed to connectAsync.
+ * @param remotePort port of the remote host.
+ * @param error errno value that connecting failed with; EHOSTUNREACH if the
+ *   name didn't resolve, and ETIMEDOUT if the connect timeout was over.
+ */
+void Host::onConnectFailed(const char* remoteName, short remotePort,
+    int error)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: failed to connect to %s:%d: %s\n",remoteName,
+        remotePort,strerror(error));
+}
+
+/**
+ * called when nothing has been received from a socket for the ping time of
+ *   setIdleTimeout, and again every as long while that stays so.
+ *
+ * @param socket socket that is idle.
+ */
+void Host::onIdle(int socket)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d idle\n",socket);
+}
+
+/**
+ * called when the host hands off to a successor, for each connection, once
+ *   the host has stopped handling them; the state that is saved is passed to
+ *   the successor's onTakeOver for the connection.
+ *
+ * @param socket socket of the connection.
+ * @param state set to the state to save; empty by default.
+ */
+void Host::onHandOff(int socket, std::string&)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d handed off\n",socket);
+}
+
+/**
+ * called once every connection has been handed off, before the successor is
+ *   told that the hand-off is complete; the host serves nothing after this.
+ */
+void Host::onHandedOff()
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: handed off to successor\n");
+}
+
+/**
+ * called in place of onConnect for a connection taken over from another
+ *   host, before any of its messages are passed to onMessage.
+ *
+ * @param socket socket of the connection.
+ * @param state state saved by the other host's onHandOff.
+ * @param len length of {state}.
+ */
+void Host::onTakeOver(int socket, const char*, int)
+{
+    if(!verbose)
+    {
+        return;
+    }
+    printf("server: socket %d taken over\n",socket);
+}
+
+/**
+ * hands a connected socket over to the reactor that owns the fewest sockets,
+ *   which adds it to its select set and calls onConnect. ties are broken
+ *   round-robin.
+ *
+ * @param socket connected socket to hand over.
+ */
+void Host::addSocket(int socket)
+{
+    set_non_blocking(socket);
+
+    std::shared_ptr<Connection> conn =
+        std::make_shared<Connection>(socket,0);
+    registerConnection(conn);
+
+    // communicate to the receive thread that a new socket is connected
+    postCommand(&reactors[conn->owner],ADD_SOCK,socket);
+
+    // tell the peer which framings the host reads
+    if(wireVersion != WIRE_V0)
+    {
+        sendHello(conn.get(),-1);
+    }
+}
+
+/**
+ * hands a socket taken over from another host over to a reactor, like
+ *   addSocket, with the connection state that the other host saved. its
+ *   framing was agreed on with the other host, so no hello is sent.
+ *
+ * @param socket socket taken over.
+ * @param saved SavedConnection of the socket, and the bytes after it.
+ */
+void Host::adoptSocket(int socket, const std::string& saved)
+{
+    SavedConnection header;
+    if(saved.size() < sizeof(header))
+    {
+        close(socket);
+        return;
+    }
+    memcpy(&header,saved.data(),sizeof(header));
+    if(header.receivedLen < 0 || header.queuedLen < 0 ||
+        header.stateLen < 0 || sizeof(header)+(size_t) header.receivedLen+
+        header.queuedLen+header.stateLen != saved.size())
+    {
+        close(socket);
+        return;
+    }
+    set_non_blocking(socket);
+
+    // restore the connection before it is registered, so nothing is sent to
+    // it ahead of what the other host left queued
+    std::shared_ptr<Connection> conn =
+        std::make_shared<Connection>(socket,0);
+    conn->sendVersion = header.sendVersion;
+    conn->decoder.version = header.receiveVersion;
+    conn->compress = header.compress;
+    const char* bytes = saved.data()+sizeof(header);
+    SharedFrame* queued = 0;
+    if(header.queuedLen > 0 &&
+        (queued = frame_alloc(header.queuedLen)) == 0)
+    {
+        close(socket);
+        return;
+    }
+    Adoption* adoption = new Adoption;
+    adoption->received.assign(bytes,header.receivedLen);
+    bytes += header.receivedLen;
+    if(queued != 0)
+    {
+        memcpy(queued->data,bytes,header.queuedLen);
+        outq_push_frame(&conn->outbound,queued,0,0,0);
+        frame_release(queued);
+        conn->watchingWritable = 1;
+        bytes += header.queuedLen;
+    }
+    adoption->state.assign(bytes,header.stateLen);
+    registerConnection(conn);
+
+    postCommand(&reactors[conn->owner],ADOPT_SOCK,socket,adoption);
+}
+
+/**
+ * makes the reactor that owns the fewest sockets the owner of a connection,
+ *   and records its state, so it can be looked up by its socket. ties are
+ *   broken round-robin.
+ *
+ * @param conn state of the connection.
+ */
+void Host::registerConnection(const std::shared_ptr<Connection>& conn)
+{
+    pthread_mutex_lock(&connectionsLock);
+
+    // pick the least loaded reactor, starting the search after the last pick
+    int owner = nextReactor;
+    for(int i = 1; i < numReactors; ++i)
+    {
+        int candidate = (nextReactor+i)%numReactors;
+        if(reactors[candidate].numSockets < reactors[owner].numSockets)
+        {
+            owner = candidate;
+        }
+    }
+    nextReactor = (owner+1)%numReactors;
+
+    // record the reactor as the socket's owner
+    ++reactors[owner].numSockets;
+    conn->owner = owner;
+    if(conn->socket >= (int) connections.size())
+    {
+        connections.resize(conn->socket+1);
+    }
+    connections[conn->socket] = conn;
+
+    pthread_mutex_unlock(&connectionsLock);
+}
+
+/**
+ * sends a hello to a connection's peer, describing the host's framing.
+ *
+ * @param conn connection to send the hello to.
+ * @param nextVersion framing that the host sends in after the hello; -1 to
+ *   keep the current one.
+ */
+void Host::sendHello(Connection* conn, int nextVersion)
+{
+    unsigned char hello[WIRE_HELLO_LEN];
+    hello[0] = (unsigned char) wireVersion;
+    hello[1] = (unsigned char) ((nextVersion != -1) ?
+        nextVersion : conn->sendVersion);
+
+    Message msg(WIRE_HELLO,hello,WIRE_HELLO_LEN);
+    Outgoing out(msg);
+    writeFrame(conn,&out,0,nextVersion);
+}
+
+/**
+ * handles a hello received from a connection's peer: decodes the frames
+ *   after it in the framing the peer now sends in, and switches to the
+ *   newest framing that both ends read. called by the owning reactor's
+ *   thread.
+ *
+ * @param conn connection that the hello was received on.
+ * @param msg the hello.
+ */
+void Host::receiveHello(Connection* conn, const Message& msg)
+{
+    if(msg.len < WIRE_HELLO_LEN)
+    {
+        return;
+    }
+    const unsigned char* hello = (const unsigned char*) msg.data;
+    int peerReads = hello[0];
+    int peerSends = hello[1];
+
+    // the peer may only switch to a framing that it was offered
+    if(peerSends > wireVersion)
+    {
+        shutdown(conn->socket,SHUT_RDWR);
+        return;
+    }
+    conn->decoder.version = peerSends;
+
+    int version = (peerReads < wireVersion) ? peerReads : wireVersion;
+    if(version > conn->sendVersion)
+    {
+        sendHello(conn,version);
+    }
+}
+
+/**
+ * queues a command for a reactor's thread, and wakes the thread up if it
+ *   hasn't been woken up already. commands queued while the thread is awake,
+ *   or already being woken up, cost no system calls at all. may be called from
+ *   any thread.
+ *
+ * @param reactor reactor to send the command to.
+ * @param type ADD_SOCK, ADOPT_SOCK, RM_SOCK, WATCH_SOCK, CORK_SOCK,
+ *   DEFER_TASK, CONNECT_SOCK or STOP_REACTOR.
+ * @param socket socket that the command applies to.
+ * @param data the DeferredTask of a DEFER_TASK command, the PendingConnect of
+ *   a CONNECT_SOCK command, or the Adoption of an ADOPT_SOCK command.
+ */
+void Host::postCommand(Reactor* reactor, int type, int socket, void* data)
+{
+    Command command;
+    command.type = type;
+    command.socket = socket;
+    command.data = data;
+    reactor->commands.push(command);
+
+    if(!reactor->signalled.exchange(1,std::memory_order_acq_rel))
+    {
+        uint64_t one = 1;
+        write(reactor->eventFd,&one,sizeof(one));
+        reactor->wakeups.fetch_add(1,std::memory_order_relaxed);
+    }
+}
+
+/**
+ * forgets the socket's connection state. must be called by the owning reactor
+ *   before it closes the socket, so the descriptor can be reused.
+ *
+ * @param socket socket that is being removed from its reactor.
+ */
+void Host::releaseSocket(int socket)
+{
+    std::shared_ptr<Connection> conn;
+
+    pthread_mutex_lock(&connectionsLock);
+    conn.swap(connections[socket]);
+    if(conn)
+    {
+        // keep the socket's send counters in its reactor's totals
+        Reactor* reactor = &reactors[conn->owner];
+        --reactor->numSockets;
+        reactor->framesSent.fetch_add(
+            conn->framesSent.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        reactor->bytesSent.fetch_add(
+            conn->bytesSent.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        reactor->writes.fetch_add(
+            conn->writes.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        reactor->framesQueued.fetch_add(
+            conn->framesQueued.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&connectionsLock);
+
+    // fail any sends still holding on to the connection
+    if(conn)
+    {
+        pthread_mutex_lock(&conn->sendLock);
+        conn->closed = 1;
+        outq_destroy(&conn->outbound);
+        pthread_mutex_unlock(&conn->sendLock);
+    }
+}
+
+/**
+ * looks up the state of a connected socket.
+ *
+ * @param socket socket to look up.
+ *
+ * @return the socket's connection state; empty if it isn't connected.
+ */
+std::shared_ptr<Host::Connection> Host::findConnection(int socket)
+{
+    std::shared_ptr<Connection> conn;
+    pthread_mutex_lock(&connectionsLock);
+    if(socket >= 0 && socket < (int) connections.size())
+    {
+        conn = connections[socket];
+    }
+    pthread_mutex_unlock(&connectionsLock);
+    return conn;
+}
+
+/**
+ * sends as much of the connection's send queue as its socket accepts. once the
+ *   queue is empty, its reactor stops waiting for the socket to be writable.
+ *
+ * @param conn connection to flush.
+ */
+void Host::flushConnection(Connection* conn)
+{
+    pthread_mutex_lock(&conn->sendLock);
+    if(!conn->closed)
+    {
+        flushQueue(conn);
+        if(outq_empty(&conn->outbound) && conn->watchingWritable)
+        {
+            // an io_uring poll only fires once, so there's nothing to undo
+            conn->watchingWritable = 0;
+            if(backend == EPOLL_BACKEND)
+            {
+                files_watch_writable(&reactors[conn->owner].files,
+                    conn->socket,0);
+            }
+        }
+    }
+    pthread_mutex_unlock(&conn->sendLock);
+}
+
+/**
+ * sends as much of a connection's send queue as its socket accepts, and
+ *   counts the write. if the socket failed, the queue is dropped, and the
+ *   socket is shut down, so its reactor reads the end of the stream and
+ *   closes the connection, as it does when a read fails. called with the
+ *   connection's sendLock held.
+ *
+ * @param conn connection to flush.
+ */
+void Host::flushQueue(Connection* conn)
+{
+    long queued = conn->outbound.bytes;
+    unsigned long long start = startWrite(conn);
+    int result = outq_flush(&conn->outbound,conn->socket);
+    countWrite(conn,start,queued-conn->outbound.bytes);
+    if(result == -1)
+    {
+        outq_destroy(&conn->outbound);
+        shutdown(conn->socket,SHUT_RDWR);
+    }
+}
+
+/**
+ * returns the time that a write on a connection's socket starts at, in
+ *   nanoseconds, if it is one of those timed; 0 otherwise. called with the
+ *   connection's sendLock held.
+ *
+ * @param conn connection about to be written to.
+ */
+unsigned long long Host::startWrite(Connection* conn)
+{
+    if(conn->writes.load(std::memory_order_relaxed)%SEND_SAMPLE_RATE != 0)
+    {
+        return 0;
+    }
+    return now_ns();
+}
+
+/**
+ * counts a write system call made on a connection's socket, and how long it
+ *   took, if it was timed. called with the connection's sendLock held.
+ *
+ * @param conn connection that was written to.
+ * @param start as returned by startWrite.
+ * @param bytes number of bytes written.
+ */
+void Host::countWrite(Connection* conn, unsigned long long start, long bytes)
+{
+    if(start != 0)
+    {
+        histogram_record(&reactors[conn->owner].sendLatency,now_ns()-start);
+    }
+    count(&conn->writes,1);
+    if(bytes > 0)
+    {
+        count(&conn->bytesSent,bytes);
+    }
+}
+
+/**
+ * sends the broadcasts held back for a connection, at the end of its
+ *   coalescing window. called by the owning reactor's thread.
+ *
+ * @param conn connection to send to.
+ */
+void Host::uncork(Connection* conn)
+{
+    pthread_mutex_lock(&conn->sendLock);
+    conn->corked = 0;
+    if(!conn->closed && !conn->watchingWritable)
+    {
+        flushQueue(conn);
+        if(!outq_empty(&conn->outbound))
+        {
+            conn->watchingWritable = 1;
+            watchWritable(conn);
+        }
+    }
+    pthread_mutex_unlock(&conn->sendLock);
+}
+
+/**
+ * makes the connection's reactor flush its send queue once its socket is
+ *   writable. called with the connection's sendLock held, from any thread.
+ *
+ * @param conn connection with a non-empty send queue.
+ */
+void Host::watchWritable(Connection* conn)
+{
+    if(backend == URING_BACKEND)
+    {
+        postCommand(&reactors[conn->owner],WATCH_SOCK,conn->socket);
+    }
+    else
+    {
+        files_watch_writable(&reactors[conn->owner].files,conn->socket,1);
+    }
+}
+
+/**
+ * gives a socket that was queued on its reactor its turn: reads from it, and
+ *   dispatches the frames received, until it runs dry, or its read budget is
+ *   used up. the time it waited for its turn is counted in the service stats.
+ *
+ * @param reactor reactor that owns the socket; must be the calling thread's.
+ * @param conn connection of the socket to serve.
+ *
+ * @return SERVE_DONE, SERVE_MORE if it should be served again, or
+ *   SERVE_CLOSED.
+ */
+int Host::serveConnection(Reactor* reactor,
+    const std::shared_ptr<Connection>& conn)
+{
+    unsigned long long now = now_ns();
+    unsigned long long wait = now-conn->readySince;
+    histogram_record(&reactor->serviceLatency,wait);
+    conn->services.fetch_add(1,std::memory_order_relaxed);
+    conn->totalWait.fetch_add(wait,std::memory_order_relaxed);
+    if(wait > conn->maxWait.load(std::memory_order_relaxed))
+    {
+        conn->maxWait.store(wait,std::memory_order_relaxed);
+    }
+
+    FrameDecoder* decoder = &conn->decoder;
+    int bytesLeft = readBudget;
+    int framesLeft = frameBudget;
+    int drained = 0;
+    int result;
+    unsigned long long numReads = 0;
+    unsigned long long numFrames = 0;
+    unsigned long long numBytes = 0;
+    while(1)
+    {
+        // dispatch the frames that have been received, up to the budget
+        int decoded = DECODE_PENDING;
+        while(framesLeft > 0 &&
+            (decoded = decoder_next(decoder)) == DECODE_COMPLETE)
+        {
+            dispatchMessage(conn,decoder->msg);
+            decoder_release(decoder);
+            --framesLeft;
+            ++numFrames;
+        }
+        if(decoded == DECODE_CLOSED)
+        {
+            result = SERVE_CLOSED;
+            break;
+        }
+        if(framesLeft == 0 || (!drained && bytesLeft <= 0))
+        {
+            result = SERVE_MORE;
+            break;
+        }
+        if(drained)
+        {
+            result = SERVE_DONE;
+            break;
+        }
+
+        // read whatever is available from the socket in one go; a read that
+        // doesn't fill the buffer has emptied the socket
+        int space = decoder_space(decoder);
+        int bytesRead = decoder_fill(decoder,conn->socket);
+        if(bytesRead == 0 || (bytesRead == -1 && errno != EAGAIN
+            && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            result = SERVE_CLOSED;
+            break;
+        }
+        if(bytesRead == -1)
+        {
+            result = SERVE_DONE;
+            break;
+        }
+        ++numReads;
+        numBytes += bytesRead;
+        bytesLeft -= bytesRead;
+        drained = bytesRead < space;
+    }
+
+    if(numBytes > 0)
+    {
+        conn->lastReceive = now/1000000;
+    }
+    count(&conn->framesReceived,numFrames);
+    count(&conn->bytesReceived,numBytes);
+    reactor->reads.fetch_add(numReads,std::memory_order_relaxed);
+    reactor->frames.fetch_add(numFrames,std::memory_order_relaxed);
+    reactor->bytes.fetch_add(numBytes,std::memory_order_relaxed);
+    return result;
+}
+
+/**
+ * calls onConnect for a socket that was just added to its reactor, or has a
+ *   worker call it.
+ *
+ * @param conn connection of the added socket.
+ */
+void Host::dispatchConnect(const std::shared_ptr<Connection>& conn)
+{
+    if(numWorkers == INLINE_HANDLERS)
+    {
+        onConnect(conn->socket);
+        return;
+    }
+
+    Event event;
+    event.type = EVENT_CONNECT;
+    event.remote = 0;
+    postEvent(conn,event);
+}
+
+/**
+ * calls onTakeOver for a socket that was just taken over from another host,
+ *   or has a worker call it, then handles what the other host received on
+ *   the socket, but didn't handle.
+ *
+ * @param conn connection of the socket.
+ * @param adoption state of the socket; deleted once it is handled.
+ *
+ * @return DECODE_CLOSED if an invalid frame was received; DECODE_PENDING
+ *   otherwise.
+ */
+int Host::dispatchTakeOver(const std::shared_ptr<Connection>& conn,
+    Adoption* adoption)
+{
+    if(numWorkers == INLINE_HANDLERS)
+    {
+        onTakeOver(conn->socket,adoption->state.data(),
+            adoption->state.size());
+    }
+    else
+    {
+        Event event;
+        event.type = EVENT_TAKEOVER;
+        event.msg = Message(0,adoption->state.data(),adoption->state.size());
+        event.msg.own();
+        event.remote = 0;
+        postEvent(conn,event);
+    }
+
+    unsigned long long numFrames = 0;
+    int decoded = feedConnection(conn,adoption->received.data(),
+        adoption->received.size(),&numFrames);
+    delete adoption;
+    return decoded;
+}
+
+/**
+ * copies bytes that were received into memory of their own into a
+ *   connection's decoder, and dispatches every whole frame, feeding the rest
+ *   whenever the decoder is full. called by the owning reactor's thread.
+ *
+ * @param conn connection that the bytes were received on.
+ * @param data received bytes.
+ * @param len number of received bytes.
+ * @param numFrames incremented for every frame dispatched.
+ *
+ * @return DECODE_CLOSED if an invalid frame was received; DECODE_PENDING
+ *   otherwise.
+ */
+int Host::feedConnection(const std::shared_ptr<Connection>& conn,
+    const char* data, int len, unsigned long long* numFrames)
+{
+    FrameDecoder* decoder = &conn->decoder;
+    int decoded = DECODE_PENDING;
+    while(len > 0 && decoded != DECODE_CLOSED)
+    {
+        int fed = decoder_feed(decoder,data,len);
+        data += fed;
+        len -= fed;
+        while((decoded = decoder_next(decoder)) == DECODE_COMPLETE)
+        {
+            dispatchMessage(conn,decoder->msg);
+            decoder_release(decoder);
+            ++*numFrames;
+        }
+    }
+    return decoded;
+}
+
+/**
+ * calls onIdle for an idle socket, or has a worker call it. called by the
+ *   owning reactor's thread.
+ *
+ * @param conn connection of the idle socket.
+ */
+void Host::dispatchIdle(Connection* conn)
+{
+    if(numWorkers == INLINE_HANDLERS)
+    {
+        onIdle(conn->socket);
+        return;
+    }
+
+    // the timer only holds on to the connection, not to an owner of it
+    std::shared_ptr<Connection> owner = findConnection(conn->socket);
+    if(owner.get() != conn)
+    {
+        return;
+    }
+    Event event;
+    event.type = EVENT_IDLE;
+    event.remote = 0;
+    postEvent(owner,event);
+}
+
+/**
+ * calls onMessage for a decoded frame, or has a worker call it. a worker gets
+ *   an owner of the frame, since a view into the receive buffer is only valid
+ *   until this returns.
+ *
+ * @param conn connection that the frame was received on.
+ * @param msg the decoded frame.
+ */
+void Host::dispatchMessage(const std::shared_ptr<Connection>& conn,
+    Message& msg)
+{
+    if(msg.type == WIRE_HELLO)
+    {
+        receiveHello(conn.get(),msg);
+        return;
+    }
+    if(numWorkers == INLINE_HANDLERS)
+    {
+        unsigned long long start = now_ns();
+        onMessage(conn->socket,msg);
+        histogram_record(&reactors[conn->owner].dispatchLatency,
+            now_ns()-start);
+        return;
+    }
+
+    Event event;
+    event.type = EVENT_MESSAGE;
+    event.msg = msg;
+    event.msg.own();
+    event.remote = 0;
+    postEvent(conn,event);
+}
+
+/**
+ * calls onDisconnect for a socket that its reactor stopped reading, and closes
+ *   it, or has a worker do so once it has called the socket's earlier
+ *   callbacks. the descriptor stays open until then, so it can't be reused
+ *   while handlers may still refer to it.
+ *
+ * @param conn connection of the closed socket.
+ * @param remote non-zero if the remote host closed the connection.
+ */
+void Host::dispatchDisconnect(const std::shared_ptr<Connection>& conn,
+    int remote)
+{
+    if(numWorkers == INLINE_HANDLERS)
+    {
+        closeSocket(conn->socket,remote);
+        return;
+    }
+
+    Event event;
+    event.type = EVENT_DISCONNECT;
+    event.remote = remote;
+    postEvent(conn,event);
+}
+
+/**
+ * queues a callback on the connection, and submits a task to call it unless
+ *   one is already submitted or running.
+ *
+ * @param conn connection to queue the callback on.
+ * @param event callback to queue.
+ */
+void Host::postEvent(const std::shared_ptr<Connection>& conn, Event& event)
+{
+    conn->events.push(event);
+    if(conn->numEvents.fetch_add(1) == 0)
+    {
+        StrandTask* task = new StrandTask;
+        task->host = this;
+        task->conn = conn;
+        workers_submit(&workers,runStrand,task);
+    }
+}
+
+/**
+ * calls onDisconnect, then forgets and closes the socket.
+ *
+ * @param socket socket that its reactor stopped reading.
+ * @param remote non-zero if the remote host closed the connection.
+ */
+void Host::closeSocket(int socket, int remote)
+{
+    onDisconnect(socket,remote);
+    releaseSocket(socket);
+    close(socket);
+}
+
+/**
+ * starts checking a socket that was just added to its reactor for idleness,
+ *   if the host has an idle timeout.
+ *
+ * @param reactor reactor that owns the socket; must be the calling thread's.
+ * @param conn connection of the added socket.
+ */
+void Host::watchIdle(Reactor* reactor, Connection* conn)
+{
+    conn->lastReceive = now_ms();
+    conn->lastIdle = 0;
+    if(pingTimeout != NO_IDLE_TIMEOUT || closeTimeout != NO_IDLE_TIMEOUT)
+    {
+        checkIdle(reactor,conn);
+    }
+}
+
+/**
+ * calls onIdle for, or closes, a connection that has been idle for long
+ *   enough, and arms its timer for when it next would be.
+ *
+ * @param reactor reactor that owns the socket; must be the calling thread's.
+ * @param conn connection to check.
+ */
+void Host::checkIdle(Reactor* reactor, Connection* conn)
+{
+    unsigned long long now = now_ms();
+    unsigned long long next = 0;
+    if(closeTimeout != NO_IDLE_TIMEOUT)
+    {
+        next = conn->lastReceive+closeTimeout;
+        if(next <= now)
+        {
+            // the peer is gone, or as good as gone
+            disconnect(conn->socket);
+            return;
+        }
+    }
+    if(pingTimeout != NO_IDLE_TIMEOUT)
+    {
+        unsigned long long since = (conn->lastIdle > conn->lastReceive) ?
+            conn->lastIdle : conn->lastReceive;
+        unsigned long long ping = since+pingTimeout;
+        if(ping <= now)
+        {
+            conn->lastIdle = now;
+            dispatchIdle(conn);
+            ping = now+pingTimeout;
+        }
+        if(next == 0 || ping < next)
+        {
+            next = ping;
+        }
+    }
+    wheel_arm(&reactor->wheel,&conn->idleTimer,next);
+}
+
+/**
+ * task run by a worker; calls a connection's queued callbacks in order. after
+ *   STRAND_BATCH of them, the task is queued again behind other tasks, so one
+ *   busy socket doesn't starve the rest.
+ *
+ * @param params points to a StrandTask; deleted once all callbacks are done.
+ */
+void Host::runStrand(void* params)
+{
+    StrandTask* task = (StrandTask*) params;
+    Host* dis = task->host;
+    Connection* conn = task->conn.get();
+
+    Event event;
+    int numCalled = 0;
+    while(numCalled < STRAND_BATCH && conn->events.pop(&event))
+    {
+        switch(event.type)
+        {
+        case EVENT_CONNECT:
+            dis->onConnect(conn->socket);
+            break;
+        case EVENT_MESSAGE:
+            {
+                unsigned long long start = now_ns();
+                dis->onMessage(conn->socket,event.msg);
+                histogram_record(&dis->reactors[conn->owner].dispatchLatency,
+                    now_ns()-start);
+            }
+            break;
+        case EVENT_IDLE:
+            dis->onIdle(conn->socket);
+            break;
+        case EVENT_DISCONNECT:
+            dis->closeSocket(conn->socket,event.remote);
+            break;
+        case EVENT_TAKEOVER:
+            dis->onTakeOver(conn->socket,(const char*) event.msg.data,
+                event.msg.len);
+            break;
+        }
+        event.msg = Message();
+        ++numCalled;
+    }
+
+    // keep going while callbacks are left; they may have been queued after
+    // the last pop, but in that case, they are already counted
+    if(conn->numEvents.fetch_sub(numCalled)-numCalled > 0)
+    {
+        workers_submit(&dis->workers,runStrand,task);
+    }
+    else
+    {
+        delete task;
+
+        // a host handing off waits for the callbacks of every connection to
+        // run out; handingOff is set before it checks numEvents, so one of
+        // the two sees the other
+        if(dis->handingOff)
+        {
+            pthread_mutex_lock(&dis->drainLock);
+            pthread_cond_broadcast(&dis->drained);
+            pthread_mutex_unlock(&dis->drainLock);
+        }
+    }
+}
+
+/**
+ * callback of a connection's idle timer.
+ *
+ * @param context reactor that owns the connection.
+ * @param arg the connection.
+ */
+void Host::idleTimerFired(void* context, void* arg)
+{
+    Reactor* reactor = (Reactor*) context;
+    reactor->host->checkIdle(reactor,(Connection*) arg);
+}
+
+/**
+ * callback of a DeferredTask's timer; runs the task, and deletes it.
+ *
+ * @param context reactor that runs the task.
+ * @param arg the DeferredTask.
+ */
+void Host::deferredTaskFired(void* context, void* arg)
+{
+    DeferredTask* deferred = (DeferredTask*) arg;
+    (void) context;
+    deferred->task(deferred->arg);
+    delete deferred;
+}
+
+/**
+ * disarms every timer of a terminating reactor, and deletes the deferred
+ *   tasks that haven't run. the timers of connections being established
+ *   belong to them, and are freed by dropConnects.
+ *
+ * @param reactor reactor that is terminating; must be the calling thread's.
+ */
+void Host::clearTimers(Reactor* reactor)
+{
+    Timer* timer;
+    while((timer = wheel_take(&reactor->wheel)) != 0)
+    {
+        if(timer->callback == deferredTaskFired)
+        {
+            delete (DeferredTask*) timer->arg;
+        }
+    }
+}
+
+/**
+ * callback of a resolver lookup for connectAsync; starts connecting to the
+ *   address, and has a reactor wait for the connection.
+ *
+ * @param arg the PendingConnect.
+ * @param result RESOLVE_OK, or the lookup's error.
+ * @param addr address of the remote host, if it resolved.
+ */
+void Host::remoteResolved(void* arg, int result, const struct in_addr* addr)
+{
+    PendingConnect* pending = (PendingConnect*) arg;
+    Host* dis = pending->host;
+    if(result != RESOLVE_OK)
+    {
+        dis->failConnect(pending,EHOSTUNREACH);
+        return;
+    }
+
+    struct sockaddr_in remote;
+    memset(&remote,0,sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(pending->remotePort);
+    remote.sin_addr = *addr;
+    if(dis->reactorsStopped)
+    {
+        // no reactor is left to wait for the connection
+        dis->failConnect(pending,ECANCELED);
+        return;
+    }
+    if((pending->socket = start_tcp_connect(&remote)) == -1)
+    {
+        dis->failConnect(pending,errno);
+        return;
+    }
+
+    // connecting sockets are spread over the reactors by descriptor; they
+    // are placed like any other once they are connected
+    dis->postCommand(&dis->reactors[pending->socket%dis->numReactors],
+        CONNECT_SOCK,pending->socket,pending);
+}
+
+/**
+ * starts waiting for a socket that connectAsync is connecting, for up to the
+ *   connect timeout. URING_BACKEND submits the wait itself.
+ *
+ * @param reactor reactor that waits; must be the calling thread's.
+ * @param pending the connection.
+ */
+void Host::watchConnect(Reactor* reactor, PendingConnect* pending)
+{
+    reactor->connecting[pending->socket] = pending;
+    wheel_arm(&reactor->wheel,&pending->timer,now_ms()+connectTimeout);
+    if(backend == EPOLL_BACKEND)
+    {
+        files_add_file(&reactor->files,pending->socket);
+        files_watch_writable(&reactor->files,pending->socket,1);
+    }
+}
+
+/**
+ * stops waiting for a socket that connectAsync is connecting, and hands it
+ *   over to addSocket if it is connected, or reports the failure.
+ *
+ * @param reactor reactor that waited; must be the calling thread's.
+ * @param pending the connection.
+ * @param timedOut non-zero if the connect timeout is over.
+ */
+void Host::finishConnect(Reactor* reactor, PendingConnect* pending,
+    int timedOut)
+{
+    int socket = pending->socket;
+    reactor->connecting.erase(socket);
+    wheel_cancel(&reactor->wheel,&pending->timer);
+    if(backend == EPOLL_BACKEND)
+    {
+        files_rm_file(&reactor->files,socket);
+    }
+    else if(timedOut)
+    {
+        // the wait is still in flight; cancel it before closing the socket
+        uring_prep_cancel_fd(uring_get_sqe(&reactor->ring),socket,
+            uring_user_data(URING_CANCEL,pending->generation,socket));
+        uring_submit(&reactor->ring,0);
+    }
+
+    int error = timedOut ? ETIMEDOUT : finish_tcp_connect(socket);
+    if(error != 0)
+    {
+        close(socket);
+        failConnect(pending,error);
+        return;
+    }
+    addSocket(socket);
+    free(pending->remoteName);
+    delete pending;
+}
+
+/**
+ * calls onConnectFailed for a connection that connectAsync started, or has a
+ *   worker call it, unless the workers are stopped already, and deletes the
+ *   connection.
+ *
+ * @param pending the connection; its socket is closed already.
+ * @param error errno value to pass to onConnectFailed.
+ */
+void Host::failConnect(PendingConnect* pending, int error)
+{
+    pending->error = error;
+    if(numWorkers == INLINE_HANDLERS || workers.threads == 0)
+    {
+        runConnectFailed(pending);
+    }
+    else
+    {
+        workers_submit(&workers,runConnectFailed,pending);
+    }
+}
+
+/**
+ * calls onConnectFailed for a failed connection, and deletes it.
+ *
+ * @param params points to the PendingConnect.
+ */
+void Host::runConnectFailed(void* params)
+{
+    PendingConnect* pending = (PendingConnect*) params;
+    pending->host->onConnectFailed(pending->remoteName,pending->remotePort,
+        pending->error);
+    free(pending->remoteName);
+    delete pending;
+}
+
+/**
+ * callback of a PendingConnect's timer; gives up on the connection.
+ *
+ * @param context reactor that waits for the connection.
+ * @param arg the PendingConnect.
+ */
+void Host::connectTimedOut(void* context, void* arg)
+{
+    Reactor* reactor = (Reactor*) context;
+    reactor->host->finishConnect(reactor,(PendingConnect*) arg,1);
+}
+
+/**
+ * closes the sockets that a terminating reactor was waiting on to be
+ *   connected, and deletes their connections, without reporting them.
+ *
+ * @param reactor reactor that is terminating; must be the calling thread's,
+ *   with its timers cleared already.
+ */
+void Host::dropConnects(Reactor* reactor)
+{
+    for(auto it = reactor->connecting.begin();
+        it != reactor->connecting.end(); ++it)
+    {
+        if(backend == EPOLL_BACKEND)
+        {
+            files_rm_file(&reactor->files,it->first);
+        }
+        close(it->first);
+        free(it->second->remoteName);
+        delete it->second;
+    }
+    reactor->connecting.clear();
+}
+
+/**
+ * frees the commands that were posted to a reactor after its thread
+ *   terminated, closing the sockets that they would have added.
+ *
+ * @param reactor reactor that is terminated.
+ */
+void Host::dropCommands(Reactor* reactor)
+{
+    Command command;
+    while(reactor->commands.pop(&command))
+    {
+        switch(command.type)
+        {
+        case ADD_SOCK:
+            close(command.socket);
+            break;
+        case ADOPT_SOCK:
+            close(command.socket);
+            delete (Adoption*) command.data;
+            break;
+        case DEFER_TASK:
+            delete (DeferredTask*) command.data;
+            break;
+        case CONNECT_SOCK:
+            {
+                PendingConnect* pending = (PendingConnect*) command.data;
+                close(pending->socket);
+                free(pending->remoteName);
+                delete pending;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * creates the state of a newly connected socket.
+ *
+ * @param socket the connected socket.
+ * @param owner index of the reactor that owns the socket.
+ */
+Host::Connection::Connection(int socket, int owner)
+{
+    this->socket = socket;
+    this->owner = owner;
+    decoder_init(&decoder);
+    pthread_mutex_init(&sendLock,0);
+    outq_init(&outbound);
+    watchingWritable = 0;
+    closed = 0;
+    sendVersion = WIRE_V0;
+    corked = 0;
+    compress = 0;
+    numEvents = 0;
+    backlogged = 0;
+    readySince = 0;
+    services = 0;
+    totalWait = 0;
+    maxWait = 0;
+    framesReceived = 0;
+    bytesReceived = 0;
+    framesSent = 0;
+    bytesSent = 0;
+    writes = 0;
+    framesQueued = 0;
+    wheel_timer_init(&idleTimer,idleTimerFired,this);
+    lastReceive = 0;
+    lastIdle = 0;
+}
+
+/**
+ * frees the state of a socket once nothing refers to it anymore.
+ */
+Host::Connection::~Connection()
+{
+    decoder_destroy(&decoder);
+    outq_destroy(&outbound);
+    pthread_mutex_destroy(&sendLock);
+}
+
+/**
+ * @param msg message to send; must outlive the Outgoing. its encoded frame is
+ *   used, if it owns one.
+ */
+Host::Outgoing::Outgoing(const Message& msg) : msg(msg)
+{
+    frame = msg.encodedFrame();
+    if(frame != 0)
+    {
+        frame_retain(frame);
+    }
+    packed = 0;
+    packTried = 0;
+}
+
+/**
+ * releases the frames made from the message; sockets that queued them hold
+ *   references of their own.
+ */
+Host::Outgoing::~Outgoing()
+{
+    if(frame != 0)
+    {
+        frame_release(frame);
+    }
+    if(packed != 0)
+    {
+        frame_release(packed);
+    }
+}
+
+/**
+ * starts the receive thread of every reactor.
+ *
+ * @return SUCCESS if all reactors were started; INVALID_OPERATION if any of
+ *   them was already running.
+ */
+int Host::startReceiveRoutine()
+{
+    int result = SUCCESS;
+    for(int i = 0; i < numReactors; ++i)
+    {
+        Reactor* reactor = &reactors[i];
+        if(reactor->thread != 0)
+        {
+            result = INVALID_OPERATION;
+            continue;
+        }
+
+        // create the eventfd that wakes the thread up for commands
+        if((reactor->eventFd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC))
+            == SYS_ERROR)
+        {
+            fatal_error("failed to create the reactor's eventfd");
+        }
+        reactor->signalled = 0;
+
+        // start the thread
+        pthread_create(&reactor->thread,0,
+            (backend == URING_BACKEND) ? uringReceiveRoutine : receiveRoutine,
+            reactor);
+    }
+    return result;
+}
+
+/**
+ * stops the receive thread of every reactor, disconnecting all their sockets.
+ *   their eventfds are left open, since other threads may still post commands
+ *   to them; the host closes them once it is deleted.
+ *
+ * @return SUCCESS if all reactors were stopped; INVALID_OPERATION if any of
+ *   them was already stopped.
+ */
+int Host::stopReceiveRoutine()
+{
+    int result = SUCCESS;
+    reactorsStopped = 1;
+    for(int i = 0; i < numReactors; ++i)
+    {
+        Reactor* reactor = &reactors[i];
+        if(reactor->thread == 0)
+        {
+            result = INVALID_OPERATION;
+            continue;
+        }
+
+        // tell the thread to terminate, and wait for it to do so
+        postCommand(reactor,STOP_REACTOR,-1);
+        pthread_join(reactor->thread,0);
+
+        // set thread to 0, so we know it's terminated
+        reactor->thread = 0;
+    }
+    return result;
+}
+
+/**
+ * starts the passed routine on a new thread. the thread id will be assigned to
+ *   the passed thread id pointer.
+ *
+ * @function   Host::startRoutine
+ *
+ * @date       2015-03-18
+ *
+ * @revision   none
+ *
+ * @designer   EricTsang
+ *
+ * @programmer EricTsang
+ *
+ * @note       none
+ *
+ * @signature  int Host::startRoutine(pthread_t* thread, void* routine, int*
+ *   controlPipe, void* params)
+ *
+ * @param      thread pointer to the thread id variable.
+ * @param      routine function to execute on the thread.
+ * @param      controlPipe pointer to an int[2] that holds the file descriptors
+ *   of a unnamed FIFO unnamed pipe.
+ * @param      params parameters to pass to the new thread.
+ *
+ * @return     [file_header] [class_header] [description]
+ */
+int Host::startRoutine(pthread_t* thread, void*(*routine)(void*), int* controlPipe, void* params)
+{
+    // return immediately if the routine is already running
     if(*thread != 0)
     {
         return INVALID_OPERATION;
     }
 
-    // create the control pipe
-    if(pipe(controlPipe) == SYS_ERROR)
-    {
-        fatal_error("failed to create the control pipe");
-    }
+    // create the control pipe
+    if(pipe(controlPipe) == SYS_ERROR)
+    {
+        fatal_error("failed to create the control pipe");
+    }
+
+    // start the thread
+    pthread_create(thread,0,routine,params);
+    return SUCCESS;
+}
+
+/**
+ * stops a thread from executing a routine by communicating to it through an IPC
+ *   pipe.
+ *
+ * @function   Host::stopRoutine
+ *
+ * @date       2015-03-18
+ *
+ * @revision   none
+ *
+ * @designer   EricTsang
+ *
+ * @programmer EricTsang
+ *
+ * @note       none
+ *
+ * @signature  int Host::stopRoutine(pthread_t* thread, int* controlPipe)
+ *
+ * @param      thread pointer to a thread id variable.
+ * @param      controlPipe pointer to an integer array of size 2, used to hold
+ *   the read and write file descriptors of a pipe.
+ *
+ * @return     integer values indicating the outcome of the operation.
+ */
+int Host::stopRoutine(pthread_t* thread, int* controlPipe)
+{
+    // return immediately if the routine is already stopped
+    if(*thread == 0)
+    {
+        return INVALID_OPERATION;
+    }
+
+    // close the control pipe which terminates the thread
+    close(controlPipe[1]);
+    pthread_join(*thread,0);
+
+    // set thread to 0, so we know it's terminated
+    *thread = 0;
+    return SUCCESS;
+}
+
+/**
+ * forgets the server sockets once the listen routine has closed them, and
+ *   removes the files that they were bound to, so clients can't connect to a
+ *   dead path; unless they were handed off, and the successor serves them.
+ */
+void Host::releaseListeners()
+{
+    if(!isHandedOff)
+    {
+        if(localSock != -1 && localPath[0] != '@')
+        {
+            unlink(localPath.c_str());
+        }
+        if(handOffSock != -1 && handOffPath[0] != '@')
+        {
+            unlink(handOffPath.c_str());
+        }
+    }
+    svrSock = -1;
+    localSock = -1;
+    handOffSock = -1;
+    localPath.clear();
+}
+
+/**
+ * hands the server sockets, and every connection with its state, off to a
+ *   successor, then stops serving. the reactors are stopped without closing
+ *   their sockets, and the callbacks queued until then are finished, so the
+ *   state of each connection doesn't change while it is saved. connections
+ *   that can't be handed off, because the successor went away, are closed.
+ *   called by the listen thread.
+ *
+ * @param successor socket connected to the successor.
+ */
+void Host::handOff(int successor)
+{
+    handingOff = 1;
+    stopReceiveRoutine();
+
+    // wait for the workers to finish the callbacks queued on every connection
+    std::vector<std::shared_ptr<Connection> > handed;
+    pthread_mutex_lock(&connectionsLock);
+    for(size_t i = 0; i < connections.size(); ++i)
+    {
+        if(connections[i])
+        {
+            handed.push_back(connections[i]);
+        }
+    }
+    pthread_mutex_unlock(&connectionsLock);
+    pthread_mutex_lock(&drainLock);
+    for(size_t i = 0; i < handed.size(); ++i)
+    {
+        while(handed[i]->numEvents.load() != 0)
+        {
+            pthread_cond_wait(&drained,&drainLock);
+        }
+    }
+    pthread_mutex_unlock(&drainLock);
+
+    // send the server sockets, then the connections not closed meanwhile
+    int version = HANDOFF_VERSION;
+    int sent = (sendRecord(successor,HANDOFF_HELLO,-1,&version,
+        sizeof(version)) == SUCCESS && sendRecord(successor,HANDOFF_SERVER,
+        svrSock,0,0) == SUCCESS);
+    if(sent && localSock != -1)
+    {
+        sent = (sendRecord(successor,HANDOFF_LOCAL,localSock,
+            localPath.data(),localPath.size()) == SUCCESS);
+    }
+    for(size_t i = 0; i < handed.size(); ++i)
+    {
+        int socket = handed[i]->socket;
+        if(findConnection(socket) != handed[i])
+        {
+            continue;
+        }
+
+        std::string saved;
+        if(sent)
+        {
+            saveConnection(handed[i].get(),&saved);
+            sent = (sendRecord(successor,HANDOFF_CONNECTION,socket,
+                saved.data(),saved.size()) == SUCCESS);
+        }
+        if(sent)
+        {
+            releaseSocket(socket);
+            close(socket);
+        }
+        else
+        {
+            closeSocket(socket,0);
+        }
+    }
+
+    onHandedOff();
+    isHandedOff = 1;
+    if(sent)
+    {
+        sendRecord(successor,HANDOFF_DONE,-1,0,0);
+    }
+}
+
+/**
+ * saves what a successor needs to go on serving a connection: its framing,
+ *   what was received on it, but not handled yet, what is queued to be sent
+ *   on it, and the state saved by onHandOff.
+ *
+ * @param conn connection to save; its reactor must be stopped.
+ * @param saved set to a SavedConnection, and the bytes after it.
+ *
+ * @return number of bytes saved.
+ */
+int Host::saveConnection(Connection* conn, std::string* saved)
+{
+    std::string state;
+    onHandOff(conn->socket,state);
+
+    SavedConnection header;
+    pthread_mutex_lock(&conn->sendLock);
+    header.sendVersion = conn->sendVersion;
+    header.receiveVersion = conn->decoder.version;
+    header.compress = conn->compress;
+    header.receivedLen = decoder_unread_len(&conn->decoder);
+    header.queuedLen = conn->outbound.bytes;
+    header.stateLen = state.size();
+    saved->resize(sizeof(header)+header.receivedLen+header.queuedLen+
+        header.stateLen);
+    char* bytes = &(*saved)[0];
+    memcpy(bytes,&header,sizeof(header));
+    bytes += sizeof(header);
+    decoder_unread(&conn->decoder,bytes);
+    bytes += header.receivedLen;
+    outq_copy(&conn->outbound,bytes);
+    bytes += header.queuedLen;
+    pthread_mutex_unlock(&conn->sendLock);
+    memcpy(bytes,state.data(),header.stateLen);
+
+    return saved->size();
+}
+
+/**
+ * sends one record of a hand-off to the successor.
+ *
+ * @param successor socket connected to the successor.
+ * @param type HANDOFF_HELLO, HANDOFF_SERVER, HANDOFF_LOCAL,
+ *   HANDOFF_CONNECTION or HANDOFF_DONE.
+ * @param fd file to pass along with the record; -1 if there is none.
+ * @param data body of the record.
+ * @param len length of {data}.
+ *
+ * @return SUCCESS if the whole record was sent; SOCK_OP_FAIL otherwise.
+ */
+int Host::sendRecord(int successor, int type, int fd, const void* data,
+    int len)
+{
+    HandOffRecord record;
+    record.type = type;
+    record.len = len;
+    if(send_fd(successor,fd,&record,sizeof(record)) != (int) sizeof(record) ||
+        write_file(successor,data,len) != len)
+    {
+        return SOCK_OP_FAIL;
+    }
+    return SUCCESS;
+}
+
+/**
+ * function run on a thread. it polls the server socket, accepting connections.
+ *
+ * @param params thread parameters; points to the calling server instance.
+ */
+void* Host::listenRoutine(void* params)
+{
+    printf("listenroutine started...\n");
+    fflush(stdout);
+    // parse thread parameters
+    Host* dis = (Host*) params;
+
+    int terminateThread = 0;
+
+    // set up the socket set & client list
+    Files files;
+    files_init(&files);
+
+    // add the server sockets and control pipe to the select set
+    files_add_file(&files,dis->svrSock);
+    if(dis->localSock != -1)
+    {
+        files_add_file(&files,dis->localSock);
+    }
+    if(dis->handOffSock != -1)
+    {
+        files_add_file(&files,dis->handOffSock);
+    }
+    files_add_file(&files,dis->listenPipe[0]);
+
+    // accept any connection requests, and create a session for each
+    while(!terminateThread && dis->svrSock != -1)
+    {
+        // wait for an event on any socket to occur
+        int numReady;
+        if((numReady = files_select(&files)) == -1)
+        {
+            fatal_error("failed on select");
+        }
+
+        // loop through the ready sockets, and handle them
+        for(int i = 0; i < numReady && !terminateThread; ++i)
+        {
+            int curSock = files_ready_fd(&files,i);
+
+            // handle socket activity depending on which socket it is
+            if(curSock == dis->svrSock || curSock == dis->localSock)
+            {
+                /*
+                 * this is a server socket, try to accept a connection.
+                 *
+                 * if the operation fails, end the server thread, because when
+                 *   accept fails, it means that the server socket is closed.
+                 *
+                 * if accept succeeds, add it to the select set, and continue
+                 *   looping...
+                 */
+
+                // accept the connection
+                int newSock;
+                if((newSock = accept(curSock,0,0)) == -1)
+                {
+                    // accept failed; server socket closed, terminate thread
+                    terminateThread = 1;
+                }
+                else
+                {
+                    // accept success; add the socket to a receive thread.
+                    dis->addSocket(newSock);
+                }
+            }
+
+            if(curSock == dis->handOffSock)
+            {
+                /*
+                 * this is the hand-off socket. a successor connected; hand
+                 *   everything off to it, and terminate the thread, leaving
+                 *   connections not accepted yet for the successor.
+                 */
+
+                int successor;
+                if((successor = accept(curSock,0,0)) != -1)
+                {
+                    dis->handOff(successor);
+                    close(successor);
+                }
+                terminateThread = 1;
+            }
+
+            if(curSock == dis->listenPipe[0])
+            {
+                /*
+                 * this is the control pipe. whenever anything happens on the
+                 *   control pipe, it means it's time for the server to
+                 *   shutdown; break out of the server loop.
+                 */
+
+                 terminateThread = 1;
+            }
+        }
+    }
+
+    // close all file descriptors before terminating
+    for(auto socketIt = files.fdSet.begin(); socketIt != files.fdSet.end();
+        ++socketIt)
+    {
+        close(*socketIt);
+    }
+    dis->releaseListeners();
+
+    files_destroy(&files);
+
+    printf("listenroutine stopped...\n");
+    fflush(stdout);
+
+    return 0;
+}
+
+void* Host::receiveRoutine(void* params)
+{
+    printf("receiveroutine started...\n");
+    fflush(stdout);
+
+    // parse thread parameters
+    Reactor* reactor = (Reactor*) params;
+    Host* dis = reactor->host;
+
+    // used to break the while loop
+    int terminateThread = 0;
+
+    // set of sockets that have been shutdown from local host
+    std::set<int> shutdownSocks;
+
+    // state of each socket owned by this reactor
+    std::map<int,std::shared_ptr<Connection> > sockets;
+
+    // sockets with data to read or dispatch, in the order they are served
+    std::deque<std::shared_ptr<Connection> > backlog;
+
+    // sockets with broadcasts held back, by when their window is over; every
+    // window is as long, so the earliest to end is always at the front
+    std::deque<std::pair<unsigned long long,std::shared_ptr<Connection> > >
+        corked;
+
+    // set up the socket set & client list
+    Files* files = &reactor->files;
+    files_init(files);
+
+    // add the command eventfd to the select set
+    files_add_file(files,reactor->eventFd);
+
+    // start the clock of the reactor's timers
+    wheel_init(&reactor->wheel,now_ms(),reactor);
+
+    // accept any connection requests, and create a session for each
+    while(!terminateThread)
+    {
+        // wait for an event on any socket to occur; don't wait at all if
+        // work was carried over from the last cycle, and no longer than until
+        // the next coalescing window is over, or the next timer is due
+        int timeout = -1;
+        if(!backlog.empty())
+        {
+            timeout = 0;
+        }
+        else if(!corked.empty())
+        {
+            unsigned long long now = now_ns();
+            timeout = (corked.front().first <= now) ? 0 :
+                (int) ((corked.front().first-now+999999)/1000000);
+        }
+        long long due = wheel_next_expiry(&reactor->wheel);
+        if(timeout != 0 && due != -1)
+        {
+            unsigned long long now = now_ms();
+            int untilDue = (due <= (long long) now) ? 0 : (int) (due-now);
+            if(timeout == -1 || untilDue < timeout)
+            {
+                timeout = untilDue;
+            }
+        }
+        int numReady;
+        if((numReady = files_select(files,timeout)) == -1)
+        {
+            fatal_error("failed on select");
+        }
+        unsigned long long now = now_ns();
+
+        // loop through the ready sockets, and handle them
+        for(int i = 0; i < numReady; ++i)
+        {
+            int curSock = files_ready_fd(files,i);
+
+            // skip sockets that were removed after being selected
+            if(curSock == -1)
+            {
+                continue;
+            }
+
+            // handle socket activity depending on which socket it is
+            if(curSock == reactor->eventFd)
+            {
+                /*
+                 * this is the reactor's eventfd. other threads have queued
+                 *   commands for this thread; carry out all of them.
+                 *
+                 * the eventfd is reset, and the signalled flag cleared before
+                 *   draining the queue, so commands queued from here on wake
+                 *   the thread up again.
+                 */
+
+                uint64_t numSignals;
+                read(reactor->eventFd,&numSignals,sizeof(numSignals));
+                reactor->signalled.exchange(0,std::memory_order_acq_rel);
+
+                Command command;
+                unsigned long long numCommands = 0;
+                while(reactor->commands.pop(&command))
+                {
+                    int socket = command.socket;
+                    ++numCommands;
+                    switch(command.type)
+                    {
+                    case ADD_SOCK:
+                    case ADOPT_SOCK:
+                        {
+                            std::shared_ptr<Connection> conn =
+                                dis->findConnection(socket);
+                            sockets[socket] = conn;
+                            files_add_file(files,socket);
+
+                            // catch up on sends that were queued before the
+                            // socket was selected
+                            pthread_mutex_lock(&conn->sendLock);
+                            if(conn->watchingWritable)
+                            {
+                                files_watch_writable(files,socket,1);
+                            }
+                            pthread_mutex_unlock(&conn->sendLock);
+
+                            dis->watchIdle(reactor,conn.get());
+                            if(command.type == ADD_SOCK)
+                            {
+                                dis->dispatchConnect(conn);
+                            }
+                            else if(dis->dispatchTakeOver(conn,
+                                (Adoption*) command.data) == DECODE_CLOSED)
+                            {
+                                shutdown(socket,SHUT_RDWR);
+                                shutdownSocks.insert(socket);
+                            }
+                        }
+                        break;
+                    case RM_SOCK:
+                        if(files->fdSet.find(socket) != files->fdSet.end())
+                        {
+                            shutdown(socket,SHUT_RDWR);
+                            shutdownSocks.insert(socket);
+                        }
+                        break;
+                    case CORK_SOCK:
+                        if(sockets.find(socket) != sockets.end())
+                        {
+                            corked.push_back(std::make_pair(
+                                now+dis->coalesceWindow*1000ULL,
+                                sockets[socket]));
+                        }
+                        break;
+                    case DEFER_TASK:
+                        {
+                            DeferredTask* deferred =
+                                (DeferredTask*) command.data;
+                            wheel_arm(&reactor->wheel,&deferred->timer,
+                                now/1000000+deferred->delay);
+                        }
+                        break;
+                    case CONNECT_SOCK:
+                        dis->watchConnect(reactor,
+                            (PendingConnect*) command.data);
+                        break;
+                    case STOP_REACTOR:
+                        // the host is being deleted, or handing off to a
+                        // successor, thread should terminate
+                        terminateThread = 1;
+                        break;
+                    }
+                }
+                reactor->numCommands.fetch_add(numCommands,
+                    std::memory_order_relaxed);
+            }
+            else if(reactor->connecting.find(curSock) !=
+                reactor->connecting.end())
+            {
+                // a socket that connectAsync started is connected, or failed
+                dis->finishConnect(reactor,reactor->connecting[curSock],0);
+            }
+            else
+            {
+                /*
+                 * this is the client socket; queue it to be served below,
+                 *   unless it is queued already, because it was carried over
+                 *   from the last cycle.
+                 */
+
+                std::shared_ptr<Connection> conn = sockets[curSock];
+                unsigned int events = files_ready_events(files,i);
+
+                // send whatever is queued once the socket is writable
+                if(events&EPOLLOUT)
+                {
+                    dis->flushConnection(conn.get());
+                }
+                if(!(events&(EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR)) ||
+                    conn->backlogged)
+                {
+                    continue;
+                }
+                conn->backlogged = 1;
+                conn->readySince = now;
+                backlog.push_back(conn);
+            }
+        }
+
+        /*
+         * serve every queued socket once, each up to its read budget, so a
+         *   busy peer can't hold up the others.
+         *
+         * a socket that used up its budget with work left goes to the back of
+         *   the queue, to be served again next cycle; its unread data won't
+         *   be lost, even if no new data arrives to report it as ready.
+         *
+         * if serving fails, the socket is closed; remove it from the select
+         *   set, and call the callback.
+         */
+
+        for(size_t numQueued = backlog.size(); numQueued > 0; --numQueued)
+        {
+            std::shared_ptr<Connection> conn = backlog.front();
+            backlog.pop_front();
+            conn->backlogged = 0;
 
-    // start the thread
-    pthread_create(thread,0,routine,params);
-    return SUCCESS;
-}
+            int result = dis->serveConnection(reactor,conn);
+            if(result == SERVE_MORE)
+            {
+                conn->backlogged = 1;
+                conn->readySince = now_ns();
+                backlog.push_back(conn);
+                reactor->carryOvers.fetch_add(1,std::memory_order_relaxed);
+            }
+            else if(result == SERVE_CLOSED)
+            {
+                // socket closed; remove from select set, and call callback
+                int curSock = conn->socket;
+                files_rm_file(files,curSock);
+                wheel_cancel(&reactor->wheel,&conn->idleTimer);
+                int remote = (shutdownSocks.erase(curSock) == 0);
+                dis->dispatchDisconnect(conn,remote);
+                sockets.erase(curSock);
+            }
+        }
 
-/**
- * stops a thread from executing a routine by communicating to it through an IPC
- *   pipe.
- *
- * @function   Host::stopRoutine
- *
- * @date       2015-03-18
- *
- * @revision   none
- *
- * @designer   EricTsang
- *
- * @programmer EricTsang
- *
- * @note       none
- *
- * @signature  int Host::stopRoutine(pthread_t* thread, int* controlPipe)
- *
- * @param      thread pointer to a thread id variable.
- * @param      controlPipe pointer to an integer array of size 2, used to hold
- *   the read and write file descriptors of a pipe.
- *
- * @return     integer values indicating the outcome of the operation.
- */
-int Host::stopRoutine(pthread_t* thread, int* controlPipe)
-{
-    // return immediately if the routine is already stopped
-    if(*thread == 0)
+        // send the broadcasts of every coalescing window that is over
+        now = now_ns();
+        while(!corked.empty() && corked.front().first <= now)
+        {
+            dis->uncork(corked.front().second.get());
+            corked.pop_front();
+        }
+
+        // check idle sockets, and run deferred tasks that are due
+        wheel_advance(&reactor->wheel,now/1000000);
+    }
+
+    // give up on the sockets being connected, then close all sockets before
+    // terminating, sending what's left in their send queues if the sockets
+    // accept it right away; unless they are being handed off, in which case
+    // they are left open, with their state, for the successor
+    clearTimers(reactor);
+    dis->dropConnects(reactor);
+    for(auto socketIt = files->fdSet.begin(); socketIt != files->fdSet.end();
+        ++socketIt)
     {
-        return INVALID_OPERATION;
+        int curSock = *socketIt;
+        if(curSock != reactor->eventFd && !dis->handingOff)
+        {
+            dis->flushConnection(sockets[curSock].get());
+            dis->dispatchDisconnect(sockets[curSock],0);
+        }
     }
+    backlog.clear();
+    corked.clear();
+    sockets.clear();
 
-    // close the control pipe which terminates the thread
-    close(controlPipe[1]);
-    pthread_join(*thread,0);
+    files_destroy(files);
 
-    // set thread to 0, so we know it's terminated
-    *thread = 0;
-    return SUCCESS;
+    printf("receiveroutine stopped...\n");
+    fflush(stdout);
+
+    return 0;
 }
 
 /**
- * function run on a thread. it polls the server socket, accepting connections.
+ * function run on a thread when the host uses URING_BACKEND. it keeps one
+ *   multishot accept in flight on the server socket, so every connection is
+ *   accepted without a system call of its own.
  *
  * @param params thread parameters; points to the calling server instance.
  */
-void* Host::listenRoutine(void* params)
+void* Host::uringListenRoutine(void* params)
 {
     printf("listenroutine started...\n");
     fflush(stdout);
@@ -255,83 +3368,149 @@ void* Host::listenRoutine(void* params)
 
     int terminateThread = 0;
 
-    // set up the socket set & client list
-    Files files;
-    files_init(&files);
+    // successor that connected to the hand-off socket, and the number of
+    // server sockets that still have an accept in flight; it is handed off
+    // to once those are over, so no accepted connection is left behind
+    int successor = -1;
+    int accepting = 0;
 
-    // add the server socket and control pipe to the select set
-    files_add_file(&files,dis->svrSock);
-    files_add_file(&files,dis->listenPipe[0]);
+    // set up the ring; nothing is received through it, so it has no buffers
+    Uring ring;
+    if(uring_init(&ring,URING_ENTRIES,0,0) == -1)
+    {
+        fatal_error("failed to create the listen routine's io_uring");
+    }
+
+    // accept on the server sockets, and wait on the control pipe
+    uring_prep_accept_multishot(uring_get_sqe(&ring),dis->svrSock,
+        uring_user_data(URING_ACCEPT,0,dis->svrSock));
+    if(dis->localSock != -1)
+    {
+        uring_prep_accept_multishot(uring_get_sqe(&ring),dis->localSock,
+            uring_user_data(URING_ACCEPT,0,dis->localSock));
+    }
+    if(dis->handOffSock != -1)
+    {
+        uring_prep_accept_multishot(uring_get_sqe(&ring),dis->handOffSock,
+            uring_user_data(URING_ACCEPT,0,dis->handOffSock));
+    }
+    uring_prep_poll(uring_get_sqe(&ring),dis->listenPipe[0],POLLIN,0,
+        uring_user_data(URING_STOP,0,dis->listenPipe[0]));
 
     // accept any connection requests, and create a session for each
-    while(!terminateThread && dis->svrSock != -1)
+    while(!terminateThread)
     {
-        // wait for an event on any socket to occur
-        if(files_select(&files) == -1)
+        // submit the requests, and wait for at least one of them to complete
+        if(uring_submit(&ring,1) == -1)
         {
-            fatal_error("failed on select");
+            fatal_error("failed to submit to the io_uring");
         }
 
-        // loop through sockets, and handle them
-        for(auto socketIt = files.fdSet.begin(); socketIt != files.fdSet.end();
-            ++socketIt)
+        struct io_uring_cqe* cqe;
+        while((cqe = uring_peek_cqe(&ring)) != 0)
         {
-            int curSock = *socketIt;
+            int op = (int) (cqe->user_data >> 56);
+            int curSock = (int) (cqe->user_data&0xffffffff);
+            int result = cqe->res;
+            int more = cqe->flags&IORING_CQE_F_MORE;
+            uring_cqe_seen(&ring);
 
-            // if this socket doesn't have any activity, move on to next socket
-            if(!FD_ISSET(curSock,&files.selectFds))
+            if(op == URING_ACCEPT && curSock == dis->handOffSock)
             {
-                continue;
-            }
+                if(result >= 0 && successor == -1)
+                {
+                    // a successor connected; stop accepting on the server
+                    // sockets, and hand off once they have stopped
+                    successor = result;
+                    uring_prep_cancel_fd(uring_get_sqe(&ring),dis->svrSock,
+                        uring_user_data(URING_CANCEL,0,dis->svrSock));
+                    accepting = 1;
+                    if(dis->localSock != -1)
+                    {
+                        uring_prep_cancel_fd(uring_get_sqe(&ring),
+                            dis->localSock,uring_user_data(URING_CANCEL,0,
+                            dis->localSock));
+                        ++accepting;
+                    }
+                }
+                else if(result >= 0)
+                {
+                    close(result);
+                }
+                else
+                {
+                    // accept failed; socket closed, terminate thread
+                    terminateThread = 1;
+                }
 
-            // handle socket activity depending on which socket it is
-            if(curSock == dis->svrSock)
+                // the kernel ends a multishot accept now and then; renew it
+                if(!more && !terminateThread && successor == -1)
+                {
+                    uring_prep_accept_multishot(uring_get_sqe(&ring),
+                        curSock,uring_user_data(URING_ACCEPT,0,curSock));
+                }
+            }
+            else if(op == URING_ACCEPT)
             {
-                /*
-                 * this is the server socket, try to accept a connection.
-                 *
-                 * if the operation fails, end the server thread, because when
-                 *   accept fails, it means that the server socket is closed.
-                 *
-                 * if accept succeeds, add it to the select set, and continue
-                 *   looping...
-                 */
-
-                // accept the connection
-                int newSock;
-                if((newSock = accept(dis->svrSock,0,0)) == -1)
+                if(result < 0)
                 {
-                    // accept failed; server socket closed, terminate thread
-                    terminateThread = 1;
+                    // accept failed; server socket closed, terminate thread,
+                    // unless it was cancelled to hand off
+                    if(successor == -1)
+                    {
+                        terminateThread = 1;
+                    }
                 }
                 else
                 {
-                    // accept success; add the socket to the receive thread.
-                    char commandType = ADD_SOCK;
-                    write(dis->receivePipe[1],&commandType,sizeof(commandType));
-                    write(dis->receivePipe[1],&newSock,sizeof(newSock));
+                    // accept success; add the socket to a receive thread.
+                    dis->addSocket(result);
                 }
-            }
 
-            if(curSock == dis->listenPipe[0])
+                // the kernel ends a multishot accept now and then; renew it,
+                // unless it is over for good
+                if(!more && successor != -1)
+                {
+                    --accepting;
+                }
+                else if(!more && !terminateThread)
+                {
+                    uring_prep_accept_multishot(uring_get_sqe(&ring),
+                        curSock,uring_user_data(URING_ACCEPT,0,curSock));
+                }
+            }
+            else if(op == URING_STOP)
             {
-                /*
-                 * this is the control pipe. whenever anything happens on the
-                 *   control pipe, it means it's time for the server to
-                 *   shutdown; break out of the server loop.
-                 */
-
-                 terminateThread = 1;
+                // control pipe closed; time for the server to shutdown
+                terminateThread = 1;
             }
         }
+
+        // hand off once the server sockets accept no more connections
+        if(successor != -1 && accepting == 0 && !terminateThread)
+        {
+            dis->handOff(successor);
+            terminateThread = 1;
+        }
+    }
+    if(successor != -1)
+    {
+        close(successor);
     }
 
-    // close all file descriptors before terminating
-    for(auto socketIt = files.fdSet.begin(); socketIt != files.fdSet.end();
-        ++socketIt)
+    // closing the ring cancels the accept, then the sockets can be closed
+    uring_destroy(&ring);
+    close(dis->svrSock);
+    if(dis->localSock != -1)
     {
-        close(*socketIt);
+        close(dis->localSock);
+    }
+    if(dis->handOffSock != -1)
+    {
+        close(dis->handOffSock);
     }
+    dis->releaseListeners();
+    close(dis->listenPipe[0]);
 
     printf("listenroutine stopped...\n");
     fflush(stdout);
@@ -339,13 +3518,23 @@ void* Host::listenRoutine(void* params)
     return 0;
 }
 
-void* Host::receiveRoutine(void* params)
+/**
+ * function run on a reactor's thread when the host uses URING_BACKEND. every
+ *   socket has a multishot receive in flight that picks buffers from the
+ *   reactor's provided buffer ring, so the thread submits and reaps the I/O
+ *   of all its sockets with one system call per batch, rather than one per
+ *   read. the callbacks are called just like receiveRoutine calls them.
+ *
+ * @param params thread parameters; points to the reactor to run.
+ */
+void* Host::uringReceiveRoutine(void* params)
 {
     printf("receiveroutine started...\n");
     fflush(stdout);
 
     // parse thread parameters
-    Host* dis = (Host*) params;
+    Reactor* reactor = (Reactor*) params;
+    Host* dis = reactor->host;
 
     // used to break the while loop
     int terminateThread = 0;
@@ -353,135 +3542,431 @@ void* Host::receiveRoutine(void* params)
     // set of sockets that have been shutdown from local host
     std::set<int> shutdownSocks;
 
-    // set up the socket set & client list
-    Files files;
-    files_init(&files);
+    // state of each socket owned by this reactor
+    std::map<int,std::shared_ptr<Connection> > sockets;
 
-    // add the server socket and control pipe to the select set
-    files_add_file(&files,dis->receivePipe[0]);
+    // sockets whose receive is being cancelled to hand them off; the thread
+    // terminates once the last completion of each of them is handled, so
+    // nothing received is left behind in the provided buffers
+    std::set<int> receiving;
+    int draining = 0;
+
+    // generation of each socket owned by this reactor; completions carry the
+    // generation they were submitted for, so completions for a closed socket
+    // aren't mistaken for ones of a new socket that reuses its descriptor
+    std::map<int,unsigned int> generations;
+    unsigned int nextGeneration = 0;
+
+    // set up the ring
+    Uring* ring = &reactor->ring;
+    if(uring_init(ring,URING_ENTRIES,URING_NUM_BUFFERS,URING_BUFFER_SIZE)
+        == -1)
+    {
+        fatal_error("failed to create the reactor's io_uring");
+    }
+
+    // wait for commands on the eventfd
+    uring_prep_poll(uring_get_sqe(ring),reactor->eventFd,POLLIN,1,
+        uring_user_data(URING_EVENT,0,reactor->eventFd));
+
+    // start the clock of the reactor's timers
+    wheel_init(&reactor->wheel,now_ms(),reactor);
 
-    // accept any connection requests, and create a session for each
     while(!terminateThread)
     {
-        // wait for an event on any socket to occur
-        if(files_select(&files) == -1)
+        // submit the requests queued while handling the last batch, and wait
+        // for the next batch of completions, all in one system call; no
+        // longer than until the next timer is due
+        long long due = wheel_next_expiry(&reactor->wheel);
+        int submitted;
+        if(due == -1)
         {
-            fatal_error("failed on select");
+            submitted = uring_submit(ring,1);
+        }
+        else
+        {
+            unsigned long long now = now_ms();
+            unsigned long long untilDue =
+                (due <= (long long) now) ? 0 : due-now;
+            struct __kernel_timespec timeout;
+            timeout.tv_sec = untilDue/1000;
+            timeout.tv_nsec = untilDue%1000*1000000LL;
+            submitted = uring_submit_timeout(ring,1,&timeout);
         }
+        if(submitted == -1)
+        {
+            fatal_error("failed to submit to the io_uring");
+        }
+        unsigned long long reaped = now_ns();
+        unsigned long long now = reaped/1000000;
 
-        // loop through sockets, and handle them
-        for(auto socketIt = files.fdSet.begin(); socketIt != files.fdSet.end();
-            ++socketIt)
+        struct io_uring_cqe* cqe;
+        while((cqe = uring_peek_cqe(ring)) != 0)
         {
-            int curSock = *socketIt;
+            int op = (int) (cqe->user_data >> 56);
+            unsigned int generation = (cqe->user_data >> 32)&0xffffff;
+            int curSock = (int) (cqe->user_data&0xffffffff);
+            int result = cqe->res;
+            unsigned int flags = cqe->flags;
+            uring_cqe_seen(ring);
 
-            // if this socket doesn't have any activity, move on to next socket
-            if(!FD_ISSET(curSock,&files.selectFds))
+            // look up the socket that the completion is for, unless it has
+            // been closed since the request was submitted
+            Connection* conn = 0;
+            auto found = generations.find(curSock);
+            if(found != generations.end() && found->second == generation)
             {
-                continue;
+                conn = sockets[curSock].get();
             }
 
-            // handle socket activity depending on which socket it is
-            if(curSock == dis->receivePipe[0])
+            if(op == URING_EVENT)
             {
                 /*
-                 * this is the control pipe. try to read from the control pipe.
-                 *
-                 * if the control pipe is closed, the client is being deleted;
-                 *   this client thread should terminate.
-                 *
-                 * if the control pipe is read, that means that a new socket is
-                 *   now connected, and needs to be added to the selection set.
+                 * this is the reactor's eventfd. other threads have queued
+                 *   commands for this thread; carry out all of them.
                  */
 
-                char cmdType;
-                if(read_file(dis->receivePipe[0],&cmdType,sizeof(cmdType)) == 0)
-                {
-                    // pipe closed; the client is being deleted, thread should
-                    // terminate
-                    terminateThread = 1;
-                }
-                else
+                uint64_t numSignals;
+                read(reactor->eventFd,&numSignals,sizeof(numSignals));
+                reactor->signalled.exchange(0,std::memory_order_acq_rel);
+
+                Command command;
+                unsigned long long numCommands = 0;
+                while(reactor->commands.pop(&command))
                 {
-                    // pipe read; read a socket from the pipe, and depending on
-                    // the cmdType, do something with it
-                    int socket;
-                    read_file(dis->receivePipe[0],&socket,sizeof(socket));
-                    switch(cmdType)
+                    int socket = command.socket;
+                    ++numCommands;
+                    switch(command.type)
                     {
                     case ADD_SOCK:
-                        files_add_file(&files,socket);
-                        dis->onConnect(socket);
+                    case ADOPT_SOCK:
+                        {
+                            std::shared_ptr<Connection> added =
+                                dis->findConnection(socket);
+                            sockets[socket] = added;
+                            nextGeneration = (nextGeneration+1)&0xffffff;
+                            generations[socket] = nextGeneration;
+                            if(!draining)
+                            {
+                                uring_prep_recv_multishot(uring_get_sqe(ring),
+                                    socket,uring_user_data(URING_RECV,
+                                    nextGeneration,socket));
+                            }
+
+                            // catch up on sends that were queued before the
+                            // socket was added
+                            pthread_mutex_lock(&added->sendLock);
+                            if(added->watchingWritable)
+                            {
+                                uring_prep_poll(uring_get_sqe(ring),socket,
+                                    POLLOUT,0,uring_user_data(URING_WRITABLE,
+                                    nextGeneration,socket));
+                            }
+                            pthread_mutex_unlock(&added->sendLock);
+
+                            dis->watchIdle(reactor,added.get());
+                            if(command.type == ADD_SOCK)
+                            {
+                                dis->dispatchConnect(added);
+                            }
+                            else if(dis->dispatchTakeOver(added,
+                                (Adoption*) command.data) == DECODE_CLOSED)
+                            {
+                                shutdown(socket,SHUT_RDWR);
+                                shutdownSocks.insert(socket);
+                            }
+                        }
                         break;
                     case RM_SOCK:
-                        if(files.fdSet.find(socket) != files.fdSet.end())
+                        if(sockets.find(socket) != sockets.end())
                         {
                             shutdown(socket,SHUT_RDWR);
                             shutdownSocks.insert(socket);
                         }
                         break;
+                    case WATCH_SOCK:
+                        if(sockets.find(socket) != sockets.end())
+                        {
+                            uring_prep_poll(uring_get_sqe(ring),socket,
+                                POLLOUT,0,uring_user_data(URING_WRITABLE,
+                                generations[socket],socket));
+                        }
+                        break;
+                    case CORK_SOCK:
+                        if(sockets.find(socket) != sockets.end())
+                        {
+                            uring_prep_timeout(uring_get_sqe(ring),
+                                &dis->coalesceTimeout,uring_user_data(
+                                URING_UNCORK,generations[socket],socket));
+                        }
+                        break;
+                    case DEFER_TASK:
+                        {
+                            DeferredTask* deferred =
+                                (DeferredTask*) command.data;
+                            wheel_arm(&reactor->wheel,&deferred->timer,
+                                now+deferred->delay);
+                        }
+                        break;
+                    case CONNECT_SOCK:
+                        {
+                            PendingConnect* pending =
+                                (PendingConnect*) command.data;
+                            nextGeneration = (nextGeneration+1)&0xffffff;
+                            pending->generation = nextGeneration;
+                            uring_prep_poll(uring_get_sqe(ring),socket,
+                                POLLOUT,0,uring_user_data(URING_CONNECT,
+                                nextGeneration,socket));
+                            dis->watchConnect(reactor,pending);
+                        }
+                        break;
+                    case STOP_REACTOR:
+                        if(dis->handingOff && !draining)
+                        {
+                            // handing off to a successor; cancel the
+                            // receives, and terminate once they are over
+                            for(auto socketIt = sockets.begin();
+                                socketIt != sockets.end(); ++socketIt)
+                            {
+                                int curSock = socketIt->first;
+                                uring_prep_cancel_fd(uring_get_sqe(ring),
+                                    curSock,uring_user_data(URING_CANCEL,
+                                    generations[curSock],curSock));
+                                receiving.insert(curSock);
+                            }
+                            draining = 1;
+                        }
+                        else
+                        {
+                            // the host is being deleted, thread should
+                            // terminate
+                            terminateThread = 1;
+                        }
+                        break;
                     }
                 }
+                reactor->numCommands.fetch_add(numCommands,
+                    std::memory_order_relaxed);
+
+                if(!(flags&IORING_CQE_F_MORE))
+                {
+                    uring_prep_poll(uring_get_sqe(ring),reactor->eventFd,
+                        POLLIN,1,uring_user_data(URING_EVENT,0,
+                        reactor->eventFd));
+                }
             }
-            else
+            else if(op == URING_WRITABLE && conn != 0)
+            {
+                // send whatever is queued, and keep waiting if that wasn't all
+                dis->flushConnection(conn);
+                pthread_mutex_lock(&conn->sendLock);
+                if(conn->watchingWritable && !draining)
+                {
+                    uring_prep_poll(uring_get_sqe(ring),curSock,POLLOUT,0,
+                        uring_user_data(URING_WRITABLE,generation,curSock));
+                }
+                pthread_mutex_unlock(&conn->sendLock);
+            }
+            else if(op == URING_UNCORK && conn != 0)
+            {
+                // the coalescing window is over; send the held back broadcasts
+                dis->uncork(conn);
+            }
+            else if(op == URING_CONNECT)
+            {
+                // a socket that connectAsync started is connected, or failed,
+                // unless it has timed out since
+                auto waiting = reactor->connecting.find(curSock);
+                if(waiting != reactor->connecting.end() &&
+                    waiting->second->generation == generation)
+                {
+                    dis->finishConnect(reactor,waiting->second,0);
+                }
+            }
+            else if(op == URING_RECV)
             {
                 /*
-                 * this is the client socket; try to read from the socket
+                 * data was received into one of the provided buffers; copy it
+                 *   into the socket's decoder, and call the callback for each
+                 *   whole frame. the buffer goes straight back to the kernel.
                  *
-                 * if read fails, it means that the socket is closed, remove it
-                 *   from the select set, call a callback, and continue looping.
-                 *
-                 * if read succeeds, read until socket is empty, and call
-                 *   callback, then continue looping.
+                 * a receive of 0 bytes or an error means that the socket is
+                 *   closed; cancel whatever is still in flight on it, call a
+                 *   callback, and close it.
                  */
 
-                // read from socket
-                Message msg;
-                if(read_file(curSock,&msg.type,sizeof(msg.type)) == 0)
+                int bufferId = -1;
+                if(flags&IORING_CQE_F_BUFFER)
                 {
-                    // socket closed; remove from select set, and call callback
-                    files_rm_file(&files,curSock);
-                    int remote = (shutdownSocks.erase(curSock) == 0
-                        && close(curSock) == 0);
-                    dis->onDisconnect(curSock,remote);
-                    close(curSock);
+                    bufferId = flags >> IORING_CQE_BUFFER_SHIFT;
                 }
-                else
+                if(conn == 0)
+                {
+                    if(bufferId != -1)
+                    {
+                        uring_recycle_buffer(ring,bufferId);
+                    }
+                    continue;
+                }
+
+                int decoded = DECODE_PENDING;
+                int renew = !(flags&IORING_CQE_F_MORE);
+                if(result > 0)
                 {
-                    // socket read; read more from socket, and call callback
-                    read_file(curSock,&msg.len,sizeof(msg.len));
+                    // the time the completion waited behind the rest of
+                    // the batch is its wait to be served
+                    histogram_record(&reactor->serviceLatency,
+                        now_ns()-reaped);
+                    unsigned long long numFrames = 0;
+                    decoded = dis->feedConnection(sockets[curSock],
+                        uring_buffer(ring,bufferId),result,&numFrames);
+                    uring_recycle_buffer(ring,bufferId);
+                    conn->lastReceive = now;
+                    count(&conn->framesReceived,numFrames);
+                    count(&conn->bytesReceived,result);
 
-                    char* buffer = (char*) malloc(msg.len);
-                    read_file(curSock,buffer,msg.len);
-                    msg.data = buffer;
+                    reactor->reads.fetch_add(1,std::memory_order_relaxed);
+                    reactor->frames.fetch_add(numFrames,
+                        std::memory_order_relaxed);
+                    reactor->bytes.fetch_add(result,
+                        std::memory_order_relaxed);
+                }
+                else if(result == -ENOBUFS)
+                {
+                    // every buffer was in use; receive again now that the
+                    // ones handled so far have been given back
+                    renew = 1;
+                }
+                else if(!draining || result != -ECANCELED)
+                {
+                    decoded = DECODE_CLOSED;
+                }
 
-                    dis->onMessage(curSock,msg);
+                // the receive of a socket being handed off is over once it
+                // ends; whatever arrives after that is left in the socket
+                if(draining && !(flags&IORING_CQE_F_MORE))
+                {
+                    receiving.erase(curSock);
+                    renew = 0;
+                }
 
-                    free(buffer);
+                if(decoded == DECODE_CLOSED)
+                {
+                    // socket closed; cancel its requests before closing it,
+                    // since closing doesn't, and call callback
+                    uring_prep_cancel_fd(uring_get_sqe(ring),curSock,
+                        uring_user_data(URING_CANCEL,generation,curSock));
+                    uring_submit(ring,0);
+                    wheel_cancel(&reactor->wheel,&conn->idleTimer);
+                    int remote = (shutdownSocks.erase(curSock) == 0);
+                    dis->dispatchDisconnect(sockets[curSock],remote);
+                    sockets.erase(curSock);
+                    generations.erase(curSock);
+                    receiving.erase(curSock);
+                }
+                else if(renew)
+                {
+                    uring_prep_recv_multishot(uring_get_sqe(ring),curSock,
+                        uring_user_data(URING_RECV,generation,curSock));
                 }
-                break;
             }
         }
-    }
 
-    // close all sockets before terminating
-    for(auto socketIt = files.fdSet.begin(); socketIt != files.fdSet.end();
-        ++socketIt)
-    {
-        int curSock = *socketIt;
-        close(curSock);
-        if(curSock != dis->receivePipe[0])
+        // check idle sockets, and run deferred tasks that are due
+        wheel_advance(&reactor->wheel,now_ms());
+
+        if(draining && receiving.empty())
         {
-            dis->onDisconnect(curSock,0);
+            terminateThread = 1;
         }
     }
 
+    // close all sockets before terminating, sending what's left in their send
+    // queues if the sockets accept it right away; unless they are being
+    // handed off, in which case they are left open, with their state, for
+    // the successor
+    uring_destroy(ring);
+    for(auto socketIt = sockets.begin();
+        socketIt != sockets.end() && !dis->handingOff; ++socketIt)
+    {
+        dis->flushConnection(socketIt->second.get());
+        dis->dispatchDisconnect(socketIt->second,0);
+    }
+    clearTimers(reactor);
+    dis->dropConnects(reactor);
+    sockets.clear();
+
     printf("receiveroutine stopped...\n");
     fflush(stdout);
 
     return 0;
 }
 
+/**
+ * packs what an io_uring request is for into its user data.
+ *
+ * @param op URING_EVENT, URING_RECV, URING_WRITABLE, URING_CANCEL,
+ *   URING_ACCEPT, URING_STOP, URING_UNCORK or URING_CONNECT.
+ * @param generation generation of the socket, which changes whenever its
+ *   descriptor is reused.
+ * @param fd file that the request is on.
+ *
+ * @return the request's user data.
+ */
+static unsigned long long uring_user_data(int op, unsigned int generation,
+    int fd)
+{
+    return ((unsigned long long) op << 56)|
+        ((unsigned long long) (generation&0xffffff) << 32)|
+        (unsigned int) fd;
+}
+
+/**
+ * returns the current time in nanoseconds.
+ */
+static unsigned long long now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+/**
+ * returns the current time in milliseconds; the tick of the reactors' timer
+ *   wheels.
+ */
+static unsigned long long now_ms()
+{
+    return now_ns()/1000000;
+}
+
+/**
+ * prints the percentiles of a stage's latencies, in nanoseconds, on one line.
+ */
+static void print_latency(FILE* file, const char* stage,
+    Histogram* histogram)
+{
+    fprintf(file,"%s ns: p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, "
+        "max %llu; %llu recorded\n",stage,
+        histogram_percentile(histogram,50.0),
+        histogram_percentile(histogram,90.0),
+        histogram_percentile(histogram,99.0),
+        histogram_percentile(histogram,99.9),
+        histogram->max.load(std::memory_order_relaxed),
+        histogram->total.load(std::memory_order_relaxed));
+}
+
+/**
+ * adds to a counter that only one thread writes to at a time, without the
+ *   locked instruction of a fetch_add; readers may see it a little late.
+ */
+static void count(std::atomic<unsigned long long>* counter,
+    unsigned long long n)
+{
+    counter->store(counter->load(std::memory_order_relaxed)+n,
+        std::memory_order_relaxed);
+}
+
 static void fatal_error(const char* errstr)
 {
     perror(errstr);
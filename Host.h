@@ -2,8 +2,25 @@
 #define SERVER_H_
 
 #include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
 #include <pthread.h>
 
+#include "select_helper.h"
+#include "frame_decoder.h"
+#include "outbound_queue.h"
+#include "shared_frame.h"
+#include "mpsc_queue.h"
+#include "uring.h"
+#include "worker_pool.h"
+#include "Message.h"
+#include "histogram.h"
+#include "wire_header.h"
+#include "timer_wheel.h"
+#include "resolver.h"
+
 /**
  * indicates that a system call has failed.
  */
@@ -21,38 +38,807 @@
  * indicates that the operation failed due to a socket operation.
  */
 #define SOCK_OP_FAIL 2
+/**
+ * indicates that the message was dropped, because the peer isn't keeping up,
+ *   and its send queue is over the high-water mark.
+ */
+#define QUEUE_FULL 3
+
+/**
+ * default number of bytes that may be queued for a peer before sends to it
+ *   fail with QUEUE_FULL.
+ */
+#define DEFAULT_HIGH_WATER_MARK (1024*1024)
+
+/**
+ * default number of bytes read from, and frames dispatched for, one socket
+ *   before its reactor moves on to the next ready socket. whatever is left is
+ *   carried over to the reactor's next cycle.
+ */
+#define DEFAULT_READ_BUDGET (64*1024)
+#define DEFAULT_FRAME_BUDGET 256
+
+/**
+ * default size of the smallest payload that is compressed for peers that
+ *   read compressed frames; smaller ones rarely save enough to be worth it.
+ */
+#define DEFAULT_COMPRESS_THRESHOLD 1024
+
+/**
+ * passed as the window to setCoalescing to send every broadcast right away.
+ */
+#define NO_COALESCING 0
+
+/**
+ * default number of broadcast bytes held back for a peer before they are sent
+ *   early, without waiting for the rest of the coalescing window.
+ */
+#define DEFAULT_COALESCE_BYTES (16*1024)
+
+/**
+ * passed to setIdleTimeout to never call onIdle, or never close idle
+ *   connections.
+ */
+#define NO_IDLE_TIMEOUT 0
+
+/**
+ * default time that connectAsync waits for a connection to be established,
+ *   after its host name is resolved, in milliseconds.
+ */
+#define DEFAULT_CONNECT_TIMEOUT (10*1000)
+
+/**
+ * passed as the reactor count to run one receive loop per online processor.
+ */
+#define AUTO_REACTORS 0
+
+/**
+ * passed as the backend to wait for socket readiness with epoll, and accept,
+ *   read and write with one system call each.
+ */
+#define EPOLL_BACKEND 0
+
+/**
+ * passed as the backend to accept and receive through io_uring, so a busy
+ *   reactor submits and reaps its I/O in batches. falls back to EPOLL_BACKEND
+ *   on kernels older than Linux 6.0.
+ */
+#define URING_BACKEND 1
+
+/**
+ * passed as the worker count to call onConnect, onMessage and onDisconnect
+ *   right on the reactor thread that reads the socket.
+ */
+#define INLINE_HANDLERS 0
 
 namespace Net
 {
     struct Message;
 
+    /**
+     * counters describing the work done by a host's receive loops.
+     */
+    struct ReceiveStats
+    {
+        /**
+         * number of read system calls made on connected sockets.
+         */
+        unsigned long long reads;
+
+        /**
+         * number of frames decoded and passed to onMessage.
+         */
+        unsigned long long frames;
+
+        /**
+         * number of bytes read from connected sockets.
+         */
+        unsigned long long bytes;
+
+        /**
+         * number of commands, like adding a newly connected socket, handled
+         *   by the receive loops.
+         */
+        unsigned long long commands;
+
+        /**
+         * number of times a receive loop was woken up to handle commands; one
+         *   wakeup handles every command queued up until then.
+         */
+        unsigned long long wakeups;
+
+        /**
+         * number of times a socket used up its read budget with data left
+         *   to read or dispatch, and was carried over to the next cycle.
+         */
+        unsigned long long carryOvers;
+    };
+
+    /**
+     * counters describing what a host has sent to its connected sockets.
+     */
+    struct SendStats
+    {
+        /**
+         * number of write system calls made on connected sockets; a flush
+         *   of a send queue counts as one.
+         */
+        unsigned long long writes;
+
+        /**
+         * number of frames sent, or queued to be sent.
+         */
+        unsigned long long frames;
+
+        /**
+         * number of bytes written to connected sockets.
+         */
+        unsigned long long bytes;
+
+        /**
+         * number of frames that the socket didn't take whole right away, and
+         *   were queued, in part or whole.
+         */
+        unsigned long long queuedFrames;
+
+        /**
+         * number of bytes queued on every connected socket right now.
+         */
+        unsigned long long queuedBytes;
+    };
+
+    /**
+     * counters describing the traffic of one connected socket.
+     */
+    struct ConnectionStats
+    {
+        /**
+         * number of frames and bytes received on the socket.
+         */
+        unsigned long long framesReceived;
+        unsigned long long bytesReceived;
+
+        /**
+         * number of frames sent, or queued to be sent, on the socket, bytes
+         *   written to it, and write system calls made on it.
+         */
+        unsigned long long framesSent;
+        unsigned long long bytesSent;
+        unsigned long long writes;
+
+        /**
+         * number of bytes queued on the socket, and callbacks queued for it
+         *   that a worker hasn't called yet, right now.
+         */
+        unsigned long long queuedBytes;
+        unsigned long long pendingEvents;
+    };
+
+    /**
+     * how long a connected socket waited to be served by its receive loop,
+     *   from when it was reported ready, or carried over, to when its turn
+     *   came; only measured by EPOLL_BACKEND.
+     */
+    struct ServiceStats
+    {
+        /**
+         * number of times the socket was served.
+         */
+        unsigned long long services;
+
+        /**
+         * total and longest wait, in nanoseconds.
+         */
+        unsigned long long totalWait;
+        unsigned long long maxWait;
+    };
+
     class Host
     {
     public:
-        Host();
+        Host(int numReactors = 1, int backend = EPOLL_BACKEND,
+            int numWorkers = INLINE_HANDLERS);
         virtual ~Host();
-        int startListeningRoutine(short port);
+        void stop();
+        int startListeningRoutine(short port, const char* localPath = 0);
         int stopListeningRoutine();
-        void send(int socket, Message msg);
+        int send(int socket, const Message& msg);
+        int broadcast(const std::vector<int>& sockets, const Message& msg);
+        int sendFile(int socket, int type, SharedFile* file, long offset,
+            int len);
         int connect(char* remoteName, short remotePort);
+        int connectAsync(const char* remoteName, short remotePort);
+        int connectLocal(const char* localPath);
         void disconnect(int socket);
+        void getReceiveStats(ReceiveStats* stats);
+        void setHighWaterMark(long bytes);
+        void setReadBudget(int bytes, int frames);
+        void setWireVersion(int version);
+        void setCoalescing(int windowUs, long bytes = DEFAULT_COALESCE_BYTES);
+        int setCompression(int socket, int enabled);
+        void setCompressThreshold(int bytes);
+        void setIdleTimeout(int pingMs, int closeMs);
+        void defer(int delayMs, void (*task)(void*), void* arg);
+        int setHostsFile(const char* path);
+        void setResolveTtl(int ttlMs);
+        void setConnectTimeout(int timeoutMs);
+        void setHandOffPath(const char* path);
+        int takeOver(const char* path);
+        int handedOff();
+        int getServiceStats(int socket, ServiceStats* stats);
+        void getServiceLatency(Histogram* histogram);
+        void getSendStats(SendStats* stats);
+        int getConnectionStats(int socket, ConnectionStats* stats);
+        void getDispatchLatency(Histogram* histogram);
+        void getSendLatency(Histogram* histogram);
+        void printStats(FILE* file);
+        void setStatsDump(const char* path, int intervalMs);
+        void setVerbose(int verbose);
+        int getBackend();
     protected:
+        int isVerbose();
         virtual void onConnect(int socket);
-        virtual void onMessage(int socket, Message msg);
+        virtual void onMessage(int socket, Message& msg);
         virtual void onDisconnect(int socket, int remote);
+        virtual void onQueueFull(int socket);
+        virtual void onIdle(int socket);
+        virtual void onConnectFailed(const char* remoteName, short remotePort,
+            int error);
+        virtual void onHandOff(int socket, std::string& state);
+        virtual void onHandedOff();
+        virtual void onTakeOver(int socket, const char* state, int len);
     private:
+        /**
+         * callback for a handler to call on a socket's behalf.
+         */
+        struct Event
+        {
+            /**
+             * EVENT_CONNECT, EVENT_MESSAGE, EVENT_IDLE, EVENT_DISCONNECT or
+             *   EVENT_TAKEOVER.
+             */
+            int type;
+
+            /**
+             * message to pass to onMessage, or state to pass to onTakeOver;
+             *   always an owner.
+             */
+            Message msg;
+
+            /**
+             * remote argument to pass to onDisconnect.
+             */
+            int remote;
+        };
+
+        /**
+         * state of a connected socket.
+         */
+        struct Connection
+        {
+            Connection(int socket, int owner);
+            ~Connection();
+
+            /**
+             * the connected socket.
+             */
+            int socket;
+
+            /**
+             * index of the reactor that owns the socket.
+             */
+            int owner;
+
+            /**
+             * frame that is partially received on the socket; only used by
+             *   the owning reactor's thread.
+             */
+            FrameDecoder decoder;
+
+            /**
+             * guards outbound, watchingWritable and closed; send may be
+             *   called from any thread.
+             */
+            pthread_mutex_t sendLock;
+
+            /**
+             * data waiting for the socket to become writable.
+             */
+            OutboundQueue outbound;
+
+            /**
+             * non-zero while the owning reactor is waiting for the socket to
+             *   become writable.
+             */
+            int watchingWritable;
+
+            /**
+             * non-zero once the socket has been removed from its reactor.
+             */
+            int closed;
+
+            /**
+             * framing that messages are sent to the peer in; only changed by
+             *   the owning reactor's thread, with sendLock held.
+             */
+            int sendVersion;
+
+            /**
+             * non-zero while broadcasts are held back in outbound, until the
+             *   owning reactor sends them at the end of the coalescing
+             *   window; guarded by sendLock.
+             */
+            int corked;
+
+            /**
+             * non-zero if large payloads are sent to the peer compressed;
+             *   guarded by sendLock.
+             */
+            int compress;
+
+            /**
+             * callbacks waiting to be called by a worker, in order; only used
+             *   with a worker pool.
+             */
+            MpscQueue<Event> events;
+
+            /**
+             * number of queued callbacks that haven't been called yet. a task
+             *   that calls them is submitted to the worker pool whenever this
+             *   goes up from 0, and runs until it is back down to 0, so only
+             *   one runs at a time, and calls the callbacks in order.
+             */
+            std::atomic<int> numEvents;
+
+            /**
+             * non-zero while the socket is queued to be served by its
+             *   reactor, and the time it was queued at, in nanoseconds; only
+             *   used by the owning reactor's thread.
+             */
+            int backlogged;
+            unsigned long long readySince;
+
+            /**
+             * service counters of the socket; only written by the owning
+             *   reactor's thread.
+             */
+            std::atomic<unsigned long long> services;
+            std::atomic<unsigned long long> totalWait;
+            std::atomic<unsigned long long> maxWait;
+
+            /**
+             * receive counters of the socket; only written by the owning
+             *   reactor's thread.
+             */
+            std::atomic<unsigned long long> framesReceived;
+            std::atomic<unsigned long long> bytesReceived;
+
+            /**
+             * send counters of the socket; only written with sendLock held,
+             *   so they cost senders no contention of their own.
+             */
+            std::atomic<unsigned long long> framesSent;
+            std::atomic<unsigned long long> bytesSent;
+            std::atomic<unsigned long long> writes;
+            std::atomic<unsigned long long> framesQueued;
+
+            /**
+             * checks the connection for idleness, when the host has an idle
+             *   timeout; it isn't moved on every receive, but when it fires,
+             *   it is armed again for the time that the connection would be
+             *   idle until, counting from lastReceive. only used by the
+             *   owning reactor's thread.
+             */
+            Timer idleTimer;
+
+            /**
+             * time that anything was last received on the socket, and that
+             *   onIdle was last called for it, in milliseconds; 0 if it never
+             *   was. only used by the owning reactor's thread.
+             */
+            unsigned long long lastReceive;
+            unsigned long long lastIdle;
+        };
+
+        /**
+         * a message on its way to one or more sockets, and the frames made
+         *   from it so far. every socket shares them, so a broadcast is
+         *   encoded, and compressed, at most once.
+         */
+        struct Outgoing
+        {
+            Outgoing(const Message& msg);
+            ~Outgoing();
+
+            /**
+             * message being sent.
+             */
+            const Message& msg;
+
+            /**
+             * the message encoded as it is; 0 until part of it is queued.
+             */
+            SharedFrame* frame;
+
+            /**
+             * the message's payload compressed; 0 until a peer that reads
+             *   compressed frames is sent it, or if it doesn't compress.
+             */
+            SharedFrame* packed;
+
+            /**
+             * non-zero once compressing the payload has been tried.
+             */
+            int packTried;
+        };
+
+        /**
+         * argument of a task that calls a connection's queued callbacks.
+         */
+        struct StrandTask
+        {
+            Host* host;
+            std::shared_ptr<Connection> conn;
+        };
+
+        /**
+         * a task for a reactor's thread to run once its delay is over.
+         */
+        struct DeferredTask
+        {
+            /**
+             * fires the task; armed by the reactor.
+             */
+            Timer timer;
+
+            /**
+             * time to wait for before running the task, in milliseconds.
+             */
+            int delay;
+
+            /**
+             * the task, and its argument.
+             */
+            void (*task)(void*);
+            void* arg;
+        };
+
+        /**
+         * a connection that connectAsync is establishing.
+         */
+        struct PendingConnect
+        {
+            /**
+             * host that is connecting.
+             */
+            Host* host;
+
+            /**
+             * name and port of the remote host; the name is owned.
+             */
+            char* remoteName;
+            short remotePort;
+
+            /**
+             * the connecting socket; -1 until the name is resolved.
+             */
+            int socket;
+
+            /**
+             * generation of the socket's io_uring requests, like a connected
+             *   socket's; only used by URING_BACKEND.
+             */
+            unsigned int generation;
+
+            /**
+             * errno value that connecting failed with, to pass to
+             *   onConnectFailed.
+             */
+            int error;
+
+            /**
+             * gives up on the connection after the connect timeout; armed by
+             *   the reactor that waits for the socket.
+             */
+            Timer timer;
+        };
+
+        /**
+         * header of each record that a host handing off sends its successor;
+         *   followed by len bytes, and sent along with a socket, if the
+         *   record is for one.
+         */
+        struct HandOffRecord
+        {
+            int type;   // HANDOFF_HELLO, HANDOFF_SERVER, and so on
+            int len;
+        };
+
+        /**
+         * state of a connection in a HANDOFF_CONNECTION record; followed by
+         *   the bytes received on the socket, but not handled yet, the bytes
+         *   queued to be sent on it, and the state saved by onHandOff.
+         */
+        struct SavedConnection
+        {
+            int sendVersion;
+            int receiveVersion;
+            int compress;
+            int receivedLen;
+            int queuedLen;
+            int stateLen;
+        };
+
+        /**
+         * a connection taken over from another host, until the listen
+         *   routine is started.
+         */
+        struct TakenOver
+        {
+            int socket;
+            std::string saved;  // SavedConnection, and the bytes after it
+        };
+
+        /**
+         * what a reactor needs to take over a socket, on top of its
+         *   connection state.
+         */
+        struct Adoption
+        {
+            std::string received;   // bytes received, but not handled yet
+            std::string state;      // state to pass to onTakeOver
+        };
+
+        /**
+         * request for a reactor's thread to do something.
+         */
+        struct Command
+        {
+            /**
+             * ADD_SOCK, ADOPT_SOCK, RM_SOCK, WATCH_SOCK, CORK_SOCK,
+             *   DEFER_TASK, CONNECT_SOCK or STOP_REACTOR.
+             */
+            int type;
+
+            /**
+             * socket that the command applies to.
+             */
+            int socket;
+
+            /**
+             * the DeferredTask of a DEFER_TASK command, the PendingConnect of
+             *   a CONNECT_SOCK command, or the Adoption of an ADOPT_SOCK
+             *   command.
+             */
+            void* data;
+        };
+
+        /**
+         * one receive loop; each reactor selects and reads its own share of
+         *   the connected sockets on its own thread.
+         */
+        struct Reactor
+        {
+            /**
+             * host that the reactor belongs to.
+             */
+            Host* host;
+
+            /**
+             * thread id for the thread that runs the receiveRoutine.
+             */
+            pthread_t thread;
+
+            /**
+             * commands for the reactor's thread to carry out.
+             */
+            MpscQueue<Command> commands;
+
+            /**
+             * eventfd that wakes up the reactor's thread when commands are
+             *   queued.
+             */
+            int eventFd;
+
+            /**
+             * non-zero while the eventfd has been written to, but the reactor
+             *   hasn't started draining the commands yet; later commands don't
+             *   need to write to it again.
+             */
+            std::atomic<int> signalled;
+
+            /**
+             * sockets that are selected by the reactor's thread; only used
+             *   by EPOLL_BACKEND.
+             */
+            Files files;
+
+            /**
+             * ring that the reactor's thread does its I/O through; only used
+             *   by URING_BACKEND.
+             */
+            Uring ring;
+
+            /**
+             * timers of the reactor's idle checks and deferred tasks, in
+             *   milliseconds; only used by the reactor's thread.
+             */
+            TimerWheel wheel;
+
+            /**
+             * sockets that the reactor waits on to be connected, to hand them
+             *   over to addSocket; only used by the reactor's thread.
+             */
+            std::map<int,PendingConnect*> connecting;
+
+            /**
+             * number of sockets currently owned by the reactor; guarded by
+             *   connectionsLock.
+             */
+            int numSockets;
+
+            /**
+             * receive counters; only written by the reactor's thread.
+             */
+            std::atomic<unsigned long long> reads;
+            std::atomic<unsigned long long> frames;
+            std::atomic<unsigned long long> bytes;
+            std::atomic<unsigned long long> numCommands;
+            std::atomic<unsigned long long> wakeups;
+            std::atomic<unsigned long long> carryOvers;
+
+            /**
+             * send counters of the sockets that the reactor owned, added up
+             *   as each socket is released; those of the sockets it owns are
+             *   kept by their connections.
+             */
+            std::atomic<unsigned long long> framesSent;
+            std::atomic<unsigned long long> bytesSent;
+            std::atomic<unsigned long long> writes;
+            std::atomic<unsigned long long> framesQueued;
+
+            /**
+             * time that sockets waited to be served, in nanoseconds.
+             */
+            Histogram serviceLatency;
+
+            /**
+             * time spent in onMessage for the reactor's sockets, and in one
+             *   in SEND_SAMPLE_RATE write system calls on each of them, in
+             *   nanoseconds.
+             */
+            Histogram dispatchLatency;
+            Histogram sendLatency;
+        };
+
+        void postCommand(Reactor* reactor, int type, int socket,
+            void* data = 0);
+        void addSocket(int socket);
+        void adoptSocket(int socket, const std::string& saved);
+        void registerConnection(const std::shared_ptr<Connection>& conn);
+        void releaseSocket(int socket);
+        std::shared_ptr<Connection> findConnection(int socket);
+        int sendFrame(int socket, Outgoing* out, int coalesce);
+        int writeFrame(Connection* conn, Outgoing* out, int coalesce,
+            int nextVersion);
+        void uncork(Connection* conn);
+        void sendHello(Connection* conn, int nextVersion);
+        void receiveHello(Connection* conn, const Message& msg);
+        void flushConnection(Connection* conn);
+        void flushQueue(Connection* conn);
+        unsigned long long startWrite(Connection* conn);
+        void countWrite(Connection* conn, unsigned long long start,
+            long bytes);
+        int serveConnection(Reactor* reactor,
+            const std::shared_ptr<Connection>& conn);
+        void watchWritable(Connection* conn);
+        void dispatchConnect(const std::shared_ptr<Connection>& conn);
+        int dispatchTakeOver(const std::shared_ptr<Connection>& conn,
+            Adoption* adoption);
+        int feedConnection(const std::shared_ptr<Connection>& conn,
+            const char* data, int len, unsigned long long* numFrames);
+        void dispatchIdle(Connection* conn);
+        void dispatchMessage(const std::shared_ptr<Connection>& conn,
+            Message& msg);
+        void dispatchDisconnect(const std::shared_ptr<Connection>& conn,
+            int remote);
+        void postEvent(const std::shared_ptr<Connection>& conn,
+            Event& event);
+        void closeSocket(int socket, int remote);
+        void watchIdle(Reactor* reactor, Connection* conn);
+        void checkIdle(Reactor* reactor, Connection* conn);
+        static void runStrand(void* params);
+        static void idleTimerFired(void* context, void* arg);
+        static void deferredTaskFired(void* context, void* arg);
+        static void clearTimers(Reactor* reactor);
+        static void remoteResolved(void* arg, int result,
+            const struct in_addr* addr);
+        static void connectTimedOut(void* context, void* arg);
+        static void runConnectFailed(void* params);
+        void watchConnect(Reactor* reactor, PendingConnect* pending);
+        void finishConnect(Reactor* reactor, PendingConnect* pending,
+            int timedOut);
+        void failConnect(PendingConnect* pending, int error);
+        void dropConnects(Reactor* reactor);
+        void dropCommands(Reactor* reactor);
         int startReceiveRoutine();
         int stopReceiveRoutine();
         int startRoutine(pthread_t* thread, void*(*routine)(void*), int* controlPipe, void* params);
         int stopRoutine(pthread_t* thread, int* controlPipe);
         static void* listenRoutine(void* params);
         static void* receiveRoutine(void* params);
+        static void* uringListenRoutine(void* params);
+        static void* uringReceiveRoutine(void* params);
+        void releaseListeners();
+        void handOff(int successor);
+        int saveConnection(Connection* conn, std::string* saved);
+        static int sendRecord(int successor, int type, int fd,
+            const void* data, int len);
+        static void* statsRoutine(void* params);
+        void dumpStats();
 
         /**
          * socket used to listen for new connections from.
          */
         int svrSock;
 
+        /**
+         * socket used to listen for connections from the same host on a unix
+         *   domain path; -1 if there is none.
+         */
+        int localSock;
+
+        /**
+         * path that localSock is bound to.
+         */
+        std::string localPath;
+
+        /**
+         * socket used to listen for a successor to hand off to, on
+         *   handOffPath; -1 if there is none.
+         */
+        int handOffSock;
+        std::string handOffPath;
+
+        /**
+         * connections taken over from another host, that are served once the
+         *   listen routine is started.
+         */
+        std::vector<TakenOver> takenOver;
+
+        /**
+         * non-zero while the host hands off to a successor, so its reactors
+         *   stop without closing their sockets, and once it has.
+         */
+        std::atomic<int> handingOff;
+        std::atomic<int> isHandedOff;
+
+        /**
+         * signalled by the workers whenever a connection's callbacks run out
+         *   while the host hands off, so it can wait for all of them to.
+         */
+        pthread_mutex_t drainLock;
+        pthread_cond_t drained;
+
+        /**
+         * non-zero once the reactors are told to terminate; connections
+         *   that connectAsync resolves afterwards fail.
+         */
+        std::atomic<int> reactorsStopped;
+
+        /**
+         * file that printStats is written to every statsInterval
+         *   milliseconds; empty if there is none.
+         */
+        std::string statsPath;
+        int statsInterval;
+
+        /**
+         * thread that runs the statsRoutine, and the pipe used to stop it.
+         */
+        pthread_t statsThread;
+        int statsPipe[2];
+
         /**
          * pipe used to communicate with the listenThread.
          */
@@ -64,14 +850,105 @@ namespace Net
         pthread_t listenThread;
 
         /**
-         * pipe used to communicate with the receiveThread.
+         * EPOLL_BACKEND or URING_BACKEND.
+         */
+        int backend;
+
+        /**
+         * pool that calls the handlers, so a slow handler doesn't hold up
+         *   reading; unused if numWorkers is INLINE_HANDLERS.
+         */
+        Workers workers;
+        int numWorkers;
+
+        /**
+         * number of receive loops that connected sockets are spread across.
+         */
+        int numReactors;
+
+        /**
+         * array of numReactors receive loops.
+         */
+        Reactor* reactors;
+
+        /**
+         * state of each connected socket, indexed by socket; empty for
+         *   sockets that aren't owned by any reactor.
+         */
+        std::vector<std::shared_ptr<Connection> > connections;
+
+        /**
+         * guards connections, nextReactor and the reactors' numSockets.
+         */
+        pthread_mutex_t connectionsLock;
+
+        /**
+         * reactor to start searching from when placing the next socket, so
+         *   ties between equally loaded reactors are broken round-robin.
+         */
+        int nextReactor;
+
+        /**
+         * number of bytes that may be queued for a peer before sends to it
+         *   fail with QUEUE_FULL.
+         */
+        long highWaterMark;
+
+        /**
+         * most bytes read from, and frames dispatched for, one socket each
+         *   time its reactor serves it.
+         */
+        int readBudget;
+        int frameBudget;
+
+        /**
+         * newest framing that the host offers to its peers.
+         */
+        int wireVersion;
+
+        /**
+         * time that broadcasts to a peer are held back for, so they go out
+         *   together in one write, in microseconds, and as a timeout for
+         *   io_uring; NO_COALESCING to send them right away.
+         */
+        int coalesceWindow;
+        struct __kernel_timespec coalesceTimeout;
+
+        /**
+         * number of held back bytes that a peer's broadcasts are sent at,
+         *   before the window is over.
+         */
+        long coalesceBytes;
+
+        /**
+         * size of the smallest payload that is compressed for peers that
+         *   read compressed frames.
+         */
+        int compressThreshold;
+
+        /**
+         * time without receiving anything after which onIdle is called for a
+         *   connection, and it is closed, in milliseconds; NO_IDLE_TIMEOUT
+         *   to never do either.
+         */
+        int pingTimeout;
+        int closeTimeout;
+
+        /**
+         * resolves the names passed to connectAsync.
+         */
+        Resolver resolver;
+
+        /**
+         * time that connectAsync waits for a connection to be established,
+         *   in milliseconds.
          */
-        int receivePipe[2];
+        int connectTimeout;
 
         /**
-         * thread id for the thread that runs the receiveRoutine.
+         * non-zero if callbacks should print a line for every event.
          */
-        pthread_t receiveThread;
+        int verbose;
     };
 }
 
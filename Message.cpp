@@ -0,0 +1,142 @@
+#include "Message.h"
+#include "shared_frame.h"
+
+#include <string.h>
+
+using namespace Net;
+
+/**
+ * constructs an empty message.
+ */
+Message::Message()
+{
+    type = 0;
+    data = 0;
+    len = 0;
+    buffer = 0;
+}
+
+/**
+ * constructs a view of the caller's data. the data must outlive the message,
+ *   or the message must be made an owner with own().
+ *
+ * @param type type of the message.
+ * @param data payload of the message.
+ * @param len number of bytes in the payload.
+ */
+Message::Message(int type, const void* data, int len)
+{
+    this->type = type;
+    this->data = (void*) data;
+    this->len = len;
+    buffer = 0;
+}
+
+/**
+ * copies a message. a copy of an owner shares the owner's buffer.
+ */
+Message::Message(const Message& other)
+{
+    type = other.type;
+    data = other.data;
+    len = other.len;
+    buffer = (other.buffer != 0) ? frame_retain(other.buffer) : 0;
+}
+
+/**
+ * moves a message, leaving {other} empty.
+ */
+Message::Message(Message&& other)
+{
+    type = other.type;
+    data = other.data;
+    len = other.len;
+    buffer = other.buffer;
+    other.data = 0;
+    other.len = 0;
+    other.buffer = 0;
+}
+
+/**
+ * releases the message's buffer, if it owns one.
+ */
+Message::~Message()
+{
+    if(buffer != 0)
+    {
+        frame_release(buffer);
+    }
+}
+
+Message& Message::operator=(const Message& other)
+{
+    if(this != &other)
+    {
+        Message copy(other);
+        *this = static_cast<Message&&>(copy);
+    }
+    return *this;
+}
+
+Message& Message::operator=(Message&& other)
+{
+    if(this != &other)
+    {
+        if(buffer != 0)
+        {
+            frame_release(buffer);
+        }
+        type = other.type;
+        data = other.data;
+        len = other.len;
+        buffer = other.buffer;
+        other.data = 0;
+        other.len = 0;
+        other.buffer = 0;
+    }
+    return *this;
+}
+
+/**
+ * @return non-zero if the message owns its payload; 0 if it is a view.
+ */
+int Message::isOwner() const
+{
+    return buffer != 0;
+}
+
+/**
+ * makes the message an owner of its payload. a view's payload is copied into
+ *   a pooled buffer, along with the frame's header; an owner is left as is.
+ *
+ * @return this message.
+ */
+Message& Message::own()
+{
+    if(buffer == 0)
+    {
+        buffer = frame_encode(*this);
+        data = buffer->data+FRAME_HEADER_LEN;
+    }
+    return *this;
+}
+
+/**
+ * returns the buffer that holds this message already encoded as a frame, so
+ *   it can be sent without encoding, or copying it again.
+ *
+ * @return the encoded frame; 0 if the message is a view, or its type or
+ *   payload no longer match its buffer.
+ */
+SharedFrame* Message::encodedFrame() const
+{
+    if(buffer == 0 || data != buffer->data+FRAME_HEADER_LEN
+        || len != buffer->len-FRAME_HEADER_LEN)
+    {
+        return 0;
+    }
+
+    int encodedType;
+    memcpy(&encodedType,buffer->data,sizeof(encodedType));
+    return (encodedType == type) ? buffer : 0;
+}
@@ -1,14 +1,46 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+struct SharedFrame;
+
 namespace Net
 {
 
+    /**
+     * a message sent between hosts.
+     *
+     * a message is either a view, or an owner. a view points at memory that it
+     *   doesn't own, like the caller's own data, or a host's receive buffer;
+     *   a view received by onMessage is only valid until onMessage returns.
+     *   an owner holds a reference to a pooled buffer that holds the whole
+     *   encoded frame, so it stays valid for as long as it lives, and can be
+     *   sent on to other hosts without copying the payload.
+     *
+     * copying an owner shares its buffer; moving it transfers the buffer.
+     */
     struct Message
     {
+        Message();
+        Message(int type, const void* data, int len);
+        Message(const Message& other);
+        Message(Message&& other);
+        ~Message();
+        Message& operator=(const Message& other);
+        Message& operator=(Message&& other);
+
+        int isOwner() const;
+        Message& own();
+        SharedFrame* encodedFrame() const;
+
         int type;
         void* data;
         int len;
+
+        /**
+         * pooled buffer holding the encoded frame that data points into; 0
+         *   for a view.
+         */
+        SharedFrame* buffer;
     };
 }
 
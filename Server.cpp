@@ -1,15 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "Server.h"
 #include "Message.h"
 #include "protocol.h"
 
-Server::Server()
+/**
+ * removes a socket from a list of unordered sockets, by moving the last one
+ *   into its place.
+ */
+static void leave_out(std::vector<int>& sockets, int except)
 {
+    for(size_t i = 0; i < sockets.size(); ++i)
+    {
+        if(sockets[i] == except)
+        {
+            sockets[i] = sockets.back();
+            sockets.pop_back();
+            break;
+        }
+    }
+}
+
+/**
+ * returns the current time in milliseconds.
+ */
+static unsigned long long now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec*1000ULL+now.tv_nsec/1000000;
+}
+
+/**
+ * @param backend EPOLL_BACKEND or URING_BACKEND.
+ * @param numWorkers number of threads that handle messages, or
+ *   INLINE_HANDLERS to handle them on the threads that read them.
+ */
+Server::Server(int backend, int numWorkers) :
+    Host(AUTO_REACTORS,backend,numWorkers)
+{
+    clients_init(&clients);
+    names_init(&names);
+    rooms_init(&rooms);
+    pthread_mutex_init(&clientsLock,0);
+    logging = 0;
+    pthread_mutex_init(&logLock,0);
+    statsTime = 0;
+    pthread_mutex_init(&statsLock,0);
 }
 
 Server::~Server()
 {
+    // the handlers use everything freed below
+    stop();
+    if(logging)
+    {
+        mlog_close(&log);
+    }
+    pthread_mutex_destroy(&logLock);
+    pthread_mutex_destroy(&statsLock);
+    pthread_mutex_destroy(&clientsLock);
+    rooms_destroy(&rooms);
+    names_destroy(&names);
+    clients_destroy(&clients);
+}
+
+/**
+ * logs the chat messages to a directory of segment files, and replays the
+ *   latest ones of the lobby and of each room to the clients that join them.
+ *   the messages already in the directory are recovered. must be called
+ *   before the server starts listening.
+ *
+ * @param dir directory to keep the log in; created if it doesn't exist.
+ * @param segmentSize size of each segment file, in bytes.
+ * @param maxSegments most segment files kept.
+ * @param history number of the latest messages replayed to joining clients.
+ *
+ * @return SUCCESS; SYS_ERROR if the log couldn't be opened. check errno for
+ *   details.
+ */
+int Server::openLog(const char* dir, long segmentSize, int maxSegments,
+    int history)
+{
+    if(logging)
+    {
+        mlog_close(&log);
+        logging = 0;
+    }
+    if(mlog_open(&log,dir,segmentSize,maxSegments,history) == -1)
+    {
+        return SYS_ERROR;
+    }
+    logging = 1;
+    return SUCCESS;
 }
 
 void Server::onConnect(int socket)
@@ -17,101 +103,546 @@ void Server::onConnect(int socket)
     Host::onConnect(socket);
 }
 
-void Server::onMessage(int socket, Net::Message msg)
+void Server::onMessage(int socket, Net::Message& msg)
 {
     Host::onMessage(socket,msg);
     switch(msg.type)
     {
     case SHOW_MSG:
-        onMessage(socket,(char*)msg.data);
+        onShowMessage(socket,msg);
         break;
     case CHECK_USR_NAME:
-        onCheckUserName(socket,(char*)msg.data);
+        onCheckUserName(socket,msg);
+        break;
+    case JOIN_ROOM:
+        onJoinRoom(socket,msg);
+        break;
+    case LEAVE_ROOM:
+        onLeaveRoom(socket,msg);
+        break;
+    case ROOM_MSG:
+        onRoomMessage(socket,msg);
+        break;
+    case STATS:
+        onStats(socket);
         break;
     }
 }
 
+/**
+ * tells the other clients that a client has left, if it had joined, and the
+ *   members of every room that it was in.
+ */
 void Server::onDisconnect(int socket, int remote)
 {
     Host::onDisconnect(socket,remote);
+
+    // free the client's name, keeping a copy to tell the others
+    char name[MAX_NAME_LEN+1];
+    int nameLen = 0;
+    unsigned long long numMessages = 0;
+    std::vector<Net::Message> leaves;
+    std::vector<std::vector<int> > leftMembers;
+    pthread_mutex_lock(&clientsLock);
+    int pos = clients_find(&clients,socket);
+    int joined = (pos != NO_CLIENT);
+    if(joined)
+    {
+        int id;
+        numMessages = clients.messages[pos];
+        clients_remove(&clients,socket,&id);
+        nameLen = names_len(&names,id);
+        memcpy(name,names_get(&names,id),nameLen+1);
+        names_release(&names,id);
+
+        // leave every room, noting who is left in each to tell them
+        int inRooms[MAX_ROOMS_PER_SOCKET];
+        int numRooms = rooms_joined(&rooms,socket,inRooms);
+        for(int i = 0; i < numRooms; ++i)
+        {
+            char leave[MAX_NAME_LEN*2+2];
+            int roomLen = strlen(rooms_name(&rooms,inRooms[i]));
+            memcpy(leave,rooms_name(&rooms,inRooms[i]),roomLen+1);
+            memcpy(leave+roomLen+1,name,nameLen+1);
+            if(rooms_leave(&rooms,socket,inRooms[i]) > 0)
+            {
+                leaves.push_back(Net::Message(LEAVE_ROOM,leave,
+                    roomLen+nameLen+2).own());
+                leftMembers.push_back(rooms.rooms[inRooms[i]].members);
+            }
+        }
+    }
+    pthread_mutex_unlock(&clientsLock);
+
+    for(size_t i = 0; i < leaves.size(); ++i)
+    {
+        broadcast(leftMembers[i],leaves[i]);
+    }
+    if(joined)
+    {
+        Net::Message clientName(RM_CLIENT,name,nameLen+1);
+        onClientDisconnect(socket,clientName,numMessages);
+    }
 }
 
-void Server::onClientConnect(int clntSock, char* clientName)
+/**
+ * answers a client that asked for the server's metrics with its report. the
+ *   report walks every connection, so it is made at most once every
+ *   STATS_MAX_AGE milliseconds; clients that ask meanwhile get the same one.
+ */
+void Server::onStats(int clntSock)
 {
-    printf("%s has connected.\n",clientName);
-    clients[clntSock] = clientName;
+    pthread_mutex_lock(&statsLock);
+    unsigned long long now = now_ms();
+    if(statsReport.empty() || now-statsTime >= STATS_MAX_AGE)
+    {
+        char* report;
+        size_t reportLen;
+        FILE* file = open_memstream(&report,&reportLen);
+        if(file == 0)
+        {
+            pthread_mutex_unlock(&statsLock);
+            return;
+        }
+        printStats(file);
+        fclose(file);
+        statsReport.assign(report,reportLen+1);
+        statsTime = now;
+        free(report);
+    }
+    std::string report = statsReport;
+    pthread_mutex_unlock(&statsLock);
 
-    // construct the chat message
-    Net::Message msg;
-    msg.type = ADD_CLIENT;
-    msg.len  = strlen(clientName);
-    msg.data = clientName;
+    send(clntSock,Net::Message(STATS,report.data(),report.size()));
+}
 
-    // send connect message to all clients
-    for(auto client = clients.begin(); client != clients.end(); ++client)
+/**
+ * saves the client's name, followed by the name of every room that it is in,
+ *   each of them null terminated; nothing if it hasn't joined.
+ */
+void Server::onHandOff(int socket, std::string& state)
+{
+    Host::onHandOff(socket,state);
+
+    pthread_mutex_lock(&clientsLock);
+    int pos = clients_find(&clients,socket);
+    if(pos != NO_CLIENT)
     {
-        auto curSock = (*client).first;
-        send(curSock,msg);
+        int id = clients.names[pos];
+        state.append(names_get(&names,id),names_len(&names,id)+1);
+
+        int inRooms[MAX_ROOMS_PER_SOCKET];
+        int numRooms = rooms_joined(&rooms,socket,inRooms);
+        for(int i = 0; i < numRooms; ++i)
+        {
+            const char* room = rooms_name(&rooms,inRooms[i]);
+            state.append(room,strlen(room)+1);
+        }
     }
+    pthread_mutex_unlock(&clientsLock);
 }
 
-void Server::onClientDisconnect(int clntSock, char* clientName)
+/**
+ * seals the log, so the successor can open it once it has taken over.
+ */
+void Server::onHandedOff()
 {
-    printf("%s has disconnected.\n",clientName);
-    clients.erase(clntSock);
+    Host::onHandedOff();
+
+    pthread_mutex_lock(&logLock);
+    if(logging)
+    {
+        mlog_close(&log);
+        logging = 0;
+    }
+    pthread_mutex_unlock(&logLock);
+}
+
+/**
+ * restores the name and rooms of a client that was handed off by another
+ *   server; the other clients already know it, so nobody is told.
+ */
+void Server::onTakeOver(int socket, const char* state, int len)
+{
+    Host::onTakeOver(socket,state,len);
+    if(len == 0 || state[len-1] != 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&clientsLock);
+    int nameLen = strlen(state);
+    int id = names_claim(&names,state,nameLen);
+    clients_add(&clients,socket,id);
+    for(int pos = nameLen+1; pos < len; pos += strlen(state+pos)+1)
+    {
+        rooms_join(&rooms,socket,state+pos,strlen(state+pos));
+    }
+    pthread_mutex_unlock(&clientsLock);
+}
+
+/**
+ * disconnects clients that aren't reading their messages fast enough, rather
+ *   than letting them hold up everyone else's.
+ */
+void Server::onQueueFull(int socket)
+{
+    Host::onQueueFull(socket);
+    disconnect(socket);
+}
+
+/**
+ * asks a client that has gone quiet for a sign of life; one that is gone
+ *   never answers, and is disconnected once its idle timeout is over.
+ */
+void Server::onIdle(int socket)
+{
+    Host::onIdle(socket);
+    send(socket,Net::Message(PING,0,0));
+}
+
+/**
+ * a client has joined, and has been added to clients under the name given to
+ *   it.
+ */
+void Server::onClientConnect(int clntSock, Net::Message& clientName)
+{
+    if(isVerbose())
+    {
+        printf("%s has connected on socket %d.\n",(char*)clientName.data,
+            clntSock);
+    }
 
     // construct the chat message
-    Net::Message msg;
-    msg.type = RM_CLIENT;
-    msg.len  = strlen(clientName);
-    msg.data = clientName;
+    Net::Message msg(ADD_CLIENT,clientName.data,clientName.len);
+
+    // send connect message to all clients
+    broadcast(clientSockets(-1),msg);
+}
 
-    // send message to all clients except the one that sent it
-    for(auto client = clients.begin(); client != clients.end(); ++client)
+/**
+ * a client that had joined has disconnected, and has been removed from
+ *   clients.
+ */
+void Server::onClientDisconnect(int clntSock, Net::Message& clientName,
+    unsigned long long numMessages)
+{
+    if(isVerbose())
     {
-        auto curSock = (*client).first;
-        send(curSock,msg);
+        printf("%s has disconnected from socket %d after %llu messages.\n",
+            (char*)clientName.data,clntSock,numMessages);
     }
+
+    // construct the chat message
+    Net::Message msg(RM_CLIENT,clientName.data,clientName.len);
+
+    // send message to all remaining clients
+    broadcast(clientSockets(-1),msg);
 }
 
-void Server::onMessage(int clntSock, char* message)
+void Server::onShowMessage(int clntSock, Net::Message& message)
 {
     // print message
-    printf("%s\n",message);
+    if(isVerbose())
+    {
+        printf("%.*s\n",message.len,(char*)message.data);
+    }
 
-    // construct the chat message
-    Net::Message msg;
-    msg.type = SHOW_MSG;
-    msg.len  = strlen(message);
-    msg.data = message;
+    // count it against the sender, if it has joined, and log it
+    int logged = lockLog();
+    pthread_mutex_lock(&clientsLock);
+    int pos = clients_find(&clients,clntSock);
+    if(pos != NO_CLIENT)
+    {
+        ++clients.messages[pos];
+        clients.bytes[pos] += message.len;
+    }
+    pthread_mutex_unlock(&clientsLock);
+    std::vector<int> sockets = clientSockets(clntSock);
+    if(logged)
+    {
+        mlog_append(&log,message);
+    }
+    unlockLog(logged);
 
-    // send message to all clients except the one that sent it
-    for(auto client = clients.begin(); client != clients.end(); ++client)
+    // send message to all clients except the one that sent it; the received
+    // frame is passed on as is, without being encoded or copied again
+    broadcast(sockets,message);
+}
+
+/**
+ * a client has asked to join a chat room. every member is told, the client
+ *   included, so it knows that it is in the room.
+ */
+void Server::onJoinRoom(int clntSock, Net::Message& request)
+{
+    const char* room = (const char*) request.data;
+    int roomLen = strnlen(room,request.len);
+
+    // copy the room's members with the announcement, so it can be sent
+    // without holding the lock
+    char join[MAX_NAME_LEN*2+2];
+    int joinLen = 0;
+    std::vector<int> members;
+    int logged = lockLog();
+    pthread_mutex_lock(&clientsLock);
+    int pos = clients_find(&clients,clntSock);
+    int id = (pos != NO_CLIENT) ?
+        rooms_join(&rooms,clntSock,room,roomLen) : NO_ROOM;
+    if(id != NO_ROOM)
     {
-        auto curSock = (*client).first;
-        if(curSock != clntSock)
+        int nameLen = names_len(&names,clients.names[pos]);
+        roomLen = strlen(rooms_name(&rooms,id));
+        memcpy(join,rooms_name(&rooms,id),roomLen+1);
+        memcpy(join+roomLen+1,names_get(&names,clients.names[pos]),nameLen+1);
+        joinLen = roomLen+nameLen+2;
+        members = rooms.rooms[id].members;
+    }
+    pthread_mutex_unlock(&clientsLock);
+
+    if(isVerbose())
+    {
+        printf("onJoinRoom(%d,%.*s): %s\n",clntSock,roomLen,room,
+            (id != NO_ROOM) ? "joined" : "refused");
+    }
+    if(id != NO_ROOM)
+    {
+        broadcast(members,Net::Message(JOIN_ROOM,join,joinLen));
+        if(logged)
         {
-            send(curSock,msg);
+            replayHistory(clntSock,join,roomLen);
         }
     }
+    unlockLog(logged);
 }
 
-void Server::onCheckUserName(int clntSock, char* newUsername)
+/**
+ * a client has asked to leave a chat room. the members that are left are
+ *   told, and so is the client.
+ */
+void Server::onLeaveRoom(int clntSock, Net::Message& request)
 {
-    printf("onCheckUserName(%d,%s)\n",clntSock,newUsername);
-    onClientConnect(clntSock,newUsername);
+    const char* room = (const char*) request.data;
+    int roomLen = strnlen(room,request.len);
+
+    char leave[MAX_NAME_LEN*2+2];
+    int leaveLen = 0;
+    int numLeft = NO_ROOM;
+    std::vector<int> members;
+    pthread_mutex_lock(&clientsLock);
+    int pos = clients_find(&clients,clntSock);
+    int id = (pos != NO_CLIENT) ? rooms_find(&rooms,room,roomLen) : NO_ROOM;
+    if(id != NO_ROOM && rooms_is_member(&rooms,clntSock,id))
+    {
+        // the name goes with the room's last member, so it is copied first
+        int nameLen = names_len(&names,clients.names[pos]);
+        roomLen = strlen(rooms_name(&rooms,id));
+        memcpy(leave,rooms_name(&rooms,id),roomLen+1);
+        memcpy(leave+roomLen+1,names_get(&names,clients.names[pos]),nameLen+1);
+        leaveLen = roomLen+nameLen+2;
+        numLeft = rooms_leave(&rooms,clntSock,id);
+        if(numLeft > 0)
+        {
+            members = rooms.rooms[id].members;
+        }
+    }
+    pthread_mutex_unlock(&clientsLock);
+
+    if(isVerbose())
+    {
+        printf("onLeaveRoom(%d,%.*s): %d left\n",clntSock,roomLen,room,
+            numLeft);
+    }
+    if(numLeft != NO_ROOM)
+    {
+        members.push_back(clntSock);
+        broadcast(members,Net::Message(LEAVE_ROOM,leave,leaveLen));
+    }
 }
 
-int main(void)
+/**
+ * a member of a chat room has said something in it. only the room's members
+ *   are sent it, so the cost of a message is the size of its room, however
+ *   many clients there are.
+ */
+void Server::onRoomMessage(int clntSock, Net::Message& message)
 {
-    Server* svr = new Server();
+    const char* room = (const char*) message.data;
+    int roomLen = strnlen(room,message.len);
+    if(isVerbose() && roomLen < message.len)
+    {
+        printf("#%.*s: %.*s\n",roomLen,room,message.len-roomLen-1,
+            room+roomLen+1);
+    }
 
-    svr->startListeningRoutine(7000);
-    printf("server started\n");
-    getchar();
+    // count it against the sender, which must be in the room, and copy the
+    // room's members to send it to without holding the lock
+    std::vector<int> members;
+    int logged = lockLog();
+    pthread_mutex_lock(&clientsLock);
+    int id = rooms_find(&rooms,room,roomLen);
+    int isMember = (id != NO_ROOM && rooms_is_member(&rooms,clntSock,id));
+    if(isMember)
+    {
+        int pos = clients_find(&clients,clntSock);
+        ++clients.messages[pos];
+        clients.bytes[pos] += message.len;
+        members = rooms.rooms[id].members;
+    }
+    pthread_mutex_unlock(&clientsLock);
+    if(isMember && logged)
+    {
+        mlog_append(&log,message);
+    }
+    unlockLog(logged);
 
-    delete svr;
-    printf("server stopped\n");
+    // the received frame is passed on as is, as for SHOW_MSG
+    if(isMember)
+    {
+        leave_out(members,clntSock);
+        broadcast(members,message);
+    }
+}
+
+/**
+ * returns the sockets of all connected clients, so a message can be broadcast
+ *   to them without holding clientsLock.
+ *
+ * @param except socket to leave out; -1 to include every client.
+ *
+ * @return sockets of the connected clients.
+ */
+std::vector<int> Server::clientSockets(int except)
+{
+    pthread_mutex_lock(&clientsLock);
+    std::vector<int> sockets(clients.sockets,clients.sockets+clients.count);
+    pthread_mutex_unlock(&clientsLock);
+    leave_out(sockets,except);
+    return sockets;
+}
 
-    return 0;
+/**
+ * takes logLock, if the server keeps a log. a hand-off turns logging off
+ *   under the lock, so it is checked again once the lock is held.
+ *
+ * @return non-zero if the lock was taken, and the log is open until it is
+ *   given back to unlockLog.
+ */
+int Server::lockLog()
+{
+    if(!logging)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&logLock);
+    if(!logging)
+    {
+        pthread_mutex_unlock(&logLock);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @param logged what lockLog returned.
+ */
+void Server::unlockLog(int logged)
+{
+    if(logged)
+    {
+        pthread_mutex_unlock(&logLock);
+    }
+}
+
+/**
+ * sends a client that has joined the lobby, or a room, the latest messages
+ *   said in it, straight out of the log's files. called once lockLog has
+ *   taken logLock.
+ *
+ * @param clntSock socket of the client.
+ * @param room name of the room; 0 for the lobby.
+ * @param roomLen length of {room}.
+ */
+void Server::replayHistory(int clntSock, const char* room, int roomLen)
+{
+    std::vector<LogExtent> extents(log.history);
+    int numFound = mlog_history(&log,room,roomLen,extents.data());
+    for(int i = 0; i < numFound; ++i)
+    {
+        if(sendFile(clntSock,extents[i].type,extents[i].file,
+            extents[i].offset,extents[i].len) != SUCCESS)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * a client has asked to join with a user name. it is given the name, or one
+ *   made unique from it, and a client that asks again is renamed. large
+ *   payloads are sent to it compressed if it says it reads them; the reply
+ *   tells it the name it was given, and whether the server reads compressed
+ *   payloads in turn.
+ */
+void Server::onCheckUserName(int clntSock, Net::Message& newUsername)
+{
+    // split the request into the name, and the capabilities after it
+    char* name = (char*) newUsername.data;
+    int nameLen = strnlen(name,newUsername.len);
+    if(nameLen < newUsername.len)
+    {
+        ++nameLen;
+    }
+    int caps = (nameLen < newUsername.len) ?
+        ((unsigned char*) newUsername.data)[nameLen] : 0;
+    caps &= CAP_COMPRESSION;
+
+    if(isVerbose())
+    {
+        printf("onCheckUserName(%d,%.*s,%d)\n",clntSock,nameLen,name,caps);
+    }
+    if(caps&CAP_COMPRESSION)
+    {
+        setCompression(clntSock,1);
+    }
+
+    // register the name, and copy the one that was given, and the one it
+    // replaces, if any, so they can be sent without holding the lock
+    char given[MAX_NAME_LEN+2];
+    char replaced[MAX_NAME_LEN+1];
+    int replacedLen = -1;
+    int logged = lockLog();
+    pthread_mutex_lock(&clientsLock);
+    int pos = clients_find(&clients,clntSock);
+    if(pos != NO_CLIENT)
+    {
+        int id = clients.names[pos];
+        replacedLen = names_len(&names,id);
+        memcpy(replaced,names_get(&names,id),replacedLen+1);
+        names_release(&names,id);
+    }
+    int id = names_claim(&names,name,strnlen(name,nameLen));
+    clients_add(&clients,clntSock,id);
+    int givenLen = names_len(&names,id);
+    memcpy(given,names_get(&names,id),givenLen+1);
+    pthread_mutex_unlock(&clientsLock);
+
+    // confirm the name, and the capabilities that were accepted
+    given[givenLen+1] = (char) caps;
+    send(clntSock,Net::Message(SET_USR_NAME,given,givenLen+2));
+
+    // a client that is new to the chat is sent what was said before it came
+    if(pos == NO_CLIENT && logged)
+    {
+        replayHistory(clntSock,0,0);
+    }
+    unlockLog(logged);
+
+    if(replacedLen != -1)
+    {
+        Net::Message replacedName(RM_CLIENT,replaced,replacedLen+1);
+        broadcast(clientSockets(-1),replacedName);
+    }
+    Net::Message clientName(ADD_CLIENT,given,givenLen+1);
+    onClientConnect(clntSock,clientName);
 }
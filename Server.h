@@ -1,6 +1,20 @@
-#include <map>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <pthread.h>
 
 #include "Host.h"
+#include "Message.h"
+#include "client_table.h"
+#include "name_registry.h"
+#include "room_index.h"
+#include "message_log.h"
+
+/**
+ * longest time, in milliseconds, that the report sent in answer to STATS is
+ *   reused for, before it is made again.
+ */
+#define STATS_MAX_AGE 1000
 
 namespace Net
 {
@@ -11,16 +25,72 @@ namespace Net
 class Server : public Net::Host
 {
 public:
-    Server();
+    Server(int backend = EPOLL_BACKEND, int numWorkers = INLINE_HANDLERS);
     ~Server();
+    int openLog(const char* dir, long segmentSize = LOG_DEFAULT_SEGMENT_SIZE,
+        int maxSegments = LOG_DEFAULT_MAX_SEGMENTS,
+        int history = LOG_DEFAULT_HISTORY);
 protected:
     virtual void onConnect(int socket);
-    virtual void onMessage(int socket, Net::Message msg);
+    virtual void onMessage(int socket, Net::Message& msg);
     virtual void onDisconnect(int socket, int remote);
+    virtual void onQueueFull(int socket);
+    virtual void onIdle(int socket);
+    virtual void onHandOff(int socket, std::string& state);
+    virtual void onHandedOff();
+    virtual void onTakeOver(int socket, const char* state, int len);
 private:
-    void onClientConnect(int clntSock, char* clientName);
-    void onClientDisconnect(int clntSock, char* clientName);
-    void onMessage(int clntSock, char* message);
-    void onCheckUserName(int clntSock, char* newUsername);
-    std::map<int,char*> clients;
+    void onClientConnect(int clntSock, Net::Message& clientName);
+    void onClientDisconnect(int clntSock, Net::Message& clientName,
+        unsigned long long numMessages);
+    void onShowMessage(int clntSock, Net::Message& message);
+    void onCheckUserName(int clntSock, Net::Message& newUsername);
+    void onJoinRoom(int clntSock, Net::Message& request);
+    void onLeaveRoom(int clntSock, Net::Message& request);
+    void onRoomMessage(int clntSock, Net::Message& message);
+    void onStats(int clntSock);
+    std::vector<int> clientSockets(int except);
+    int lockLog();
+    void unlockLog(int logged);
+    void replayHistory(int clntSock, const char* room, int roomLen);
+    /**
+     * name and counters of each client that has joined the chat room. every
+     *   name owns its buffer, so it outlives the message it arrived in.
+     */
+    ClientTable clients;
+    /**
+     * names of the clients in clients; every client's name is unique.
+     */
+    NameRegistry names;
+    /**
+     * chat rooms that clients have joined, besides the one that every client
+     *   is in, and the clients in each of them.
+     */
+    RoomIndex rooms;
+    /**
+     * guards clients, names and rooms; callbacks run concurrently on every
+     *   reactor thread.
+     */
+    pthread_mutex_t clientsLock;
+    /**
+     * log of the chat messages, and the latest ones of every room, to replay
+     *   to clients that join; only used if logging is non-zero.
+     */
+    MessageLog log;
+    std::atomic<int> logging;
+    /**
+     * guards log, and logging being turned off; taken only while the log is
+     *   open, before clientsLock, and held from when a message's recipients
+     *   are found to when it is logged, and from when a client joins a room
+     *   to when the room's history is replayed to it, so every message
+     *   reaches a joining client once, replayed or as it is said.
+     */
+    pthread_mutex_t logLock;
+    /**
+     * latest report sent in answer to STATS, and when it was made, in
+     *   milliseconds; guarded by statsLock.
+     */
+    std::string statsReport;
+    unsigned long long statsTime;
+    pthread_mutex_t statsLock;
 };
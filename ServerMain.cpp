@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "Server.h"
+#include "buffer_pool.h"
+
+/**
+ * time between writes of the server's metrics, in milliseconds.
+ */
+#define STATS_INTERVAL 5000
+
+int main(int argc, char** argv)
+{
+    // pass -u to run the server on the io_uring backend, -w to handle
+    // messages on a pool of that many worker threads, and -k to send
+    // broadcasts together, held back for up to that many microseconds; -l
+    // logs the chat to a directory, and replays it to clients that join; -i
+    // pings clients that are quiet for that many milliseconds, and
+    // disconnects them after three times as long; -x also listens on a unix
+    // domain socket at that path, for clients on the same host; -h takes
+    // over from a server waiting for a successor at that path, if there is
+    // one, then waits there for its own successor; -s writes the server's
+    // metrics to that file every STATS_INTERVAL milliseconds
+    int backend = EPOLL_BACKEND;
+    int numWorkers = INLINE_HANDLERS;
+    int coalesceWindow = NO_COALESCING;
+    const char* logDir = 0;
+    int idleTimeout = NO_IDLE_TIMEOUT;
+    const char* localPath = 0;
+    const char* handOffPath = 0;
+    const char* statsPath = 0;
+    int opt;
+    while((opt = getopt(argc,argv,"uw:k:l:i:x:h:s:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'u': backend = URING_BACKEND; break;
+        case 'w': numWorkers = atoi(optarg); break;
+        case 'k': coalesceWindow = atoi(optarg); break;
+        case 'l': logDir = optarg; break;
+        case 'i': idleTimeout = atoi(optarg); break;
+        case 'x': localPath = optarg; break;
+        case 'h': handOffPath = optarg; break;
+        case 's': statsPath = optarg; break;
+        default:
+            fprintf(stderr,"usage: %s [-u] [-w workers] [-k us] [-l dir] "
+                "[-i ms] [-x path] [-h path] [-s file]\n",argv[0]);
+            return 1;
+        }
+    }
+    Server* svr = new Server(backend,numWorkers);
+    svr->setCoalescing(coalesceWindow);
+    svr->setIdleTimeout(idleTimeout,idleTimeout*3);
+
+    // take over before opening the log, which the other server seals once
+    // it has handed everything off
+    if(handOffPath != 0)
+    {
+        svr->setHandOffPath(handOffPath);
+        if(svr->takeOver(handOffPath) == SUCCESS)
+        {
+            printf("server taken over\n");
+        }
+    }
+    if(logDir != 0 && svr->openLog(logDir) != SUCCESS)
+    {
+        perror("failed to open the chat log");
+        return 1;
+    }
+
+    if(svr->startListeningRoutine(7000,localPath) != SUCCESS)
+    {
+        fprintf(stderr,"failed to start listening\n");
+        return 1;
+    }
+    printf("server started\n");
+    if(statsPath != 0)
+    {
+        svr->setStatsDump(statsPath,STATS_INTERVAL);
+    }
+
+    // run until enter is pressed, or a successor has taken over
+    struct pollfd input;
+    input.fd = STDIN_FILENO;
+    input.events = POLLIN;
+    while(!svr->handedOff() && poll(&input,1,100) == 0);
+    if(svr->handedOff())
+    {
+        printf("server handed off\n");
+    }
+    svr->stopListeningRoutine();
+
+    Net::ReceiveStats stats;
+    svr->getReceiveStats(&stats);
+    printf("received %llu frames, %llu bytes in %llu reads\n",
+        stats.frames,stats.bytes,stats.reads);
+    printf("handled %llu commands in %llu wakeups\n",
+        stats.commands,stats.wakeups);
+
+    Histogram service;
+    histogram_init(&service);
+    svr->getServiceLatency(&service);
+    printf("sockets waited p50 %llu ns, p99 %llu ns, max %llu ns to be "
+        "served; %llu carried over\n",histogram_percentile(&service,50.0),
+        histogram_percentile(&service,99.0),service.max.load(),
+        stats.carryOvers);
+
+    PoolStats poolStats;
+    pool_get_stats(&poolStats);
+    printf("buffer pool: %llu allocations, %llu mallocs, %llu frees\n",
+        poolStats.allocs,poolStats.mallocs,poolStats.frees);
+
+    delete svr;
+    printf("server stopped\n");
+
+    return 0;
+}
@@ -26,9 +26,8 @@ private:
 
 int main(void)
 {
-    msg.type = 0;
-    msg.data = (void*) "hey there i am eric";
-    msg.len  = strlen((char*)msg.data);
+    const char* text = "hey there i am eric";
+    msg = Net::Message(0,text,strlen(text));
 
     TestHost* svr = new TestHost();
 
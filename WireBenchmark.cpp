@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wire_header.h"
+#include "frame_decoder.h"
+#include "lz_block.h"
+
+#define DEFAULT_HEADERS 1000000
+#define DEFAULT_ROUNDS 5
+
+/**
+ * number of bytes handed to the frame decoder at a time, like one read.
+ */
+#define FEED_LEN 16384
+
+/**
+ * size of each payload compressed, like a large paste, and of the text that
+ *   they are cut from.
+ */
+#define PASTE_LEN 4096
+#define TEXT_LEN (4*1024*1024)
+
+/**
+ * returns the current time in nanoseconds.
+ */
+static unsigned long long now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec*1000000000ULL+now.tv_nsec;
+}
+
+/**
+ * returns the next number of a fixed pseudo-random sequence, so every run
+ *   measures the same lengths.
+ */
+static unsigned int next_random(unsigned int* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/**
+ * fills in payload lengths shaped like chat traffic: mostly short lines, some
+ *   longer messages, and the odd large one.
+ */
+static void make_lengths(int* lens, int count)
+{
+    unsigned int state = 2463534242u;
+    for(int i = 0; i < count; ++i)
+    {
+        unsigned int pick = next_random(&state)%100;
+        unsigned int value = next_random(&state);
+        if(pick < 70)
+        {
+            lens[i] = 1+value%100;
+        }
+        else if(pick < 95)
+        {
+            lens[i] = 100+value%1900;
+        }
+        else
+        {
+            lens[i] = 2000+value%18000;
+        }
+    }
+}
+
+/**
+ * times encoding and decoding the headers of every length, back to back.
+ */
+static void bench_headers(int version, const int* lens, int count, int rounds)
+{
+    char* headers = (char*) malloc((size_t) count*WIRE_MAX_HEADER_LEN);
+    unsigned long long bestEncode = ~0ULL;
+    unsigned long long bestDecode = ~0ULL;
+    long totalLen = 0;
+    unsigned long long checksum = 0;
+
+    for(int round = 0; round < rounds; ++round)
+    {
+        unsigned long long start = now_ns();
+        char* out = headers;
+        for(int i = 0; i < count; ++i)
+        {
+            out += wire_encode_header(out,version,i&WIRE_MAX_TYPE,0,lens[i]);
+        }
+        unsigned long long encoded = now_ns();
+        totalLen = out-headers;
+
+        const char* in = headers;
+        int type;
+        int flags;
+        int len;
+        for(int i = 0; i < count; ++i)
+        {
+            in += wire_decode_header(in,headers+totalLen-in,version,&type,
+                &flags,&len);
+            checksum += len;
+        }
+        unsigned long long decoded = now_ns();
+
+        if(encoded-start < bestEncode)
+        {
+            bestEncode = encoded-start;
+        }
+        if(decoded-encoded < bestDecode)
+        {
+            bestDecode = decoded-encoded;
+        }
+    }
+
+    printf("v%d header: %5.2f bytes, encode %6.2f ns, decode %6.2f ns "
+        "(checksum %llu)\n",version,(double) totalLen/count,
+        (double) bestEncode/count,(double) bestDecode/count,checksum);
+    free(headers);
+}
+
+/**
+ * times the frame decoder on a stream of short chat lines, fed to it a read's
+ *   worth at a time.
+ */
+static void bench_decoder(int version, const int* lens, int count, int rounds)
+{
+    // encode every frame into one stream; payloads are capped at a chat line
+    long streamLen = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        streamLen += WIRE_MAX_HEADER_LEN+lens[i]%128;
+    }
+    char* stream = (char*) malloc(streamLen);
+    char* out = stream;
+    for(int i = 0; i < count; ++i)
+    {
+        int len = lens[i]%128;
+        out += wire_encode_header(out,version,i&WIRE_MAX_TYPE,0,len);
+        memset(out,'x',len);
+        out += len;
+    }
+    streamLen = out-stream;
+
+    unsigned long long best = ~0ULL;
+    for(int round = 0; round < rounds; ++round)
+    {
+        FrameDecoder decoder;
+        decoder_init(&decoder);
+        decoder.version = version;
+
+        int numFrames = 0;
+        unsigned long long start = now_ns();
+        for(long fed = 0; fed < streamLen;)
+        {
+            int chunk = (streamLen-fed < FEED_LEN) ? streamLen-fed : FEED_LEN;
+            int copied = decoder_feed(&decoder,stream+fed,chunk);
+            fed += copied;
+
+            int result;
+            while((result = decoder_next(&decoder)) == DECODE_COMPLETE)
+            {
+                decoder_release(&decoder);
+                ++numFrames;
+            }
+            if(result == DECODE_CLOSED)
+            {
+                fprintf(stderr,"v%d stream failed to decode\n",version);
+                exit(1);
+            }
+        }
+        unsigned long long elapsed = now_ns()-start;
+        decoder_destroy(&decoder);
+
+        if(numFrames != count)
+        {
+            fprintf(stderr,"v%d decoded %d of %d frames\n",version,numFrames,
+                count);
+            exit(1);
+        }
+        if(elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    printf("v%d decoder: %ld bytes, %6.2f ns/frame, %8.1f MB/s\n",version,
+        streamLen,(double) best/count,streamLen*1000.0/best);
+    free(stream);
+}
+
+/**
+ * fills in text of words picked at random, which compresses about as well as
+ *   a paste of chat.
+ */
+static void make_text(char* text, int len)
+{
+    static const char* words[] =
+    {
+        "the","server","message","is","a","of","to","and","chat","room",
+        "client","sent","we","it","that","for","on","with","queue","socket",
+        "latency","was","this","not","be","are","from","or","have","buffer"
+    };
+    unsigned int state = 88172645u;
+    int pos = 0;
+    while(pos < len)
+    {
+        const char* word =
+            words[next_random(&state)%(sizeof(words)/sizeof(words[0]))];
+        while(*word != 0 && pos < len)
+        {
+            text[pos++] = *word++;
+        }
+        if(pos < len)
+        {
+            text[pos++] = ' ';
+        }
+    }
+}
+
+/**
+ * times compressing the text a paste at a time, and expanding it again.
+ */
+static void bench_compress(int rounds)
+{
+    char* text = (char*) malloc(TEXT_LEN);
+    char* packed = (char*) malloc(TEXT_LEN);
+    char* unpacked = (char*) malloc(PASTE_LEN);
+    int numPastes = TEXT_LEN/PASTE_LEN;
+    int* packedLens = (int*) malloc(numPastes*sizeof(int));
+    make_text(text,TEXT_LEN);
+
+    unsigned long long bestCompress = ~0ULL;
+    unsigned long long bestDecompress = ~0ULL;
+    long totalPacked = 0;
+    for(int round = 0; round < rounds; ++round)
+    {
+        unsigned long long start = now_ns();
+        totalPacked = 0;
+        for(int i = 0; i < numPastes; ++i)
+        {
+            packedLens[i] = lz_compress(text+i*PASTE_LEN,PASTE_LEN,
+                packed+i*PASTE_LEN,PASTE_LEN);
+            totalPacked += packedLens[i];
+        }
+        unsigned long long compressed = now_ns();
+
+        for(int i = 0; i < numPastes; ++i)
+        {
+            if(lz_decompress(packed+i*PASTE_LEN,packedLens[i],unpacked,
+                PASTE_LEN) != PASTE_LEN ||
+                memcmp(unpacked,text+i*PASTE_LEN,PASTE_LEN) != 0)
+            {
+                fprintf(stderr,"paste %d failed to round-trip\n",i);
+                exit(1);
+            }
+        }
+        unsigned long long decompressed = now_ns();
+
+        if(compressed-start < bestCompress)
+        {
+            bestCompress = compressed-start;
+        }
+        if(decompressed-compressed < bestDecompress)
+        {
+            bestDecompress = decompressed-compressed;
+        }
+    }
+
+    printf("lz %d byte pastes: %5.1f%% of the size, compress %7.1f MB/s, "
+        "decompress %7.1f MB/s\n",PASTE_LEN,totalPacked*100.0/TEXT_LEN,
+        TEXT_LEN*1000.0/bestCompress,TEXT_LEN*1000.0/bestDecompress);
+    free(packedLens);
+    free(unpacked);
+    free(packed);
+    free(text);
+}
+
+int main(int argc, char** argv)
+{
+    int count = DEFAULT_HEADERS;
+    int rounds = DEFAULT_ROUNDS;
+
+    int opt;
+    while((opt = getopt(argc,argv,"n:r:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n': count = atoi(optarg); break;
+        case 'r': rounds = atoi(optarg); break;
+        default:
+            fprintf(stderr,"usage: %s [-n headers] [-r rounds]\n",argv[0]);
+            return 1;
+        }
+    }
+    if(count < 1 || rounds < 1)
+    {
+        fprintf(stderr,"usage: %s [-n headers] [-r rounds]\n",argv[0]);
+        return 1;
+    }
+
+    int* lens = (int*) malloc(count*sizeof(int));
+    make_lengths(lens,count);
+
+    printf("%d frames, best of %d rounds\n",count,rounds);
+    for(int version = WIRE_V0; version <= WIRE_MAX_VERSION; ++version)
+    {
+        bench_headers(version,lens,count,rounds);
+    }
+    for(int version = WIRE_V0; version <= WIRE_MAX_VERSION; ++version)
+    {
+        bench_decoder(version,lens,count,rounds);
+    }
+    bench_compress(rounds);
+
+    free(lens);
+    return 0;
+}
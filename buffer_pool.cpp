@@ -0,0 +1,261 @@
+#include "buffer_pool.h"
+
+#include <atomic>
+#include <stdlib.h>
+#include <pthread.h>
+
+/**
+ * size of the blocks in the smallest size class. each following class holds
+ *   blocks twice as large as the one before it.
+ */
+#define MIN_CLASS_SIZE 64
+
+/**
+ * number of size classes; blocks of up to 1 MiB are pooled.
+ */
+#define NUM_CLASSES 15
+
+/**
+ * number of free blocks of each class that a thread keeps to itself. half of
+ *   them move between the thread and the shared depot at a time.
+ */
+#define CACHE_SIZE 64
+
+/**
+ * number of bytes of free blocks of each class that the shared depot keeps,
+ *   before it starts freeing them back to the system.
+ */
+#define DEPOT_BYTES (4*1024*1024)
+
+/**
+ * free block; the link is stored in the block's own memory.
+ */
+typedef struct FreeBlock
+{
+    struct FreeBlock* next;
+} FreeBlock;
+
+/**
+ * free blocks of one size class that are shared by all threads.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    FreeBlock* head;
+    int count;
+} Depot;
+
+/**
+ * free blocks of each size class that are cached by the calling thread. the
+ *   blocks go back to the depot when the thread exits.
+ */
+struct ThreadCache
+{
+    FreeBlock* heads[NUM_CLASSES];
+    int counts[NUM_CLASSES];
+
+    ThreadCache();
+    ~ThreadCache();
+};
+
+static Depot depots[NUM_CLASSES] = {};
+static pthread_once_t depotsOnce = PTHREAD_ONCE_INIT;
+static thread_local ThreadCache cache;
+static std::atomic<unsigned long long> numMallocs(0);
+static std::atomic<unsigned long long> numFrees(0);
+static std::atomic<unsigned long long> numAllocs(0);
+
+static void init_depots();
+static int class_size(int sizeClass);
+static void depot_put(int sizeClass, FreeBlock* head, FreeBlock* tail, int count);
+static int depot_take(int sizeClass, int count);
+
+/**
+ * allocates a block of memory from the pool. blocks are rounded up to a
+ *   power-of-two size class, and reused once freed, so steady traffic never
+ *   reaches the system allocator.
+ *
+ * @param size minimum number of bytes in the block.
+ * @param sizeClass set to the block's size class, which must be passed back to
+ *   pool_free.
+ *
+ * @return the allocated block; 0 if the system allocator failed.
+ */
+void* pool_alloc(int size, int* sizeClass)
+{
+    numAllocs.fetch_add(1,std::memory_order_relaxed);
+
+    // find the smallest class that fits
+    int curClass = 0;
+    while(curClass < NUM_CLASSES && class_size(curClass) < size)
+    {
+        ++curClass;
+    }
+    if(curClass == NUM_CLASSES)
+    {
+        *sizeClass = POOL_NO_CLASS;
+        numMallocs.fetch_add(1,std::memory_order_relaxed);
+        return malloc(size);
+    }
+    *sizeClass = curClass;
+
+    // take a block from the thread's cache, refilling it from the depot
+    if(cache.heads[curClass] == 0 && depot_take(curClass,CACHE_SIZE/2) == 0)
+    {
+        numMallocs.fetch_add(1,std::memory_order_relaxed);
+        return malloc(class_size(curClass));
+    }
+    FreeBlock* block = cache.heads[curClass];
+    cache.heads[curClass] = block->next;
+    --cache.counts[curClass];
+    return block;
+}
+
+/**
+ * returns a block to the pool.
+ *
+ * @param block block returned by pool_alloc. may have been allocated on
+ *   another thread.
+ * @param sizeClass size class set by pool_alloc.
+ */
+void pool_free(void* block, int sizeClass)
+{
+    if(sizeClass == POOL_NO_CLASS)
+    {
+        numFrees.fetch_add(1,std::memory_order_relaxed);
+        free(block);
+        return;
+    }
+
+    // put the block into the thread's cache
+    FreeBlock* freeBlock = (FreeBlock*) block;
+    freeBlock->next = cache.heads[sizeClass];
+    cache.heads[sizeClass] = freeBlock;
+    ++cache.counts[sizeClass];
+
+    // move half of an overflowing cache to the depot
+    if(cache.counts[sizeClass] > CACHE_SIZE)
+    {
+        FreeBlock* head = cache.heads[sizeClass];
+        FreeBlock* tail = head;
+        for(int i = 1; i < CACHE_SIZE/2; ++i)
+        {
+            tail = tail->next;
+        }
+        cache.heads[sizeClass] = tail->next;
+        cache.counts[sizeClass] -= CACHE_SIZE/2;
+        tail->next = 0;
+        depot_put(sizeClass,head,tail,CACHE_SIZE/2);
+    }
+}
+
+/**
+ * reads the pool's counters. once traffic is steady, mallocs stops growing
+ *   while allocs keeps growing.
+ *
+ * @param stats structure to store the counters in.
+ */
+void pool_get_stats(PoolStats* stats)
+{
+    stats->mallocs = numMallocs.load(std::memory_order_relaxed);
+    stats->frees = numFrees.load(std::memory_order_relaxed);
+    stats->allocs = numAllocs.load(std::memory_order_relaxed);
+}
+
+ThreadCache::ThreadCache()
+{
+    for(int i = 0; i < NUM_CLASSES; ++i)
+    {
+        heads[i] = 0;
+        counts[i] = 0;
+    }
+}
+
+ThreadCache::~ThreadCache()
+{
+    for(int i = 0; i < NUM_CLASSES; ++i)
+    {
+        if(heads[i] != 0)
+        {
+            FreeBlock* tail = heads[i];
+            while(tail->next != 0)
+            {
+                tail = tail->next;
+            }
+            depot_put(i,heads[i],tail,counts[i]);
+            heads[i] = 0;
+            counts[i] = 0;
+        }
+    }
+}
+
+static void init_depots()
+{
+    for(int i = 0; i < NUM_CLASSES; ++i)
+    {
+        pthread_mutex_init(&depots[i].lock,0);
+        depots[i].head = 0;
+        depots[i].count = 0;
+    }
+}
+
+static int class_size(int sizeClass)
+{
+    return MIN_CLASS_SIZE<<sizeClass;
+}
+
+/**
+ * moves a list of free blocks into the depot, freeing whatever doesn't fit.
+ */
+static void depot_put(int sizeClass, FreeBlock* head, FreeBlock* tail, int count)
+{
+    pthread_once(&depotsOnce,init_depots);
+    Depot* depot = &depots[sizeClass];
+    int maxCount = DEPOT_BYTES/class_size(sizeClass);
+
+    pthread_mutex_lock(&depot->lock);
+    if(depot->count+count <= maxCount)
+    {
+        tail->next = depot->head;
+        depot->head = head;
+        depot->count += count;
+        head = 0;
+    }
+    pthread_mutex_unlock(&depot->lock);
+
+    // depot is full; give the blocks back to the system
+    while(head != 0)
+    {
+        FreeBlock* next = head->next;
+        free(head);
+        numFrees.fetch_add(1,std::memory_order_relaxed);
+        head = next;
+    }
+}
+
+/**
+ * moves up to {count} free blocks from the depot into the thread's cache.
+ *
+ * @return number of blocks moved.
+ */
+static int depot_take(int sizeClass, int count)
+{
+    pthread_once(&depotsOnce,init_depots);
+    Depot* depot = &depots[sizeClass];
+
+    pthread_mutex_lock(&depot->lock);
+    int numTaken = 0;
+    while(numTaken < count && depot->head != 0)
+    {
+        FreeBlock* block = depot->head;
+        depot->head = block->next;
+        block->next = cache.heads[sizeClass];
+        cache.heads[sizeClass] = block;
+        ++numTaken;
+    }
+    depot->count -= numTaken;
+    pthread_mutex_unlock(&depot->lock);
+
+    cache.counts[sizeClass] += numTaken;
+    return numTaken;
+}
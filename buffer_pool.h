@@ -0,0 +1,21 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+/**
+ * size class of blocks that are too large for the pool; they are allocated
+ *   from, and freed back to the system.
+ */
+#define POOL_NO_CLASS -1
+
+typedef struct
+{
+    unsigned long long mallocs; // blocks allocated from the system
+    unsigned long long frees;   // blocks freed back to the system
+    unsigned long long allocs;  // blocks handed out by pool_alloc
+} PoolStats;
+
+void* pool_alloc(int size, int* sizeClass);
+void pool_free(void* block, int sizeClass);
+void pool_get_stats(PoolStats* stats);
+
+#endif
@@ -0,0 +1,176 @@
+#include "client_table.h"
+
+#include <string.h>
+
+/**
+ * number of clients that a new table has room for.
+ */
+#define INITIAL_CAPACITY 16
+
+/**
+ * initializes an empty table.
+ *
+ * @param table table to initialize.
+ */
+void clients_init(ClientTable* table)
+{
+    table->index = 0;
+    table->indexLen = 0;
+    table->sockets = new int[INITIAL_CAPACITY];
+    table->names = new int[INITIAL_CAPACITY];
+    table->messages = new unsigned long long[INITIAL_CAPACITY];
+    table->bytes = new unsigned long long[INITIAL_CAPACITY];
+    table->count = 0;
+    table->capacity = INITIAL_CAPACITY;
+}
+
+/**
+ * frees the table.
+ *
+ * @param table table to destroy.
+ */
+void clients_destroy(ClientTable* table)
+{
+    delete[] table->index;
+    delete[] table->sockets;
+    delete[] table->names;
+    delete[] table->messages;
+    delete[] table->bytes;
+    table->index = 0;
+    table->indexLen = 0;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+/**
+ * makes room in the arrays for one more client.
+ */
+static void grow_clients(ClientTable* table)
+{
+    int capacity = table->capacity*2;
+    int* sockets = new int[capacity];
+    int* names = new int[capacity];
+    unsigned long long* messages = new unsigned long long[capacity];
+    unsigned long long* bytes = new unsigned long long[capacity];
+
+    memcpy(sockets,table->sockets,table->count*sizeof(int));
+    memcpy(names,table->names,table->count*sizeof(int));
+    memcpy(messages,table->messages,table->count*sizeof(*messages));
+    memcpy(bytes,table->bytes,table->count*sizeof(*bytes));
+
+    delete[] table->sockets;
+    delete[] table->names;
+    delete[] table->messages;
+    delete[] table->bytes;
+    table->sockets = sockets;
+    table->names = names;
+    table->messages = messages;
+    table->bytes = bytes;
+    table->capacity = capacity;
+}
+
+/**
+ * makes the index cover the socket.
+ */
+static void grow_index(ClientTable* table, int socket)
+{
+    int indexLen = (table->indexLen*2 > socket) ? table->indexLen*2 : socket+1;
+    int* index = new int[indexLen];
+    if(table->indexLen > 0)
+    {
+        memcpy(index,table->index,table->indexLen*sizeof(int));
+    }
+    for(int i = table->indexLen; i < indexLen; ++i)
+    {
+        index[i] = NO_CLIENT;
+    }
+    delete[] table->index;
+    table->index = index;
+    table->indexLen = indexLen;
+}
+
+/**
+ * adds a client to the table, or renames it if its socket is in the table
+ *   already.
+ *
+ * @param table table to add to.
+ * @param socket socket of the client.
+ * @param name id of the client's name.
+ *
+ * @return position of the client in the arrays.
+ */
+int clients_add(ClientTable* table, int socket, int name)
+{
+    if(socket >= table->indexLen)
+    {
+        grow_index(table,socket);
+    }
+
+    int pos = table->index[socket];
+    if(pos == NO_CLIENT)
+    {
+        if(table->count == table->capacity)
+        {
+            grow_clients(table);
+        }
+        pos = table->count++;
+        table->index[socket] = pos;
+        table->sockets[pos] = socket;
+        table->messages[pos] = 0;
+        table->bytes[pos] = 0;
+    }
+    table->names[pos] = name;
+    return pos;
+}
+
+/**
+ * removes a client from the table; the last client takes its place.
+ *
+ * @param table table to remove from.
+ * @param socket socket of the client.
+ * @param name set to the id of the client's name, if not 0.
+ *
+ * @return 0 if the client was removed; -1 if it wasn't in the table.
+ */
+int clients_remove(ClientTable* table, int socket, int* name)
+{
+    int pos = clients_find(table,socket);
+    if(pos == NO_CLIENT)
+    {
+        return -1;
+    }
+
+    if(name != 0)
+    {
+        *name = table->names[pos];
+    }
+    int last = --table->count;
+    if(pos != last)
+    {
+        table->sockets[pos] = table->sockets[last];
+        table->names[pos] = table->names[last];
+        table->messages[pos] = table->messages[last];
+        table->bytes[pos] = table->bytes[last];
+        table->index[table->sockets[pos]] = pos;
+    }
+    table->index[socket] = NO_CLIENT;
+    return 0;
+}
+
+/**
+ * finds a client in the table.
+ *
+ * @param table table to search.
+ * @param socket socket of the client.
+ *
+ * @return position of the client in the arrays; NO_CLIENT if it isn't in the
+ *   table.
+ */
+int clients_find(ClientTable* table, int socket)
+{
+    if(socket < 0 || socket >= table->indexLen)
+    {
+        return NO_CLIENT;
+    }
+    return table->index[socket];
+}
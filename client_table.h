@@ -0,0 +1,38 @@
+#ifndef _CLIENT_TABLE_H_
+#define _CLIENT_TABLE_H_
+
+/**
+ * returned by clients_find for a socket that isn't in the table, and the
+ *   index of such a socket.
+ */
+#define NO_CLIENT -1
+
+/**
+ * the clients in a chat room, indexed by socket.
+ *
+ * every field of a client is kept in an array of its own, packed at the front
+ *   of the arrays in no particular order, so a scan of every client's socket
+ *   touches nothing else. a client is found by its socket through index, and
+ *   removed by moving the last client into its place.
+ */
+typedef struct
+{
+    int* index;                     // position of each socket's client, or
+                                    // NO_CLIENT; indexed by socket
+    int indexLen;                   // number of sockets that index covers
+    int* sockets;                   // socket of each client
+    int* names;                     // id of each client's name in the
+                                    // server's NameRegistry
+    unsigned long long* messages;   // chat messages each client has sent
+    unsigned long long* bytes;      // bytes of chat each client has sent
+    int count;                      // number of clients
+    int capacity;                   // number of clients that the arrays fit
+} ClientTable;
+
+void clients_init(ClientTable* table);
+void clients_destroy(ClientTable* table);
+int clients_add(ClientTable* table, int socket, int name);
+int clients_remove(ClientTable* table, int socket, int* name);
+int clients_find(ClientTable* table, int socket);
+
+#endif
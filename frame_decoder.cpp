@@ -0,0 +1,314 @@
+#include "frame_decoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * initializes the decoder to wait for the header of a new frame.
+ *
+ * @param decoder decoder to initialize.
+ */
+void decoder_init(FrameDecoder* decoder)
+{
+    ring_init(&decoder->ring,RECEIVE_BUFFER_SIZE);
+    decoder->state = DECODE_HEADER;
+    decoder->payload = 0;
+    decoder->bytesDone = 0;
+    decoder->viewLen = 0;
+    decoder->version = WIRE_V0;
+    decoder->flags = 0;
+    decoder->msg = Net::Message();
+}
+
+/**
+ * frees the decoder's receive buffer, and any partially received frame.
+ *
+ * @param decoder decoder to destroy.
+ */
+void decoder_destroy(FrameDecoder* decoder)
+{
+    if(decoder->payload != 0)
+    {
+        frame_release(decoder->payload);
+        decoder->payload = 0;
+    }
+    decoder->msg = Net::Message();
+    ring_destroy(&decoder->ring);
+}
+
+/**
+ * does a single read from a non-blocking socket into the decoder's receive
+ *   buffer. a payload that is too large for the buffer is read straight into
+ *   its own buffer within the same read.
+ *
+ * @param decoder decoder to read data into.
+ * @param socket non-blocking socket to read from.
+ *
+ * @return number of bytes read. 0 when the socket is closed, and -1 on error;
+ *   check errno for details.
+ */
+int decoder_fill(FrameDecoder* decoder, int socket)
+{
+    char* prefix = 0;
+    int prefixLen = 0;
+    if(decoder->payload != 0)
+    {
+        prefix = decoder->payload->data+FRAME_HEADER_LEN+decoder->bytesDone;
+        prefixLen = decoder->msg.len-decoder->bytesDone;
+    }
+
+    int bytesRead = ring_fill(&decoder->ring,socket,prefix,prefixLen);
+    if(bytesRead > 0)
+    {
+        decoder->bytesDone += (bytesRead < prefixLen) ? bytesRead : prefixLen;
+    }
+    return bytesRead;
+}
+
+/**
+ * copies bytes that were received into memory of their own, like a provided
+ *   buffer of an io_uring receive, into the decoder. the rest of a payload
+ *   that is too large for the receive buffer is filled in first.
+ *
+ * @param decoder decoder to copy data into.
+ * @param data received bytes.
+ * @param len number of received bytes.
+ *
+ * @return number of bytes copied; less than {len} once the receive buffer is
+ *   full, in which case the frames in it have to be decoded before feeding
+ *   the rest.
+ */
+int decoder_feed(FrameDecoder* decoder, const char* data, int len)
+{
+    int copied = 0;
+    if(decoder->payload != 0)
+    {
+        copied = decoder->msg.len-decoder->bytesDone;
+        if(copied > len)
+        {
+            copied = len;
+        }
+        memcpy(decoder->payload->data+FRAME_HEADER_LEN+decoder->bytesDone,
+            data,copied);
+        decoder->bytesDone += copied;
+    }
+
+    copied += ring_write(&decoder->ring,data+copied,len-copied);
+    return copied;
+}
+
+/**
+ * returns the number of bytes that the next decoder_fill may read; a fill that
+ *   reads fewer than this has emptied the socket.
+ *
+ * @param decoder decoder to fill.
+ */
+int decoder_space(FrameDecoder* decoder)
+{
+    int space = ring_space(&decoder->ring);
+    if(decoder->payload != 0)
+    {
+        space += decoder->msg.len-decoder->bytesDone;
+    }
+    return space;
+}
+
+/**
+ * decodes the next whole frame out of the data received so far. the message
+ *   is a view into the receive buffer whenever the payload is contiguous
+ *   there, so most frames are never copied; otherwise it owns a pooled buffer
+ *   holding the whole frame. compressed payloads are expanded into a pooled
+ *   buffer.
+ *
+ * once DECODE_COMPLETE is returned, decoder_release must be called before the
+ *   decoder is used again.
+ *
+ * @param decoder decoder holding the received data.
+ *
+ * @return DECODE_COMPLETE when decoder->msg holds a whole frame,
+ *   DECODE_PENDING when more data needs to be received first, and
+ *   DECODE_CLOSED when the frame is invalid, longer than FRAME_MAX_LEN, or
+ *   its buffer couldn't be allocated.
+ */
+int decoder_next(FrameDecoder* decoder)
+{
+    RingBuffer* ring = &decoder->ring;
+
+    if(decoder->state == DECODE_HEADER)
+    {
+        // parse the header once all of it is received; straight out of the
+        // ring, unless it wraps
+        char copy[WIRE_MAX_HEADER_LEN];
+        int avail = ring_size(ring);
+        if(avail > WIRE_MAX_HEADER_LEN)
+        {
+            avail = WIRE_MAX_HEADER_LEN;
+        }
+        char* header = ring_contiguous(ring,avail);
+        if(header == 0)
+        {
+            ring_peek(ring,copy,avail);
+            header = copy;
+        }
+        int headerLen = wire_decode_header(header,avail,decoder->version,
+            &decoder->msg.type,&decoder->flags,&decoder->msg.len);
+        if(headerLen == 0)
+        {
+            return DECODE_PENDING;
+        }
+        if(headerLen == -1 || (decoder->flags&~WIRE_KNOWN_FLAGS) != 0 ||
+            decoder->msg.len < 0 || decoder->msg.len > FRAME_MAX_LEN)
+        {
+            return DECODE_CLOSED;
+        }
+        ring_consume(ring,headerLen);
+        decoder->state = DECODE_PAYLOAD;
+
+        // payloads that can never fit the ring get a buffer of their own, and
+        // take whatever part of them has been received already
+        if(decoder->msg.len > (int) ring->capacity)
+        {
+            decoder->payload = frame_alloc(FRAME_HEADER_LEN+decoder->msg.len);
+            if(decoder->payload == 0)
+            {
+                return DECODE_CLOSED;
+            }
+            frame_write_header(decoder->payload,decoder->msg.type,
+                decoder->msg.len);
+            decoder->bytesDone = ring_size(ring);
+            ring_peek(ring,decoder->payload->data+FRAME_HEADER_LEN,
+                decoder->bytesDone);
+            ring_consume(ring,decoder->bytesDone);
+        }
+    }
+
+    if(decoder->payload != 0)
+    {
+        // payload is read into its own buffer; hand it over once complete
+        if(decoder->bytesDone < decoder->msg.len)
+        {
+            return DECODE_PENDING;
+        }
+        decoder->msg.buffer = decoder->payload;
+        decoder->msg.data = decoder->payload->data+FRAME_HEADER_LEN;
+        decoder->payload = 0;
+    }
+    else
+    {
+        // payload is in the ring; point into it, or copy the frame into a
+        // pooled buffer if it wraps
+        if((int) ring_size(ring) < decoder->msg.len)
+        {
+            return DECODE_PENDING;
+        }
+        char* contiguous = ring_contiguous(ring,decoder->msg.len);
+        if(contiguous != 0)
+        {
+            decoder->msg.data = contiguous;
+            decoder->msg.buffer = 0;
+            decoder->viewLen = decoder->msg.len;
+        }
+        else
+        {
+            decoder->msg.buffer = frame_alloc(FRAME_HEADER_LEN+decoder->msg.len);
+            if(decoder->msg.buffer == 0)
+            {
+                return DECODE_CLOSED;
+            }
+            frame_write_header(decoder->msg.buffer,decoder->msg.type,
+                decoder->msg.len);
+            decoder->msg.data = decoder->msg.buffer->data+FRAME_HEADER_LEN;
+            ring_peek(ring,decoder->msg.data,decoder->msg.len);
+            ring_consume(ring,decoder->msg.len);
+        }
+    }
+
+    // hand out compressed payloads expanded, in a pooled buffer of their own
+    if(decoder->flags&WIRE_COMPRESSED)
+    {
+        int type = decoder->msg.type;
+        SharedFrame* unpacked = frame_decompress(type,decoder->msg.data,
+            decoder->msg.len);
+        if(unpacked == 0)
+        {
+            return DECODE_CLOSED;
+        }
+        decoder->msg = Net::Message();
+        decoder->msg.type = type;
+        decoder->msg.len = unpacked->len-FRAME_HEADER_LEN;
+        decoder->msg.data = unpacked->data+FRAME_HEADER_LEN;
+        decoder->msg.buffer = unpacked;
+    }
+
+    return DECODE_COMPLETE;
+}
+
+/**
+ * releases the payload of the decoded frame, and gets the decoder ready for
+ *   the next frame. a pooled payload stays alive for as long as a handler
+ *   holds a copy of the message.
+ *
+ * @param decoder decoder to reset.
+ */
+void decoder_release(FrameDecoder* decoder)
+{
+    // the handler may have made the view an owner, so go by what was handed
+    // out rather than by what the message is now
+    ring_consume(&decoder->ring,decoder->viewLen);
+    decoder->msg = Net::Message();
+    decoder->state = DECODE_HEADER;
+    decoder->bytesDone = 0;
+    decoder->viewLen = 0;
+}
+
+/**
+ * returns the number of bytes that decoder_unread copies out of the decoder.
+ *
+ * @param decoder decoder to check.
+ */
+int decoder_unread_len(FrameDecoder* decoder)
+{
+    int len = ring_size(&decoder->ring);
+    if(decoder->state == DECODE_PAYLOAD)
+    {
+        char header[WIRE_MAX_HEADER_LEN];
+        len += wire_encode_header(header,decoder->version,decoder->msg.type,
+            decoder->flags,decoder->msg.len);
+        if(decoder->payload != 0)
+        {
+            len += decoder->bytesDone;
+        }
+    }
+    return len;
+}
+
+/**
+ * copies out the bytes that were received but not decoded yet, as they were
+ *   received: the header of a partially received frame is encoded again, so
+ *   feeding the copy to a new decoder of the same version picks up where this
+ *   one left off. must not be called between decoder_next returning
+ *   DECODE_COMPLETE and decoder_release.
+ *
+ * @param decoder decoder to copy out of.
+ * @param buffer set to the bytes; must hold decoder_unread_len of them.
+ */
+void decoder_unread(FrameDecoder* decoder, char* buffer)
+{
+    if(decoder->state == DECODE_PAYLOAD)
+    {
+        // the header is encoded aside, since wire_encode_header may write
+        // past the end of a short header
+        char header[WIRE_MAX_HEADER_LEN];
+        int headerLen = wire_encode_header(header,decoder->version,
+            decoder->msg.type,decoder->flags,decoder->msg.len);
+        memcpy(buffer,header,headerLen);
+        buffer += headerLen;
+        if(decoder->payload != 0)
+        {
+            memcpy(buffer,decoder->payload->data+FRAME_HEADER_LEN,
+                decoder->bytesDone);
+            buffer += decoder->bytesDone;
+        }
+    }
+    ring_peek(&decoder->ring,buffer,ring_size(&decoder->ring));
+}
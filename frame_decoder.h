@@ -0,0 +1,65 @@
+#ifndef _FRAME_DECODER_H_
+#define _FRAME_DECODER_H_
+
+#include "Message.h"
+#include "ring_buffer.h"
+#include "shared_frame.h"
+#include "wire_header.h"
+
+/**
+ * size of each socket's receive buffer. frames with larger payloads are read
+ *   into a pooled buffer of their own.
+ */
+#define RECEIVE_BUFFER_SIZE 16384
+
+/**
+ * the decoder is waiting for the rest of a frame's type and length fields.
+ */
+#define DECODE_HEADER 0
+
+/**
+ * the decoder has the frame's header, and is waiting for the rest of its
+ *   payload.
+ */
+#define DECODE_PAYLOAD 1
+
+/**
+ * returned by decoder_next when a whole frame has been decoded into the
+ *   decoder's msg.
+ */
+#define DECODE_COMPLETE 1
+
+/**
+ * returned by decoder_next when the buffered data doesn't hold another whole
+ *   frame; decoding resumes from where it left off after the next fill.
+ */
+#define DECODE_PENDING 0
+
+/**
+ * returned by decoder_next when the frame is invalid.
+ */
+#define DECODE_CLOSED -1
+
+typedef struct
+{
+    int state;              // DECODE_HEADER or DECODE_PAYLOAD
+    RingBuffer ring;        // bytes received from the socket, not yet decoded
+    SharedFrame* payload;   // pooled buffer of a payload too large for the ring
+    int bytesDone;          // bytes of {payload} that have been received
+    int viewLen;            // bytes of the ring that a decoded view points to
+    int version;            // framing that the peer sends, like WIRE_V1
+    int flags;              // flags of the frame being decoded
+    Net::Message msg;       // frame being decoded
+} FrameDecoder;
+
+void decoder_init(FrameDecoder* decoder);
+void decoder_destroy(FrameDecoder* decoder);
+int decoder_fill(FrameDecoder* decoder, int socket);
+int decoder_feed(FrameDecoder* decoder, const char* data, int len);
+int decoder_space(FrameDecoder* decoder);
+int decoder_next(FrameDecoder* decoder);
+void decoder_release(FrameDecoder* decoder);
+int decoder_unread_len(FrameDecoder* decoder);
+void decoder_unread(FrameDecoder* decoder, char* buffer);
+
+#endif
@@ -0,0 +1,184 @@
+#include "histogram.h"
+
+/**
+ * values below this are counted in a bucket of their own.
+ */
+#define EXACT_VALUES (2*HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * width of the widest bar printed by histogram_print.
+ */
+#define BAR_WIDTH 40
+
+/**
+ * returns the index of the bucket that counts the value.
+ */
+static int bucket_index(unsigned long long value)
+{
+    if(value < EXACT_VALUES)
+    {
+        return (int) value;
+    }
+
+    // keep the 5 most significant bits; the top one is always set
+    int exponent = 63-__builtin_clzll(value);
+    int mantissa = (int) (value >> (exponent-4));
+    return (exponent-3)*HISTOGRAM_SUB_BUCKETS+mantissa-HISTOGRAM_SUB_BUCKETS;
+}
+
+/**
+ * returns the largest value that is counted in the bucket.
+ */
+static unsigned long long bucket_upper(int index)
+{
+    if(index < EXACT_VALUES)
+    {
+        return index;
+    }
+
+    int shift = index/HISTOGRAM_SUB_BUCKETS-1;
+    unsigned long long mantissa =
+        index%HISTOGRAM_SUB_BUCKETS+HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa+1) << shift)-1;
+}
+
+/**
+ * empties the histogram.
+ *
+ * @param histogram histogram to initialize.
+ */
+void histogram_init(Histogram* histogram)
+{
+    for(int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        histogram->counts[i].store(0,std::memory_order_relaxed);
+    }
+    histogram->total.store(0,std::memory_order_relaxed);
+    histogram->max.store(0,std::memory_order_relaxed);
+}
+
+/**
+ * counts one occurrence of the value.
+ *
+ * @param histogram histogram to record the value in.
+ * @param value value to record.
+ */
+void histogram_record(Histogram* histogram, unsigned long long value)
+{
+    histogram->counts[bucket_index(value)]
+        .fetch_add(1,std::memory_order_relaxed);
+    histogram->total.fetch_add(1,std::memory_order_relaxed);
+
+    unsigned long long max = histogram->max.load(std::memory_order_relaxed);
+    while(value > max && !histogram->max.compare_exchange_weak(max,value,
+        std::memory_order_relaxed));
+}
+
+/**
+ * adds every value recorded in one histogram to another.
+ *
+ * @param histogram histogram to add the values to.
+ * @param other histogram whose values are added; it is left as it is.
+ */
+void histogram_merge(Histogram* histogram, Histogram* other)
+{
+    for(int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        histogram->counts[i].fetch_add(
+            other->counts[i].load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    }
+    histogram->total.fetch_add(other->total.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+
+    unsigned long long value = other->max.load(std::memory_order_relaxed);
+    unsigned long long max = histogram->max.load(std::memory_order_relaxed);
+    while(value > max && !histogram->max.compare_exchange_weak(max,value,
+        std::memory_order_relaxed));
+}
+
+/**
+ * returns the value that the given percentage of recorded values are at or
+ *   below, rounded up to the end of its bucket.
+ *
+ * @param histogram histogram to search.
+ * @param percent percentage between 0 and 100.
+ *
+ * @return the percentile, or 0 if nothing is recorded.
+ */
+unsigned long long histogram_percentile(Histogram* histogram, double percent)
+{
+    unsigned long long total =
+        histogram->total.load(std::memory_order_relaxed);
+    unsigned long long max = histogram->max.load(std::memory_order_relaxed);
+    if(total == 0)
+    {
+        return 0;
+    }
+
+    unsigned long long rank = (unsigned long long) (total*percent/100.0+0.5);
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+
+    unsigned long long seen = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += histogram->counts[i].load(std::memory_order_relaxed);
+        if(seen >= rank)
+        {
+            unsigned long long upper = bucket_upper(i);
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * prints the common percentiles, followed by the number of values within each
+ *   power of two.
+ *
+ * @param histogram histogram to print.
+ * @param file stream to print to.
+ * @param unit recorded values are divided by this before being printed.
+ */
+void histogram_print(Histogram* histogram, FILE* file, double unit)
+{
+    static const double percents[] = {50.0,90.0,99.0,99.9,99.99};
+
+    for(unsigned i = 0; i < sizeof(percents)/sizeof(*percents); ++i)
+    {
+        fprintf(file,"  p%-6g %12.1f\n",percents[i],
+            histogram_percentile(histogram,percents[i])/unit);
+    }
+    fprintf(file,"  max     %12.1f\n",
+        histogram->max.load(std::memory_order_relaxed)/unit);
+
+    // sum the buckets of each power of two
+    unsigned long long octaves[65] = {0};
+    unsigned long long widest = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        unsigned long long upper = bucket_upper(i);
+        int octave = (upper == 0) ? 0 : 64-__builtin_clzll(upper);
+        octaves[octave] +=
+            histogram->counts[i].load(std::memory_order_relaxed);
+        if(octaves[octave] > widest)
+        {
+            widest = octaves[octave];
+        }
+    }
+
+    for(int i = 0; i <= 64; ++i)
+    {
+        if(octaves[i] == 0)
+        {
+            continue;
+        }
+        unsigned long long upper = (i == 64) ? ~0ULL : (1ULL << i);
+        int width = (int) (octaves[i]*BAR_WIDTH/widest);
+        fprintf(file,"  < %12.1f %10llu |%.*s\n",upper/unit,octaves[i],
+            width,"########################################");
+    }
+}
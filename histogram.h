@@ -0,0 +1,35 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <atomic>
+#include <stdio.h>
+
+/**
+ * number of buckets that each power of two is split into; recorded values are
+ *   kept to within 1/HISTOGRAM_SUB_BUCKETS of their true value.
+ */
+#define HISTOGRAM_SUB_BUCKETS 16
+
+/**
+ * number of buckets needed to cover every 64 bit value.
+ */
+#define HISTOGRAM_BUCKETS (61*HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * log-linear histogram of non-negative values, like latencies in
+ *   nanoseconds. values may be recorded from any number of threads at once.
+ */
+typedef struct
+{
+    std::atomic<unsigned long long> counts[HISTOGRAM_BUCKETS];
+    std::atomic<unsigned long long> total;   // number of values recorded
+    std::atomic<unsigned long long> max;     // largest value recorded
+} Histogram;
+
+void histogram_init(Histogram* histogram);
+void histogram_record(Histogram* histogram, unsigned long long value);
+void histogram_merge(Histogram* histogram, Histogram* other);
+unsigned long long histogram_percentile(Histogram* histogram, double percent);
+void histogram_print(Histogram* histogram, FILE* file, double unit);
+
+#endif
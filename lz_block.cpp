@@ -0,0 +1,267 @@
+#include "lz_block.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * most and fewest bits of the hash that indexes the table of recent
+ *   positions. small blocks use a smaller table, which is quicker to clear.
+ */
+#define LZ_MAX_HASH_BITS 12
+#define LZ_MIN_HASH_BITS 8
+
+/**
+ * largest value that a token's nibble holds by itself.
+ */
+#define LZ_NIBBLE_MAX 15
+
+/**
+ * returns the 4 bytes at {p}, as they are in memory.
+ */
+static uint32_t read32(const unsigned char* p)
+{
+    uint32_t value;
+    memcpy(&value,p,sizeof(value));
+    return value;
+}
+
+/**
+ * returns the 8 bytes at {p}, as they are in memory.
+ */
+static uint64_t read64(const unsigned char* p)
+{
+    uint64_t value;
+    memcpy(&value,p,sizeof(value));
+    return value;
+}
+
+/**
+ * returns the table slot of a position whose next 4 bytes are {sequence}.
+ */
+static int hash_sequence(uint32_t sequence, int hashBits)
+{
+    return (int) ((sequence*2654435761u) >> (32-hashBits));
+}
+
+/**
+ * writes the bytes that continue a token's nibble, for a length of at least
+ *   LZ_NIBBLE_MAX.
+ *
+ * @return position after the written bytes.
+ */
+static int put_length(unsigned char* out, int op, int len)
+{
+    len -= LZ_NIBBLE_MAX;
+    while(len >= 255)
+    {
+        out[op++] = 255;
+        len -= 255;
+    }
+    out[op++] = (unsigned char) len;
+    return op;
+}
+
+/**
+ * writes one sequence; a run of literals, then a match, unless {matchLen} is
+ *   0.
+ *
+ * @return position after the sequence, or -1 if it doesn't fit {cap}.
+ */
+static int put_sequence(unsigned char* out, int op, int cap,
+    const unsigned char* literals, int numLiterals, int offset, int matchLen)
+{
+    // the most that the sequence may take, so nothing is checked while writing
+    int worstLen = 1+numLiterals/255+1+numLiterals+2+matchLen/255+1;
+    if(worstLen > cap-op)
+    {
+        return -1;
+    }
+
+    int token = op++;
+    int literalNibble = (numLiterals < LZ_NIBBLE_MAX) ?
+        numLiterals : LZ_NIBBLE_MAX;
+    if(literalNibble == LZ_NIBBLE_MAX)
+    {
+        op = put_length(out,op,numLiterals);
+    }
+    memcpy(out+op,literals,numLiterals);
+    op += numLiterals;
+
+    int matchNibble = 0;
+    if(matchLen != 0)
+    {
+        out[op++] = (unsigned char) offset;
+        out[op++] = (unsigned char) (offset >> 8);
+        matchNibble = matchLen-LZ_MIN_MATCH;
+        if(matchNibble >= LZ_NIBBLE_MAX)
+        {
+            op = put_length(out,op,matchNibble);
+            matchNibble = LZ_NIBBLE_MAX;
+        }
+    }
+    out[token] = (unsigned char) (literalNibble << 4|matchNibble);
+    return op;
+}
+
+/**
+ * compresses a block of data.
+ *
+ * @param in data to compress.
+ * @param len number of bytes of {in}.
+ * @param out written to.
+ * @param cap number of bytes that fit {out}; pass less than {len} to give up
+ *   on data that doesn't compress.
+ *
+ * @return length of the compressed block; 0 if it doesn't fit {cap}.
+ */
+int lz_compress(const char* in, int len, char* out, int cap)
+{
+    const unsigned char* src = (const unsigned char*) in;
+    unsigned char* dst = (unsigned char*) out;
+    int hashBits = LZ_MIN_HASH_BITS;
+    while(hashBits < LZ_MAX_HASH_BITS && (4 << hashBits) < len)
+    {
+        ++hashBits;
+    }
+    int table[1 << LZ_MAX_HASH_BITS];
+    memset(table,0,sizeof(int) << hashBits);
+
+    int op = 0;
+    int anchor = 0;
+    int pos = 0;
+    while(pos+LZ_MIN_MATCH <= len)
+    {
+        uint32_t sequence = read32(src+pos);
+        int slot = hash_sequence(sequence,hashBits);
+        int candidate = table[slot];
+        table[slot] = pos;
+
+        if(candidate >= pos || pos-candidate > LZ_MAX_OFFSET ||
+            read32(src+candidate) != sequence)
+        {
+            // skip ahead faster the longer nothing matches, so data that
+            // doesn't compress costs little
+            pos += 1+((pos-anchor) >> 6);
+            continue;
+        }
+
+        int matchLen = LZ_MIN_MATCH;
+        while(pos+matchLen+8 <= len &&
+            read64(src+candidate+matchLen) == read64(src+pos+matchLen))
+        {
+            matchLen += 8;
+        }
+        while(pos+matchLen < len &&
+            src[candidate+matchLen] == src[pos+matchLen])
+        {
+            ++matchLen;
+        }
+
+        op = put_sequence(dst,op,cap,src+anchor,pos-anchor,pos-candidate,
+            matchLen);
+        if(op == -1)
+        {
+            return 0;
+        }
+        pos += matchLen;
+        anchor = pos;
+    }
+
+    op = put_sequence(dst,op,cap,src+anchor,len-anchor,0,0);
+    return (op == -1) ? 0 : op;
+}
+
+/**
+ * decompresses a block of data. every length and offset is checked, so a
+ *   block from an untrusted peer can't write out of bounds.
+ *
+ * @param in compressed block.
+ * @param len number of bytes of {in}.
+ * @param out written to.
+ * @param outLen number of bytes that fit {out}.
+ *
+ * @return number of bytes written; -1 if the block is invalid, or doesn't fit
+ *   {outLen}.
+ */
+int lz_decompress(const char* in, int len, char* out, int outLen)
+{
+    const unsigned char* src = (const unsigned char*) in;
+    unsigned char* dst = (unsigned char*) out;
+    int ip = 0;
+    int op = 0;
+    while(ip < len)
+    {
+        int token = src[ip++];
+
+        // copy the literals
+        int numLiterals = token >> 4;
+        if(numLiterals == LZ_NIBBLE_MAX)
+        {
+            int more;
+            do
+            {
+                if(ip >= len)
+                {
+                    return -1;
+                }
+                more = src[ip++];
+                numLiterals += more;
+            }
+            while(more == 255 && numLiterals <= outLen);
+        }
+        if(numLiterals > len-ip || numLiterals > outLen-op)
+        {
+            return -1;
+        }
+        memcpy(dst+op,src+ip,numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        // the last sequence ends after its literals
+        if(ip == len)
+        {
+            break;
+        }
+
+        // copy the match, which may overlap what it is copied to
+        if(len-ip < 2)
+        {
+            return -1;
+        }
+        int offset = src[ip]|src[ip+1] << 8;
+        ip += 2;
+        int matchLen = token&LZ_NIBBLE_MAX;
+        if(matchLen == LZ_NIBBLE_MAX)
+        {
+            int more;
+            do
+            {
+                if(ip >= len)
+                {
+                    return -1;
+                }
+                more = src[ip++];
+                matchLen += more;
+            }
+            while(more == 255 && matchLen <= outLen);
+        }
+        matchLen += LZ_MIN_MATCH;
+        if(offset == 0 || offset > op || matchLen > outLen-op)
+        {
+            return -1;
+        }
+        if(offset >= matchLen)
+        {
+            memcpy(dst+op,dst+op-offset,matchLen);
+        }
+        else
+        {
+            for(int i = 0; i < matchLen; ++i)
+            {
+                dst[op+i] = dst[op-offset+i];
+            }
+        }
+        op += matchLen;
+    }
+    return op;
+}
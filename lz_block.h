@@ -0,0 +1,29 @@
+#ifndef _LZ_BLOCK_H_
+#define _LZ_BLOCK_H_
+
+/**
+ * a byte-oriented LZ77 block codec in the style of LZ4; fast enough to run on
+ *   every large payload, at the cost of compressing less than entropy coders.
+ *
+ * a block is a series of sequences, each a token byte, a run of literals, and
+ *   a match to copy from up to LZ_MAX_OFFSET bytes back. the token holds the
+ *   literal count in its high nibble and the match length, less
+ *   LZ_MIN_MATCH, in its low one; a nibble of 15 is continued by bytes that
+ *   are added to it, for as long as they are 255. the offset follows the
+ *   literals as two little-endian bytes. the last sequence has no match.
+ */
+
+/**
+ * shortest match that is worth encoding.
+ */
+#define LZ_MIN_MATCH 4
+
+/**
+ * farthest back that a match may start.
+ */
+#define LZ_MAX_OFFSET 65535
+
+int lz_compress(const char* in, int len, char* out, int cap);
+int lz_decompress(const char* in, int len, char* out, int outLen);
+
+#endif
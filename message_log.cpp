@@ -0,0 +1,556 @@
+#include "message_log.h"
+#include "shared_frame.h"
+#include "protocol.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * first bytes of every record; "MLOG" in a little-endian file.
+ */
+#define RECORD_MAGIC 0x474f4c4du
+
+/**
+ * number of bytes in front of a record's frame; its magic and checksum.
+ */
+#define RECORD_HEADER_LEN 8
+
+/**
+ * records start at multiples of this many bytes in their segment.
+ */
+#define RECORD_ALIGN 8
+
+/**
+ * returns the number of bytes that a record of a payload takes.
+ */
+static long record_len(int len)
+{
+    long recordLen = RECORD_HEADER_LEN+FRAME_HEADER_LEN+(long) len;
+    return (recordLen+RECORD_ALIGN-1)&~(long) (RECORD_ALIGN-1);
+}
+
+/**
+ * returns the FNV-1a hash of a record's frame.
+ */
+static unsigned int checksum(const char* data, long len)
+{
+    unsigned int hash = 2166136261u;
+    for(long i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char) data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * writes the path of a segment's file to path, which has room for PATH_MAX
+ *   bytes.
+ */
+static void segment_path(MessageLog* log, int number, char* path)
+{
+    snprintf(path,PATH_MAX,"%s/%08d.log",log->dir,number);
+}
+
+/**
+ * empties a ring, and makes room in it for the log's history.
+ */
+static void init_ring(MessageLog* log, LogRing* ring)
+{
+    ring->entries.resize(log->history);
+    ring->start = 0;
+    ring->count = 0;
+}
+
+/**
+ * adds an entry to a ring, in place of its oldest one if it is full.
+ */
+static void push_entry(MessageLog* log, LogRing* ring, const LogEntry& entry)
+{
+    if(log->history == 0)
+    {
+        return;
+    }
+    if(ring->count < log->history)
+    {
+        ring->entries[(ring->start+ring->count++)%log->history] = entry;
+    }
+    else
+    {
+        ring->entries[ring->start] = entry;
+        ring->start = (ring->start+1)%log->history;
+    }
+}
+
+/**
+ * returns the ring of the room that a chat message was said in; the lobby's
+ *   for SHOW_MSG.
+ *
+ * @param create non-zero to make a ring for a room that has none yet.
+ *
+ * @return the ring; 0 if the message isn't a chat message, or the room has
+ *   no ring.
+ */
+static LogRing* find_ring(MessageLog* log, int type, const char* payload,
+    int len, int create)
+{
+    if(type == SHOW_MSG)
+    {
+        return &log->lobby;
+    }
+    if(type != ROOM_MSG)
+    {
+        return 0;
+    }
+
+    int roomLen = strnlen(payload,len);
+    if(roomLen > MAX_NAME_LEN)
+    {
+        roomLen = MAX_NAME_LEN;
+    }
+    if(roomLen == 0)
+    {
+        return 0;
+    }
+    int id = names_find(&log->roomNames,payload,roomLen);
+    if(id == NO_NAME)
+    {
+        if(!create)
+        {
+            return 0;
+        }
+        id = names_claim(&log->roomNames,payload,roomLen);
+        if(id >= (int) log->rooms.size())
+        {
+            log->rooms.resize(id+1);
+        }
+        init_ring(log,&log->rooms[id]);
+    }
+    return &log->rooms[id];
+}
+
+/**
+ * returns the segment with the number; 0 if it was deleted.
+ */
+static LogSegment* find_segment(MessageLog* log, int number)
+{
+    for(size_t i = 0; i < log->segments.size(); ++i)
+    {
+        if(log->segments[i].number == number)
+        {
+            return &log->segments[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * walks the records of a segment, adding each to its ring.
+ *
+ * @param data the segment's records.
+ * @param size number of bytes in {data}.
+ * @param verify non-zero to check every record's checksum.
+ *
+ * @return number of bytes of valid records, up to the first invalid one.
+ */
+static long scan_segment(MessageLog* log, int number, const char* data,
+    long size, int verify)
+{
+    long pos = 0;
+    while(pos+RECORD_HEADER_LEN+FRAME_HEADER_LEN <= size)
+    {
+        const char* record = data+pos;
+        const char* frame = record+RECORD_HEADER_LEN;
+        unsigned int magic;
+        unsigned int sum;
+        int type;
+        int len;
+        memcpy(&magic,record,sizeof(magic));
+        memcpy(&sum,record+sizeof(magic),sizeof(sum));
+        memcpy(&type,frame,sizeof(type));
+        memcpy(&len,frame+sizeof(type),sizeof(len));
+        if(magic != RECORD_MAGIC || len < 0 || pos+record_len(len) > size ||
+            (verify && checksum(frame,FRAME_HEADER_LEN+len) != sum))
+        {
+            break;
+        }
+
+        LogRing* ring = find_ring(log,type,frame+FRAME_HEADER_LEN,len,1);
+        if(ring != 0)
+        {
+            LogEntry entry;
+            entry.segment = number;
+            entry.offset = pos+RECORD_HEADER_LEN;
+            entry.type = type;
+            entry.len = len;
+            push_entry(log,ring,entry);
+        }
+        pos += record_len(len);
+    }
+    return pos;
+}
+
+/**
+ * frees the ring of a room, and its name, once every entry in it is in a
+ *   segment that was deleted, so rooms that nothing is said in anymore don't
+ *   take up memory for good.
+ *
+ * @param first number of the oldest segment left.
+ */
+static void release_ring(MessageLog* log, int id, int first)
+{
+    LogRing* ring = &log->rooms[id];
+    if(ring->count > 0 &&
+        ring->entries[(ring->start+ring->count-1)%log->history].segment >=
+        first)
+    {
+        return;
+    }
+    std::vector<LogEntry>().swap(ring->entries);
+    ring->start = 0;
+    ring->count = 0;
+    names_release(&log->roomNames,id);
+}
+
+/**
+ * deletes the oldest segment, and the rings of the rooms that only had
+ *   messages in it. its file stays open while frames are still being sent
+ *   from it.
+ */
+static void delete_oldest(MessageLog* log)
+{
+    char path[PATH_MAX];
+    LogSegment* oldest = &log->segments.front();
+    segment_path(log,oldest->number,path);
+    unlink(path);
+    file_release(oldest->file);
+    log->segments.erase(log->segments.begin());
+
+    int first = log->segments.empty() ? INT_MAX :
+        log->segments.front().number;
+    for(size_t id = 0; id < log->rooms.size(); ++id)
+    {
+        if(names_len(&log->roomNames,id) != -1)
+        {
+            release_ring(log,id,first);
+        }
+    }
+}
+
+/**
+ * starts a new segment to append to, deleting the oldest ones that it puts
+ *   over maxSegments.
+ *
+ * @return 0 on success; -1 on failure. check errno for details.
+ */
+static int start_segment(MessageLog* log, int number)
+{
+    char path[PATH_MAX];
+    segment_path(log,number,path);
+    int fd = open(path,O_RDWR|O_CREAT|O_TRUNC,0644);
+    if(fd == -1)
+    {
+        return -1;
+    }
+    void* map = MAP_FAILED;
+    if(ftruncate(fd,log->segmentSize) == 0)
+    {
+        map = mmap(0,log->segmentSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    }
+    if(map == MAP_FAILED)
+    {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    LogSegment segment;
+    segment.number = number;
+    segment.file = file_share(fd);
+    segment.map = (char*) map;
+    segment.len = 0;
+    log->segments.push_back(segment);
+    while((int) log->segments.size() > log->maxSegments)
+    {
+        delete_oldest(log);
+    }
+    return 0;
+}
+
+/**
+ * goes back to appending to a recovered segment, after the records in it;
+ *   whatever a crash left past them was cut off when it was recovered.
+ *
+ * @return 0 on success; -1 on failure. check errno for details.
+ */
+static int resume_segment(MessageLog* log, LogSegment* segment)
+{
+    void* map = MAP_FAILED;
+    if(ftruncate(segment->file->fd,log->segmentSize) == 0)
+    {
+        map = mmap(0,log->segmentSize,PROT_READ|PROT_WRITE,MAP_SHARED,
+            segment->file->fd,0);
+    }
+    if(map == MAP_FAILED)
+    {
+        return -1;
+    }
+    segment->map = (char*) map;
+    return 0;
+}
+
+/**
+ * stops appending to a segment, and cuts its file down to its records.
+ */
+static void seal_segment(MessageLog* log, LogSegment* segment)
+{
+    munmap(segment->map,log->segmentSize);
+    segment->map = 0;
+    if(ftruncate(segment->file->fd,segment->len) == -1)
+    {
+        perror("failed to seal log segment");
+    }
+}
+
+/**
+ * opens a log, creating its directory if it doesn't exist, and recovers the
+ *   messages that are in it already. appends go after them, in the newest
+ *   segment, if it has room.
+ *
+ * @param log log to initialize.
+ * @param dir directory that holds the segments.
+ * @param segmentSize size of a segment file, in bytes.
+ * @param maxSegments most segments kept on disk; at least 1.
+ * @param history number of the latest messages kept for each room.
+ *
+ * @return 0 on success; -1 on failure, with the log closed. check errno for
+ *   details.
+ */
+int mlog_open(MessageLog* log, const char* dir, long segmentSize,
+    int maxSegments, int history)
+{
+    log->dir = strdup(dir);
+    log->segmentSize = segmentSize;
+    log->maxSegments = (maxSegments < 1) ? 1 : maxSegments;
+    log->history = history;
+    log->segments.clear();
+    log->rooms.clear();
+    init_ring(log,&log->lobby);
+    names_init(&log->roomNames);
+
+    // find the segments that are there, oldest first
+    if(mkdir(dir,0755) == -1 && errno != EEXIST)
+    {
+        mlog_close(log);
+        return -1;
+    }
+    DIR* listing = opendir(dir);
+    if(listing == 0)
+    {
+        mlog_close(log);
+        return -1;
+    }
+    std::vector<int> numbers;
+    struct dirent* file;
+    while((file = readdir(listing)) != 0)
+    {
+        int number;
+        int nameLen = 0;
+        if(sscanf(file->d_name,"%8d.log%n",&number,&nameLen) == 1 &&
+            nameLen == 12 && file->d_name[nameLen] == 0)
+        {
+            numbers.push_back(number);
+        }
+    }
+    closedir(listing);
+    std::sort(numbers.begin(),numbers.end());
+
+    // recover the newest segments; only the newest one can have been cut
+    // short
+    size_t first = (numbers.size() > (size_t) log->maxSegments) ?
+        numbers.size()-log->maxSegments : 0;
+    for(size_t i = 0; i < numbers.size(); ++i)
+    {
+        char path[PATH_MAX];
+        segment_path(log,numbers[i],path);
+        int fd = (i >= first) ? open(path,O_RDWR) : -1;
+        struct stat info;
+        if(fd == -1 || fstat(fd,&info) == -1)
+        {
+            if(fd != -1)
+            {
+                close(fd);
+            }
+            unlink(path);
+            continue;
+        }
+
+        long len = 0;
+        void* map = (info.st_size > 0) ?
+            mmap(0,info.st_size,PROT_READ,MAP_SHARED,fd,0) : MAP_FAILED;
+        if(map != MAP_FAILED)
+        {
+            len = scan_segment(log,numbers[i],(const char*) map,info.st_size,
+                i == numbers.size()-1);
+            munmap(map,info.st_size);
+        }
+        if(len < info.st_size && ftruncate(fd,len) == -1)
+        {
+            perror("failed to recover log segment");
+        }
+
+        LogSegment segment;
+        segment.number = numbers[i];
+        segment.file = file_share(fd);
+        segment.map = 0;
+        segment.len = len;
+        log->segments.push_back(segment);
+    }
+
+    LogSegment* newest = log->segments.empty() ? 0 : &log->segments.back();
+    if(newest != 0 && newest->len < log->segmentSize &&
+        resume_segment(log,newest) == 0)
+    {
+        return 0;
+    }
+    if(start_segment(log,numbers.empty() ? 0 : numbers.back()+1) == -1)
+    {
+        mlog_close(log);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * seals the segment being appended to, and frees the log. frames that are
+ *   still queued to be sent from its files keep them open.
+ *
+ * @param log log to close.
+ */
+void mlog_close(MessageLog* log)
+{
+    for(size_t i = 0; i < log->segments.size(); ++i)
+    {
+        if(log->segments[i].map != 0)
+        {
+            seal_segment(log,&log->segments[i]);
+        }
+        file_release(log->segments[i].file);
+    }
+    log->segments.clear();
+    log->rooms.clear();
+    log->lobby.entries.clear();
+    names_destroy(&log->roomNames);
+    free(log->dir);
+    log->dir = 0;
+}
+
+/**
+ * appends a chat message to the log, starting a new segment if it doesn't fit
+ *   the one being appended to. the record is written through the segment's
+ *   mapping, and left to the kernel to write back; a crash of the process
+ *   loses nothing, and records cut short by a crash of the machine are
+ *   dropped when the log is opened again.
+ *
+ * @param log log to append to.
+ * @param msg SHOW_MSG or ROOM_MSG to log.
+ *
+ * @return 0 if the message was logged; -1 if it isn't a chat message, is too
+ *   large for a segment, or a new segment couldn't be started.
+ */
+int mlog_append(MessageLog* log, const Net::Message& msg)
+{
+    long recordLen = record_len(msg.len);
+    LogRing* ring = find_ring(log,msg.type,(const char*) msg.data,msg.len,1);
+    if(ring == 0 || recordLen > log->segmentSize)
+    {
+        return -1;
+    }
+
+    LogSegment* segment = &log->segments.back();
+    if(segment->map == 0 || segment->len+recordLen > log->segmentSize)
+    {
+        if(segment->map != 0)
+        {
+            seal_segment(log,segment);
+        }
+        if(start_segment(log,segment->number+1) == -1)
+        {
+            return -1;
+        }
+        segment = &log->segments.back();
+
+        // deleting the oldest segment may have freed the room's ring
+        ring = find_ring(log,msg.type,(const char*) msg.data,msg.len,1);
+    }
+
+    // the frame, then its checksum and the magic that makes it a record
+    char* record = segment->map+segment->len;
+    char* frame = record+RECORD_HEADER_LEN;
+    unsigned int magic = RECORD_MAGIC;
+    memcpy(frame,&msg.type,sizeof(msg.type));
+    memcpy(frame+sizeof(msg.type),&msg.len,sizeof(msg.len));
+    memcpy(frame+FRAME_HEADER_LEN,msg.data,msg.len);
+    unsigned int sum = checksum(frame,FRAME_HEADER_LEN+msg.len);
+    memcpy(record+sizeof(magic),&sum,sizeof(sum));
+    memcpy(record,&magic,sizeof(magic));
+
+    LogEntry entry;
+    entry.segment = segment->number;
+    entry.offset = segment->len+RECORD_HEADER_LEN;
+    entry.type = msg.type;
+    entry.len = msg.len;
+    push_entry(log,ring,entry);
+    segment->len += recordLen;
+    return 0;
+}
+
+/**
+ * finds the latest messages of a room that are still in the log, to replay.
+ *   the files in the extents are only valid until the log is next appended
+ *   to, unless they are retained.
+ *
+ * @param log log to search.
+ * @param room name of the room; need not be null-terminated. 0 for the
+ *   lobby's messages.
+ * @param roomLen length of {room}.
+ * @param extents set to where the messages are, oldest first; must have room
+ *   for the log's history.
+ *
+ * @return number of messages found.
+ */
+int mlog_history(MessageLog* log, const char* room, int roomLen,
+    LogExtent* extents)
+{
+    LogRing* ring = (room == 0) ? &log->lobby :
+        find_ring(log,ROOM_MSG,room,roomLen,0);
+    if(ring == 0)
+    {
+        return 0;
+    }
+
+    int numFound = 0;
+    for(int i = 0; i < ring->count; ++i)
+    {
+        LogEntry* entry = &ring->entries[(ring->start+i)%log->history];
+        LogSegment* segment = find_segment(log,entry->segment);
+        if(segment != 0)
+        {
+            extents[numFound].file = segment->file;
+            extents[numFound].offset = entry->offset;
+            extents[numFound].type = entry->type;
+            extents[numFound].len = entry->len;
+            ++numFound;
+        }
+    }
+    return numFound;
+}
@@ -0,0 +1,107 @@
+#ifndef _MESSAGE_LOG_H_
+#define _MESSAGE_LOG_H_
+
+#include <vector>
+
+#include "Message.h"
+#include "name_registry.h"
+#include "shared_file.h"
+
+/**
+ * default size of a segment file, in bytes; a segment is rotated out when
+ *   the next record doesn't fit it.
+ */
+#define LOG_DEFAULT_SEGMENT_SIZE (16*1024*1024)
+
+/**
+ * default number of segments kept on disk; the oldest one is deleted when a
+ *   new one would go over it.
+ */
+#define LOG_DEFAULT_MAX_SEGMENTS 8
+
+/**
+ * default number of the latest messages kept for each room, and for the
+ *   lobby, to replay to those that join it.
+ */
+#define LOG_DEFAULT_HISTORY 50
+
+/**
+ * a logged message; where its frame is, and what it holds.
+ */
+typedef struct
+{
+    int segment;        // number of the segment that holds the record
+    long offset;        // position of the record's frame in the segment
+    int type;           // type of the message
+    int len;            // bytes in the message's payload
+} LogEntry;
+
+/**
+ * the latest logged messages of a room, oldest first from start; a circular
+ *   array of the log's history entries.
+ */
+typedef struct
+{
+    std::vector<LogEntry> entries;
+    int start;          // position of the oldest entry
+    int count;          // number of entries in use
+} LogRing;
+
+/**
+ * a file of records, mapped into memory to be appended to.
+ */
+typedef struct
+{
+    int number;         // number of the segment; its file is named after it
+    SharedFile* file;   // the segment's open file
+    char* map;          // the file mapped into memory; 0 once it is sealed
+    long len;           // bytes of records in the segment
+} LogSegment;
+
+/**
+ * a logged message as it is found in its segment, for Host::sendFile.
+ */
+typedef struct
+{
+    SharedFile* file;   // file of the segment that holds the frame
+    long offset;        // position of the frame in the file
+    int type;           // type of the message
+    int len;            // bytes in the message's payload
+} LogExtent;
+
+/**
+ * append-only log of chat messages, kept in a directory of segment files.
+ *
+ * every record is the message's encoded WIRE_V0 frame behind a short header
+ *   with a checksum, so a logged message can be sent straight out of its
+ *   file. records are appended through the mapping of the newest segment;
+ *   when it is full, it is sealed, cut down to the records in it, and a new
+ *   one is started, and segments past maxSegments are deleted, oldest first.
+ *
+ * the latest history messages of the lobby and of every room are kept in
+ *   rings, to replay to those that join. opening a log rebuilds them from the
+ *   segments that are there, and finds the end of the records in the newest
+ *   segment, which a crash may have left partly written; that is the only
+ *   one whose checksums are checked, so recovering costs a scan of one
+ *   segment, and a walk over the record headers of the others.
+ */
+typedef struct
+{
+    char* dir;                      // directory that holds the segments
+    long segmentSize;               // size of a segment file being appended
+    int maxSegments;                // most segments kept on disk
+    int history;                    // most entries kept in a ring
+    std::vector<LogSegment> segments; // oldest first; the last is appended
+    LogRing lobby;                  // messages sent to every client
+    NameRegistry roomNames;         // name of each room that has a ring
+    std::vector<LogRing> rooms;     // indexed by room name id
+} MessageLog;
+
+int mlog_open(MessageLog* log, const char* dir, long segmentSize,
+    int maxSegments, int history);
+void mlog_close(MessageLog* log);
+int mlog_append(MessageLog* log, const Net::Message& msg);
+int mlog_history(MessageLog* log, const char* room, int roomLen,
+    LogExtent* extents);
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef _MPSC_QUEUE_H_
+#define _MPSC_QUEUE_H_
+
+#include <new>
+#include <utility>
+#include <atomic>
+#include <sched.h>
+
+#include "buffer_pool.h"
+
+/**
+ * unbounded, lock-free queue that any number of threads may push to, and a
+ *   single thread pops from. pushing never blocks, and costs one atomic
+ *   exchange.
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue();
+    ~MpscQueue();
+    void push(const T& value);
+    int pop(T* value);
+    int empty();
+private:
+    struct Node
+    {
+        std::atomic<Node*> next;
+        int sizeClass;
+        T value;
+    };
+
+    static Node* newNode();
+    static void deleteNode(Node* node);
+
+    /**
+     * node that was pushed last; producers swap themselves in here.
+     */
+    std::atomic<Node*> tail;
+
+    /**
+     * node before the one that is popped next; only used by the consumer.
+     */
+    Node* head;
+};
+
+template<typename T>
+MpscQueue<T>::MpscQueue()
+{
+    Node* stub = newNode();
+    head = stub;
+    tail.store(stub,std::memory_order_relaxed);
+}
+
+template<typename T>
+MpscQueue<T>::~MpscQueue()
+{
+    T value;
+    while(pop(&value))
+    {
+    }
+    deleteNode(head);
+}
+
+/**
+ * adds a value to the back of the queue. may be called from any thread.
+ *
+ * @param value value to add.
+ */
+template<typename T>
+void MpscQueue<T>::push(const T& value)
+{
+    Node* node = newNode();
+    node->value = value;
+    Node* prev = tail.exchange(node,std::memory_order_acq_rel);
+    prev->next.store(node,std::memory_order_release);
+}
+
+/**
+ * removes the value at the front of the queue. must only be called from the
+ *   consumer thread.
+ *
+ * @param value set to the removed value.
+ *
+ * @return non-zero if a value was removed; 0 if the queue is empty.
+ */
+template<typename T>
+int MpscQueue<T>::pop(T* value)
+{
+    Node* next = head->next.load(std::memory_order_acquire);
+    while(next == 0)
+    {
+        // empty, unless a producer has swapped in its node, but not linked it
+        // yet; it is only ever a few instructions away from doing so
+        if(tail.load(std::memory_order_acquire) == head)
+        {
+            return 0;
+        }
+        sched_yield();
+        next = head->next.load(std::memory_order_acquire);
+    }
+
+    *value = std::move(next->value);
+    deleteNode(head);
+    head = next;
+    return 1;
+}
+
+/**
+ * returns non-zero if the queue is empty, and no producer is in the middle of
+ *   pushing to it. must only be called from the consumer thread.
+ */
+template<typename T>
+int MpscQueue<T>::empty()
+{
+    return head->next.load(std::memory_order_acquire) == 0 &&
+        tail.load(std::memory_order_seq_cst) == head;
+}
+
+template<typename T>
+typename MpscQueue<T>::Node* MpscQueue<T>::newNode()
+{
+    int sizeClass;
+    Node* node = (Node*) pool_alloc(sizeof(Node),&sizeClass);
+    new (node) Node();
+    node->next.store(0,std::memory_order_relaxed);
+    node->sizeClass = sizeClass;
+    return node;
+}
+
+template<typename T>
+void MpscQueue<T>::deleteNode(Node* node)
+{
+    int sizeClass = node->sizeClass;
+    node->~Node();
+    pool_free(node,sizeClass);
+}
+
+#endif
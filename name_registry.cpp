@@ -0,0 +1,353 @@
+#include "name_registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * sizes of a new registry's arena, entries and hash table.
+ */
+#define INITIAL_ARENA 4096
+#define INITIAL_ENTRIES 64
+#define INITIAL_SLOTS 128
+
+/**
+ * marks of hash table slots that hold no id; never used, and removed.
+ */
+#define EMPTY_SLOT -1
+#define REMOVED_SLOT -2
+
+/**
+ * name given for an empty one.
+ */
+#define DEFAULT_NAME "guest"
+
+/**
+ * returns the FNV-1a hash of a name.
+ */
+static unsigned int hash_name(const char* name, int len)
+{
+    unsigned int hash = 2166136261u;
+    for(int i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * initializes an empty registry.
+ *
+ * @param registry registry to initialize.
+ */
+void names_init(NameRegistry* registry)
+{
+    registry->arena = (char*) malloc(INITIAL_ARENA);
+    registry->arenaLen = 0;
+    registry->arenaCap = INITIAL_ARENA;
+    registry->deadBytes = 0;
+    registry->entries =
+        (NameEntry*) malloc(INITIAL_ENTRIES*sizeof(NameEntry));
+    registry->numEntries = 0;
+    registry->entriesCap = INITIAL_ENTRIES;
+    registry->freeEntry = NO_NAME;
+    registry->slots = (int*) malloc(INITIAL_SLOTS*sizeof(int));
+    registry->numSlots = INITIAL_SLOTS;
+    registry->numUsed = 0;
+    registry->count = 0;
+    for(int i = 0; i < INITIAL_SLOTS; ++i)
+    {
+        registry->slots[i] = EMPTY_SLOT;
+    }
+}
+
+/**
+ * frees the registry, and every name in it.
+ *
+ * @param registry registry to destroy.
+ */
+void names_destroy(NameRegistry* registry)
+{
+    free(registry->arena);
+    free(registry->entries);
+    free(registry->slots);
+    registry->arena = 0;
+    registry->entries = 0;
+    registry->slots = 0;
+    registry->count = 0;
+}
+
+/**
+ * returns the slot that holds the name, or the slot that it would go in; the
+ *   first removed one on its way, if any, otherwise the empty one that ended
+ *   the search.
+ */
+static int find_slot(NameRegistry* registry, const char* name, int len,
+    unsigned int hash)
+{
+    int mask = registry->numSlots-1;
+    int insertAt = -1;
+    for(int slot = hash&mask;; slot = (slot+1)&mask)
+    {
+        int id = registry->slots[slot];
+        if(id == EMPTY_SLOT)
+        {
+            return (insertAt != -1) ? insertAt : slot;
+        }
+        if(id == REMOVED_SLOT)
+        {
+            if(insertAt == -1)
+            {
+                insertAt = slot;
+            }
+            continue;
+        }
+        NameEntry* entry = &registry->entries[id];
+        if(entry->hash == hash && entry->len == len &&
+            memcmp(registry->arena+entry->offset,name,len) == 0)
+        {
+            return slot;
+        }
+    }
+}
+
+/**
+ * rebuilds the hash table with room for twice the names that it holds, which
+ *   also clears it of removed slots.
+ */
+static void rehash(NameRegistry* registry)
+{
+    int numSlots = INITIAL_SLOTS;
+    while(numSlots < registry->count*4)
+    {
+        numSlots *= 2;
+    }
+    free(registry->slots);
+    registry->slots = (int*) malloc(numSlots*sizeof(int));
+    registry->numSlots = numSlots;
+    registry->numUsed = registry->count;
+    for(int i = 0; i < numSlots; ++i)
+    {
+        registry->slots[i] = EMPTY_SLOT;
+    }
+
+    int mask = numSlots-1;
+    for(int id = 0; id < registry->numEntries; ++id)
+    {
+        NameEntry* entry = &registry->entries[id];
+        if(entry->len != -1)
+        {
+            int slot = entry->hash&mask;
+            while(registry->slots[slot] != EMPTY_SLOT)
+            {
+                slot = (slot+1)&mask;
+            }
+            registry->slots[slot] = id;
+        }
+    }
+}
+
+/**
+ * copies every registered name into a new arena, leaving out released ones.
+ *
+ * @param extra bytes that the new arena needs room for, besides the names.
+ */
+static void compact_arena(NameRegistry* registry, int extra)
+{
+    int liveBytes = registry->arenaLen-registry->deadBytes;
+    int arenaCap = INITIAL_ARENA;
+    while(arenaCap < (liveBytes+extra)*2)
+    {
+        arenaCap *= 2;
+    }
+
+    char* arena = (char*) malloc(arenaCap);
+    int arenaLen = 0;
+    for(int id = 0; id < registry->numEntries; ++id)
+    {
+        NameEntry* entry = &registry->entries[id];
+        if(entry->len != -1)
+        {
+            memcpy(arena+arenaLen,registry->arena+entry->offset,entry->len+1);
+            entry->offset = arenaLen;
+            arenaLen += entry->len+1;
+        }
+    }
+    free(registry->arena);
+    registry->arena = arena;
+    registry->arenaLen = arenaLen;
+    registry->arenaCap = arenaCap;
+    registry->deadBytes = 0;
+}
+
+/**
+ * adds a name that isn't registered yet.
+ *
+ * @param slot slot returned by find_slot for the name.
+ *
+ * @return id of the name.
+ */
+static int add_name(NameRegistry* registry, const char* name, int len,
+    unsigned int hash, int slot)
+{
+    // copy the name to the end of the arena
+    if(registry->arenaLen+len+1 > registry->arenaCap)
+    {
+        compact_arena(registry,len+1);
+    }
+    int offset = registry->arenaLen;
+    memcpy(registry->arena+offset,name,len);
+    registry->arena[offset+len] = 0;
+    registry->arenaLen += len+1;
+
+    // take a free entry, or a new one
+    int id = registry->freeEntry;
+    if(id != NO_NAME)
+    {
+        registry->freeEntry = registry->entries[id].offset;
+    }
+    else
+    {
+        if(registry->numEntries == registry->entriesCap)
+        {
+            registry->entriesCap *= 2;
+            registry->entries = (NameEntry*) realloc(registry->entries,
+                registry->entriesCap*sizeof(NameEntry));
+        }
+        id = registry->numEntries++;
+    }
+    NameEntry* entry = &registry->entries[id];
+    entry->offset = offset;
+    entry->len = len;
+    entry->hash = hash;
+    entry->nextSuffix = 2;
+
+    if(registry->slots[slot] == EMPTY_SLOT)
+    {
+        ++registry->numUsed;
+    }
+    registry->slots[slot] = id;
+    ++registry->count;
+
+    // keep the table at most three quarters full, removed slots included
+    if(registry->numUsed*4 > registry->numSlots*3)
+    {
+        rehash(registry);
+    }
+    return id;
+}
+
+/**
+ * registers a name, or a name made from it if it is taken. the wanted name is
+ *   cut short to MAX_NAME_LEN, and a number is added to it until it is unique;
+ *   the numbers already tried for it are skipped, so a crowd that all want the
+ *   same name don't each try every number before theirs.
+ *
+ * @param registry registry to add to.
+ * @param wanted name that is wanted; need not be null-terminated.
+ * @param len length of {wanted}.
+ *
+ * @return id of the registered name.
+ */
+int names_claim(NameRegistry* registry, const char* wanted, int len)
+{
+    if(len <= 0)
+    {
+        wanted = DEFAULT_NAME;
+        len = strlen(DEFAULT_NAME);
+    }
+    if(len > MAX_NAME_LEN)
+    {
+        len = MAX_NAME_LEN;
+    }
+
+    unsigned int hash = hash_name(wanted,len);
+    int slot = find_slot(registry,wanted,len,hash);
+    int taken = registry->slots[slot];
+    if(taken < 0)
+    {
+        return add_name(registry,wanted,len,hash,slot);
+    }
+
+    // the name is taken; add numbers to it, starting past the ones that were
+    // handed out already
+    char name[MAX_NAME_LEN+1];
+    for(int suffix = registry->entries[taken].nextSuffix;; ++suffix)
+    {
+        char digits[12];
+        int numDigits = snprintf(digits,sizeof(digits),"%d",suffix);
+        int baseLen = (len+numDigits > MAX_NAME_LEN) ?
+            MAX_NAME_LEN-numDigits : len;
+        memcpy(name,wanted,baseLen);
+        memcpy(name+baseLen,digits,numDigits);
+        int nameLen = baseLen+numDigits;
+
+        unsigned int nameHash = hash_name(name,nameLen);
+        int nameSlot = find_slot(registry,name,nameLen,nameHash);
+        if(registry->slots[nameSlot] < 0)
+        {
+            registry->entries[taken].nextSuffix = suffix+1;
+            return add_name(registry,name,nameLen,nameHash,nameSlot);
+        }
+    }
+}
+
+/**
+ * unregisters a name, so it can be claimed again.
+ *
+ * @param registry registry to remove from.
+ * @param id id of the name.
+ */
+void names_release(NameRegistry* registry, int id)
+{
+    NameEntry* entry = &registry->entries[id];
+    int slot = find_slot(registry,registry->arena+entry->offset,entry->len,
+        entry->hash);
+    registry->slots[slot] = REMOVED_SLOT;
+
+    registry->deadBytes += entry->len+1;
+    entry->len = -1;
+    entry->offset = registry->freeEntry;
+    registry->freeEntry = id;
+    --registry->count;
+}
+
+/**
+ * finds a registered name.
+ *
+ * @param registry registry to search.
+ * @param name name to find; need not be null-terminated.
+ * @param len length of {name}.
+ *
+ * @return id of the name; NO_NAME if it isn't registered.
+ */
+int names_find(NameRegistry* registry, const char* name, int len)
+{
+    int slot = find_slot(registry,name,len,hash_name(name,len));
+    int id = registry->slots[slot];
+    return (id < 0) ? NO_NAME : id;
+}
+
+/**
+ * returns a registered name, null-terminated. it stays valid until the next
+ *   name is claimed.
+ *
+ * @param registry registry that holds the name.
+ * @param id id of the name.
+ */
+const char* names_get(NameRegistry* registry, int id)
+{
+    return registry->arena+registry->entries[id].offset;
+}
+
+/**
+ * returns the length of a registered name, without its null.
+ *
+ * @param registry registry that holds the name.
+ * @param id id of the name.
+ */
+int names_len(NameRegistry* registry, int id)
+{
+    return registry->entries[id].len;
+}
@@ -0,0 +1,61 @@
+#ifndef _NAME_REGISTRY_H_
+#define _NAME_REGISTRY_H_
+
+/**
+ * returned by names_find for a name that isn't registered.
+ */
+#define NO_NAME -1
+
+/**
+ * longest name that is registered; longer ones are cut short.
+ */
+#define MAX_NAME_LEN 32
+
+/**
+ * a registered name. entries that aren't in use are linked into a free list
+ *   through offset.
+ */
+typedef struct
+{
+    int offset;             // position of the name in the arena, or the next
+                            // free entry
+    int len;                // length of the name, without its null; -1 if the
+                            // entry is free
+    unsigned int hash;      // hash of the name
+    int nextSuffix;         // suffix to try first when the name is taken
+} NameEntry;
+
+/**
+ * a set of unique names, each with an id that stays the same for as long as
+ *   the name is registered.
+ *
+ * the names are stored back to back in one arena, null-terminated, and found
+ *   by an open-addressed hash table of entry ids, so checking whether a name
+ *   is taken costs one hash, and usually one string comparison. the arena is
+ *   compacted once most of it belongs to released names.
+ */
+typedef struct
+{
+    char* arena;            // every registered name
+    int arenaLen;           // bytes of arena in use, including released names
+    int arenaCap;           // bytes that arena fits
+    int deadBytes;          // bytes of arena that belong to released names
+    NameEntry* entries;     // every name, indexed by id
+    int numEntries;         // number of entries handed out, free ones included
+    int entriesCap;         // number of entries that entries fits
+    int freeEntry;          // first free entry; NO_NAME if there is none
+    int* slots;             // hash table of entry ids
+    int numSlots;           // number of slots; a power of two
+    int numUsed;            // slots that hold an id, or a removed one's mark
+    int count;              // number of registered names
+} NameRegistry;
+
+void names_init(NameRegistry* registry);
+void names_destroy(NameRegistry* registry);
+int names_claim(NameRegistry* registry, const char* wanted, int len);
+void names_release(NameRegistry* registry, int id);
+int names_find(NameRegistry* registry, const char* name, int len);
+const char* names_get(NameRegistry* registry, int id);
+int names_len(NameRegistry* registry, int id);
+
+#endif
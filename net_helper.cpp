@@ -7,6 +7,9 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/socket.h>
 
 #define LISTENQ 2048
 
@@ -209,18 +212,26 @@ struct sockaddr make_sockaddr(char* hostName, long hostAddr, short hostPort)
          * hostName is provided; do query for host then result as address...
          */
 
-        // resolve host (if needed)
-        struct hostent* host;
-        if((host = gethostbyname(hostName)) == 0)
+        // resolve host (if needed); unlike gethostbyname, getaddrinfo is
+        // safe to call from several threads at once
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* host;
+        int result;
+        if((result = getaddrinfo(hostName, 0, &hints, &host)) != 0)
         {
-            herror("failed to resolve host");
+            fprintf(stderr, "failed to resolve host: %s\n",
+                gai_strerror(result));
             struct sockaddr ret;
             memset(&ret,0,sizeof(ret));
             return ret;
         }
 
         // set address structure's address from query results
-        memcpy(&addr.sin_addr, host->h_addr, host->h_length);
+        addr.sin_addr = ((struct sockaddr_in*) host->ai_addr)->sin_addr;
+        freeaddrinfo(host);
     }
 
     // return...
@@ -231,6 +242,343 @@ struct sockaddr make_sockaddr(char* hostName, long hostAddr, short hostPort)
     }
 }
 
+/**
+ * creates a new non-blocking socket, and starts connecting it to the remote
+ *   host, without waiting for the connection to be established. the socket
+ *   becomes writable once it is; finish_tcp_connect then tells whether it
+ *   was.
+ *
+ * @function   start_tcp_connect
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int start_tcp_connect(const struct sockaddr_in* remote)
+ *
+ * @param      remote address of the remote host.
+ *
+ * @return     socket file descriptor to the new connecting socket. may return
+ *   -1 on error; check errno for details.
+ */
+int start_tcp_connect(const struct sockaddr_in* remote)
+{
+    int clntSock;
+    if((clntSock = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK, 0)) == -1)
+    {
+        return -1;
+    }
+
+    // a connection to the local host may be established right away
+    if(connect(clntSock, (const struct sockaddr*) remote, sizeof(*remote))
+        == -1 && errno != EINPROGRESS)
+    {
+        int error = errno;
+        close(clntSock);
+        errno = error;
+        return -1;
+    }
+    return clntSock;
+}
+
+/**
+ * returns whether a socket from start_tcp_connect was connected, once it is
+ *   writable, or has failed.
+ *
+ * @function   finish_tcp_connect
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int finish_tcp_connect(int socket)
+ *
+ * @param      socket socket file descriptor.
+ *
+ * @return     0 if the socket is connected; otherwise, the errno value that
+ *   connecting failed with.
+ */
+int finish_tcp_connect(int socket)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if(getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &len) == -1)
+    {
+        return errno;
+    }
+    return error;
+}
+
+/**
+ * creates a server socket listening on a unix domain path, for peers on the
+ *   same host. a path starting with '@' is bound in the abstract namespace,
+ *   so no file is made; otherwise a stale file left at the path is replaced.
+ *
+ * @function   make_unix_server_socket
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int make_unix_server_socket(const char* path)
+ *
+ * @param      path path to bind the new server socket to.
+ *
+ * @return     socket file descriptor to the new server socket. may return -1
+ *   on error; check errno for details.
+ */
+int make_unix_server_socket(const char* path)
+{
+    struct sockaddr_un localAddr;
+    socklen_t len;
+    if(make_unix_sockaddr(path, &localAddr, &len) == -1)
+    {
+        return -1;
+    }
+
+    int svrSock;
+    if((svrSock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        return -1;
+    }
+
+    // a server that didn't shut down cleanly leaves its socket file behind
+    if(path[0] != '@')
+    {
+        unlink(path);
+    }
+
+    if(bind(svrSock, (struct sockaddr*) &localAddr, len) == -1 ||
+        listen(svrSock, LISTENQ) == -1)
+    {
+        int error = errno;
+        close(svrSock);
+        errno = error;
+        return -1;
+    }
+    return svrSock;
+}
+
+/**
+ * creates a new socket that is connected to a server socket made by
+ *   make_unix_server_socket.
+ *
+ * @function   make_unix_client_socket
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int make_unix_client_socket(const char* path)
+ *
+ * @param      path path that the server socket is bound to.
+ *
+ * @return     socket file descriptor to the new connected client socket. may
+ *   return -1 on error; check errno for details.
+ */
+int make_unix_client_socket(const char* path)
+{
+    struct sockaddr_un remote;
+    socklen_t len;
+    if(make_unix_sockaddr(path, &remote, &len) == -1)
+    {
+        return -1;
+    }
+
+    int clntSock;
+    if((clntSock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+    {
+        return -1;
+    }
+
+    if(connect(clntSock, (struct sockaddr*) &remote, len) == -1)
+    {
+        int error = errno;
+        close(clntSock);
+        errno = error;
+        return -1;
+    }
+    return clntSock;
+}
+
+/**
+ * makes a unix domain address structure. a path starting with '@' names an
+ *   address in the abstract namespace.
+ *
+ * @function   make_unix_sockaddr
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int make_unix_sockaddr(const char* path,
+ *   struct sockaddr_un* addr, socklen_t* len)
+ *
+ * @param      path path of the address.
+ * @param      addr set to the address.
+ * @param      len set to the length of the address.
+ *
+ * @return     0 on success; -1 if the path is too long to fit, with errno set
+ *   to ENAMETOOLONG.
+ */
+int make_unix_sockaddr(const char* path, struct sockaddr_un* addr,
+    socklen_t* len)
+{
+    size_t pathLen = strlen(path);
+    if(pathLen == 0 || pathLen >= sizeof(addr->sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, pathLen);
+    if(path[0] == '@')
+    {
+        // abstract addresses start with a null, and aren't null-terminated
+        addr->sun_path[0] = 0;
+        *len = offsetof(struct sockaddr_un, sun_path)+pathLen;
+    }
+    else
+    {
+        *len = sizeof(*addr);
+    }
+    return 0;
+}
+
+/**
+ * writes to a unix domain socket, passing a copy of a file descriptor along
+ *   with the first byte, and returns when the write finishes, or fails.
+ *
+ * @function   send_fd
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int send_fd(int socket, int fd, const void* bufferPointer,
+ *   int bytesToWrite)
+ *
+ * @param      socket blocking unix domain socket file descriptor.
+ * @param      fd file descriptor to pass; -1 to pass none.
+ * @param      bufferPointer pointer to the data to write to the socket.
+ * @param      bytesToWrite number of bytes to write from the buffer; at least
+ *   1.
+ *
+ * @return     number of bytes written, which is less than {bytesToWrite} if the
+ *   socket fails.
+ */
+int send_fd(int socket, int fd, const void* bufferPointer, int bytesToWrite)
+{
+    struct iovec iov;
+    iov.iov_base = (void*) bufferPointer;
+    iov.iov_len = bytesToWrite;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if(fd != -1)
+    {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    int bytesWritten;
+    do
+    {
+        bytesWritten = sendmsg(socket, &msg, MSG_NOSIGNAL);
+    }
+    while(bytesWritten == -1 && errno == EINTR);
+    if(bytesWritten <= 0)
+    {
+        return 0;
+    }
+
+    // the descriptor went with the first part; write the rest without it
+    if(bytesWritten < bytesToWrite)
+    {
+        bytesWritten += write_file(socket,
+            (const char*) bufferPointer+bytesWritten,
+            bytesToWrite-bytesWritten);
+    }
+    return bytesWritten;
+}
+
+/**
+ * reads from a unix domain socket, and returns when the read finishes, EOF
+ *   occurs, or an error is thrown, along with a file descriptor passed with
+ *   the first byte by send_fd, if any.
+ *
+ * @function   recv_fd
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int recv_fd(int socket, int* fd, void* bufferPointer,
+ *   int bytesToRead)
+ *
+ * @param      socket blocking unix domain socket file descriptor.
+ * @param      fd set to the passed file descriptor; -1 if none was passed.
+ * @param      bufferPointer pointer to a buffer to read data from the socket
+ *   into.
+ * @param      bytesToRead number of bytes to read; exactly as many as were
+ *   written with the descriptor, so the next one isn't read along with them.
+ *
+ * @return     number of bytes read, which is less than {bytesToRead} if the
+ *   socket closes or fails; -1 if nothing could be read.
+ */
+int recv_fd(int socket, int* fd, void* bufferPointer, int bytesToRead)
+{
+    struct iovec iov;
+    iov.iov_base = bufferPointer;
+    iov.iov_len = bytesToRead;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    *fd = -1;
+    int bytesRead;
+    do
+    {
+        bytesRead = recvmsg(socket, &msg, 0);
+    }
+    while(bytesRead == -1 && errno == EINTR);
+    if(bytesRead <= 0)
+    {
+        return bytesRead;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if(cmsg != 0 && cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS)
+    {
+        memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    // the descriptor came with the first part; read the rest without it
+    if(bytesRead < bytesToRead)
+    {
+        bytesRead += read_file(socket, (char*) bufferPointer+bytesRead,
+            bytesToRead-bytesRead);
+    }
+    return bytesRead;
+}
+
 /**
  * reads from a socket, and returns when the read finishes, EOF occurs, or an
  *   error is thrown.
@@ -274,6 +622,87 @@ int read_file(int socket, void* bufferPointer, int bytesToRead)
     return result;
 }
 
+/**
+ * writes to a socket, and returns when the write finishes, or an error is
+ *   thrown. if the socket is non-blocking and its send buffer is full, waits
+ *   for it to become writable again.
+ *
+ * @function   write_file
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int write_file(int socket, const void* bufferPointer, int
+ *   bytesToWrite)
+ *
+ * @param      socket socket file descriptor.
+ * @param      bufferPointer pointer to the data to write to the socket.
+ * @param      bytesToWrite number of bytes to write from the buffer.
+ *
+ * @return     number of bytes written, which is less than {bytesToWrite} if the
+ *   socket fails.
+ */
+int write_file(int socket, const void* bufferPointer, int bytesToWrite)
+{
+    int bytesWritten;
+    int result = 0;
+    const char* bufPtr = (const char*) bufferPointer;
+
+    // write message to socket
+    while(bytesToWrite > 0)
+    {
+        bytesWritten = write(socket,bufPtr,bytesToWrite);
+        if(bytesWritten == -1)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // send buffer is full; wait until the socket is writable
+                struct pollfd pfd;
+                pfd.fd = socket;
+                pfd.events = POLLOUT;
+                poll(&pfd,1,-1);
+                continue;
+            }
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        bufPtr += bytesWritten;
+        bytesToWrite -= bytesWritten;
+        result += bytesWritten;
+    }
+
+    return result;
+}
+
+/**
+ * puts the socket into non-blocking mode.
+ *
+ * @function   set_non_blocking
+ *
+ * @revision   none
+ *
+ * @note       none
+ *
+ * @signature  int set_non_blocking(int socket)
+ *
+ * @param      socket socket file descriptor.
+ *
+ * @return     0 on success; -1 on failure. check errno for details.
+ */
+int set_non_blocking(int socket)
+{
+    int existingFlags = fcntl(socket,F_GETFL,0);
+    if(existingFlags == -1)
+    {
+        return -1;
+    }
+    return fcntl(socket,F_SETFL,O_NONBLOCK|existingFlags);
+}
+
 /**
  * prints the error message, then exits the program.
  *
@@ -1,9 +1,22 @@
 #ifndef _NET_HELPER_H_
 #define _NET_HELPER_H_
 
+#include <netinet/in.h>
+#include <sys/un.h>
+
 int make_tcp_server_socket(short port, bool isNonBlocking);
 int make_tcp_client_socket(char* remoteName, long remoteAddr, short remotePort, short localPort);
 struct sockaddr make_sockaddr(char* hostName, long hostAddr, short hostPort);
+int start_tcp_connect(const struct sockaddr_in* remote);
+int finish_tcp_connect(int socket);
+int make_unix_server_socket(const char* path);
+int make_unix_client_socket(const char* path);
+int make_unix_sockaddr(const char* path, struct sockaddr_un* addr,
+    socklen_t* len);
+int send_fd(int socket, int fd, const void* bufferPointer, int bytesToWrite);
+int recv_fd(int socket, int* fd, void* bufferPointer, int bytesToRead);
 int read_file(int socket, void* bufferPointer, int bytesToRead);
+int write_file(int socket, const void* bufferPointer, int bytesToWrite);
+int set_non_blocking(int socket);
 
 #endif
@@ -0,0 +1,381 @@
+#include "outbound_queue.h"
+#include "buffer_pool.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+/**
+ * maximum number of queued chunks that a single flush gathers into one write.
+ */
+#define MAX_FLUSH_IOV 64
+
+/**
+ * returns the number of bytes that a chunk sends in all.
+ */
+static int chunk_len(OutboundChunk* chunk)
+{
+    if(chunk->frame == 0)
+    {
+        return chunk->headerLen+chunk->fileLen;
+    }
+    return (chunk->headerLen == 0) ? chunk->frame->len :
+        chunk->headerLen+chunk->frame->len-FRAME_HEADER_LEN;
+}
+
+/**
+ * releases what a chunk sends, and frees the chunk.
+ */
+static void free_chunk(OutboundChunk* chunk)
+{
+    if(chunk->frame != 0)
+    {
+        frame_release(chunk->frame);
+    }
+    else
+    {
+        file_release(chunk->file);
+    }
+    pool_free(chunk,chunk->sizeClass);
+}
+
+/**
+ * appends a chunk to the back of the queue.
+ */
+static void append_chunk(OutboundQueue* queue, OutboundChunk* chunk)
+{
+    if(queue->tail == 0)
+    {
+        queue->head = chunk;
+    }
+    else
+    {
+        queue->tail->next = chunk;
+    }
+    queue->tail = chunk;
+    queue->bytes += chunk_len(chunk)-chunk->offset;
+}
+
+/**
+ * initializes an empty outbound queue.
+ *
+ * @param queue queue to initialize.
+ */
+void outq_init(OutboundQueue* queue)
+{
+    queue->head = 0;
+    queue->tail = 0;
+    queue->bytes = 0;
+}
+
+/**
+ * frees every chunk that is still in the queue.
+ *
+ * @param queue queue to destroy.
+ */
+void outq_destroy(OutboundQueue* queue)
+{
+    while(queue->head != 0)
+    {
+        OutboundChunk* next = queue->head->next;
+        free_chunk(queue->head);
+        queue->head = next;
+    }
+    outq_init(queue);
+}
+
+/**
+ * @param queue queue to query.
+ *
+ * @return non-zero if there is nothing left to send.
+ */
+int outq_empty(OutboundQueue* queue)
+{
+    return queue->head == 0;
+}
+
+/**
+ * adds a reference to an already encoded frame at the back of the queue. the
+ *   frame's bytes aren't copied, so the same frame can be queued for any
+ *   number of sockets, whatever framing each of them uses.
+ *
+ * @param queue queue to add the frame to.
+ * @param frame frame to queue.
+ * @param header header to send in front of the frame's payload, instead of
+ *   the frame's own header; 0 to send the frame as is.
+ * @param headerLen number of bytes in {header}.
+ * @param skip number of leading bytes of the header and payload to leave out;
+ *   they have already been sent.
+ */
+void outq_push_frame(OutboundQueue* queue, SharedFrame* frame,
+    const char* header, int headerLen, int skip)
+{
+    int sizeClass;
+    OutboundChunk* chunk = (OutboundChunk*) pool_alloc(sizeof(OutboundChunk),
+        &sizeClass);
+    chunk->sizeClass = sizeClass;
+    chunk->next = 0;
+    chunk->frame = frame;
+    chunk->file = 0;
+    chunk->headerLen = 0;
+    if(header != 0)
+    {
+        memcpy(chunk->header,header,headerLen);
+        chunk->headerLen = headerLen;
+    }
+    chunk->offset = skip;
+
+    int len = chunk_len(chunk);
+    if(skip >= len)
+    {
+        pool_free(chunk,sizeClass);
+        return;
+    }
+    frame_retain(frame);
+    append_chunk(queue,chunk);
+}
+
+/**
+ * adds a range of a file at the back of the queue. the bytes are sent from
+ *   the file with sendfile, without being read into memory.
+ *
+ * @param queue queue to add the range to.
+ * @param file file to send from.
+ * @param offset position of the first byte to send in {file}.
+ * @param len number of bytes to send from {file}.
+ * @param header header to send in front of the range; 0 for none.
+ * @param headerLen number of bytes in {header}.
+ */
+void outq_push_file(OutboundQueue* queue, SharedFile* file, long offset,
+    int len, const char* header, int headerLen)
+{
+    int sizeClass;
+    OutboundChunk* chunk = (OutboundChunk*) pool_alloc(sizeof(OutboundChunk),
+        &sizeClass);
+    chunk->sizeClass = sizeClass;
+    chunk->next = 0;
+    chunk->frame = 0;
+    chunk->file = file_retain(file);
+    chunk->fileOffset = offset;
+    chunk->fileLen = len;
+    chunk->headerLen = 0;
+    if(header != 0)
+    {
+        memcpy(chunk->header,header,headerLen);
+        chunk->headerLen = headerLen;
+    }
+    chunk->offset = 0;
+    append_chunk(queue,chunk);
+}
+
+/**
+ * sends the rest of a file chunk's range to a socket. sendfile can't be told
+ *   not to raise SIGPIPE, so it is blocked around the call, and one raised
+ *   by it is taken back before it is unblocked.
+ *
+ * @return number of bytes sent; -1 on failure. check errno for details.
+ */
+static int send_file_range(int socket, OutboundChunk* chunk)
+{
+    sigset_t pipeSet;
+    sigset_t oldSet;
+    sigemptyset(&pipeSet);
+    sigaddset(&pipeSet,SIGPIPE);
+    pthread_sigmask(SIG_BLOCK,&pipeSet,&oldSet);
+
+    off_t pos = chunk->fileOffset+chunk->offset-chunk->headerLen;
+    int bytesSent;
+    do
+    {
+        bytesSent = sendfile(socket,chunk->file->fd,&pos,
+            chunk_len(chunk)-chunk->offset);
+    }
+    while(bytesSent == -1 && errno == EINTR);
+    if(bytesSent == 0)
+    {
+        // the file is shorter than the range
+        bytesSent = -1;
+        errno = EIO;
+    }
+
+    if(bytesSent == -1 && errno == EPIPE)
+    {
+        struct timespec noWait = {0,0};
+        sigtimedwait(&pipeSet,0,&noWait);
+        errno = EPIPE;
+    }
+    pthread_sigmask(SIG_SETMASK,&oldSet,0);
+    return bytesSent;
+}
+
+/**
+ * sends as much of the queue as the socket accepts, gathering the queued
+ *   chunks into as few writes as possible.
+ *
+ * @param queue queue to send from.
+ * @param socket non-blocking socket to send to.
+ *
+ * @return 0 once the queue is empty, or the socket is full; -1 if the socket
+ *   failed. check errno for details.
+ */
+int outq_flush(OutboundQueue* queue, int socket)
+{
+    while(queue->head != 0)
+    {
+        // gather the queued chunks, up to the range of the first file chunk;
+        // that is sent on its own, once its header is
+        struct iovec iov[MAX_FLUSH_IOV];
+        int iovCount = 0;
+        int bytesSent;
+        for(OutboundChunk* chunk = queue->head;
+            chunk != 0 && iovCount < MAX_FLUSH_IOV-1; chunk = chunk->next)
+        {
+            if(chunk->frame == 0)
+            {
+                if(chunk->offset < chunk->headerLen)
+                {
+                    iov[iovCount].iov_base = chunk->header+chunk->offset;
+                    iov[iovCount].iov_len = chunk->headerLen-chunk->offset;
+                    ++iovCount;
+                }
+                break;
+            }
+            else if(chunk->offset < chunk->headerLen)
+            {
+                // rest of the chunk's own header, then the frame's payload
+                iov[iovCount].iov_base = chunk->header+chunk->offset;
+                iov[iovCount].iov_len = chunk->headerLen-chunk->offset;
+                ++iovCount;
+                iov[iovCount].iov_base = chunk->frame->data+FRAME_HEADER_LEN;
+                iov[iovCount].iov_len = chunk->frame->len-FRAME_HEADER_LEN;
+            }
+            else
+            {
+                // frame's own header, if it is sent at all, is contiguous
+                // with its payload
+                int skip = (chunk->headerLen == 0) ? 0 :
+                    FRAME_HEADER_LEN-chunk->headerLen;
+                iov[iovCount].iov_base = chunk->frame->data+skip+chunk->offset;
+                iov[iovCount].iov_len = chunk->frame->len-skip-chunk->offset;
+            }
+            ++iovCount;
+        }
+
+        // send them
+        if(iovCount == 0)
+        {
+            bytesSent = send_file_range(socket,queue->head);
+        }
+        else
+        {
+            bytesSent = send_iov(socket,iov,iovCount);
+        }
+        if(bytesSent == -1)
+        {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+
+        // free the chunks that were sent completely
+        queue->bytes -= bytesSent;
+        while(bytesSent > 0)
+        {
+            OutboundChunk* head = queue->head;
+            int headLeft = chunk_len(head)-head->offset;
+            if(bytesSent < headLeft)
+            {
+                head->offset += bytesSent;
+                break;
+            }
+            bytesSent -= headLeft;
+            queue->head = head->next;
+            free_chunk(head);
+        }
+        if(queue->head == 0)
+        {
+            queue->tail = 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * copies the bytes left in the queue, as they would be sent, without sending
+ *   or removing them; file ranges are read into the copy.
+ *
+ * @param queue queue to copy.
+ * @param buffer set to the bytes; must hold queue->bytes of them.
+ *
+ * @return 0 on success; -1 if a file can't be read, check errno for details.
+ */
+int outq_copy(OutboundQueue* queue, char* buffer)
+{
+    for(OutboundChunk* chunk = queue->head; chunk != 0; chunk = chunk->next)
+    {
+        int len = chunk_len(chunk);
+        int pos = chunk->offset;
+        while(pos < len)
+        {
+            int copied;
+            if(pos < chunk->headerLen)
+            {
+                copied = chunk->headerLen-pos;
+                memcpy(buffer,chunk->header+pos,copied);
+            }
+            else if(chunk->frame != 0)
+            {
+                // laid out as outq_flush sends it
+                int skip = (chunk->headerLen == 0) ? 0 :
+                    FRAME_HEADER_LEN-chunk->headerLen;
+                copied = len-pos;
+                memcpy(buffer,chunk->frame->data+skip+pos,copied);
+            }
+            else
+            {
+                copied = pread(chunk->file->fd,buffer,len-pos,
+                    chunk->fileOffset+pos-chunk->headerLen);
+                if(copied <= 0)
+                {
+                    if(copied == 0)
+                    {
+                        errno = EIO;
+                    }
+                    return -1;
+                }
+            }
+            buffer += copied;
+            pos += copied;
+        }
+    }
+    return 0;
+}
+
+/**
+ * sends the memory regions described by an iovec array to a socket with a
+ *   single system call. a closed peer is reported through errno instead of
+ *   raising SIGPIPE.
+ *
+ * @param socket socket to send to.
+ * @param iov array of memory regions to send, in order.
+ * @param iovCount number of entries in {iov}.
+ *
+ * @return number of bytes sent; -1 on failure. check errno for details.
+ */
+int send_iov(int socket, struct iovec* iov, int iovCount)
+{
+    struct msghdr msg;
+    memset(&msg,0,sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovCount;
+
+    int bytesSent;
+    do
+    {
+        bytesSent = sendmsg(socket,&msg,MSG_NOSIGNAL);
+    }
+    while(bytesSent == -1 && errno == EINTR);
+    return bytesSent;
+}
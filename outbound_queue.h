@@ -0,0 +1,41 @@
+#ifndef _OUTBOUND_QUEUE_H_
+#define _OUTBOUND_QUEUE_H_
+
+#include <sys/uio.h>
+
+#include "shared_frame.h"
+#include "shared_file.h"
+#include "wire_header.h"
+
+typedef struct OutboundChunk
+{
+    struct OutboundChunk* next; // chunk that is sent after this one
+    SharedFrame* frame;         // frame to send; may be shared by other queues
+    SharedFile* file;           // file to send from instead, if frame is 0
+    long fileOffset;            // position of the bytes to send in file
+    int fileLen;                // number of bytes to send from file
+    char header[WIRE_MAX_HEADER_LEN]; // sent instead of the frame's header
+    int headerLen;              // bytes in header; 0 to send the frame as is
+    int offset;                 // bytes of the chunk that are already sent
+    int sizeClass;              // size class of the chunk's pooled memory
+} OutboundChunk;
+
+typedef struct
+{
+    OutboundChunk* head;    // chunk that is sent next
+    OutboundChunk* tail;    // chunk that was queued last
+    long bytes;             // number of bytes queued, not yet sent
+} OutboundQueue;
+
+void outq_init(OutboundQueue* queue);
+void outq_destroy(OutboundQueue* queue);
+int outq_empty(OutboundQueue* queue);
+void outq_push_frame(OutboundQueue* queue, SharedFrame* frame,
+    const char* header, int headerLen, int skip);
+void outq_push_file(OutboundQueue* queue, SharedFile* file, long offset,
+    int len, const char* header, int headerLen);
+int outq_flush(OutboundQueue* queue, int socket);
+int outq_copy(OutboundQueue* queue, char* buffer);
+int send_iov(int socket, struct iovec* iov, int iovCount);
+
+#endif
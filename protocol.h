@@ -15,11 +15,63 @@
 #define SHOW_MSG 2
 
 /**
- * server sends message to client, assigning them their new user name.
+ * server sends message to client, assigning them their new user name. the
+ *   null-terminated name is followed by a byte of the CAP_ flags that the
+ *   server accepted.
  */
 #define SET_USR_NAME 3
 
 /**
- * client sends user name they want to use to the server.
+ * client sends user name they want to use to the server. the null-terminated
+ *   name may be followed by a byte of CAP_ flags that the client supports;
+ *   older clients send the name alone.
  */
 #define CHECK_USR_NAME 4
+
+/**
+ * client asks to join a chat room; the payload is the null-terminated name of
+ *   the room, which is created if it doesn't exist. the server tells every
+ *   member of the room, the new one included, with a JOIN_ROOM holding the
+ *   room's name and then the member's, each null-terminated.
+ */
+#define JOIN_ROOM 5
+
+/**
+ * client asks to leave a chat room, with the same payload as JOIN_ROOM. the
+ *   server tells the rest of the room, and the member that left, with a
+ *   LEAVE_ROOM laid out like the JOIN_ROOM one. members that disconnect leave
+ *   all their rooms.
+ */
+#define LEAVE_ROOM 6
+
+/**
+ * someone has said something in a chat room that they are a member of; the
+ *   payload is the null-terminated room name, then the null-terminated text.
+ *   the server passes it on as is to the room's other members.
+ */
+#define ROOM_MSG 7
+
+/**
+ * server asks an idle client for a sign of life; the client answers with a
+ *   PONG, with the same payload. a client that doesn't answer is disconnected
+ *   once its idle timeout is over.
+ */
+#define PING 8
+
+/**
+ * client answers a PING.
+ */
+#define PONG 9
+
+/**
+ * client asks the server for its metrics, with an empty payload; the server
+ *   answers with a STATS holding a null-terminated report, in lines of text,
+ *   that may be up to a second old.
+ */
+#define STATS 10
+
+/**
+ * capability flag; the host reads payloads compressed with WIRE_COMPRESSED,
+ *   so large ones may be sent to it that way.
+ */
+#define CAP_COMPRESSION 0x01
@@ -0,0 +1,282 @@
+#include "resolver.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static void* resolve_routine(void* params);
+static ResolverEntry lookup(const char* name);
+static unsigned long long now_ms();
+
+/**
+ * initializes a resolver with an empty cache; its helper thread isn't started
+ *   until a name has to be looked up.
+ *
+ * @param resolver resolver to initialize.
+ * @param ttl time that resolved names are cached for, in milliseconds.
+ */
+void resolver_init(Resolver* resolver, int ttl)
+{
+    pthread_mutex_init(&resolver->lock,0);
+    pthread_cond_init(&resolver->wakeup,0);
+    resolver->thread = 0;
+    resolver->stopping = 0;
+    resolver->ttl = ttl;
+    resolver->hits = 0;
+    resolver->misses = 0;
+}
+
+/**
+ * stops the helper thread, once it is done with the name that it is looking
+ *   up. callers still waiting for a name, and those that ask for one from
+ *   now on, are called back with EAI_AGAIN. calling it again does nothing.
+ *
+ * @param resolver resolver to stop.
+ */
+void resolver_stop(Resolver* resolver)
+{
+    pthread_mutex_lock(&resolver->lock);
+    if(resolver->stopping)
+    {
+        pthread_mutex_unlock(&resolver->lock);
+        return;
+    }
+    resolver->stopping = 1;
+    pthread_cond_signal(&resolver->wakeup);
+    pthread_t thread = resolver->thread;
+    pthread_mutex_unlock(&resolver->lock);
+    if(thread != 0)
+    {
+        pthread_join(thread,0);
+    }
+
+    // the callbacks are called without the lock, since they may resolve
+    // other names
+    pthread_mutex_lock(&resolver->lock);
+    resolver->thread = 0;
+    std::map<std::string,std::vector<ResolveWaiter> > waiting;
+    waiting.swap(resolver->waiting);
+    resolver->queue.clear();
+    pthread_mutex_unlock(&resolver->lock);
+    for(auto it = waiting.begin(); it != waiting.end(); ++it)
+    {
+        for(size_t i = 0; i < it->second.size(); ++i)
+        {
+            it->second[i].callback(it->second[i].arg,EAI_AGAIN,0);
+        }
+    }
+}
+
+/**
+ * stops the resolver, if it isn't stopped already, and frees it.
+ *
+ * @param resolver resolver to destroy.
+ */
+void resolver_destroy(Resolver* resolver)
+{
+    resolver_stop(resolver);
+    resolver->cache.clear();
+    pthread_cond_destroy(&resolver->wakeup);
+    pthread_mutex_destroy(&resolver->lock);
+}
+
+/**
+ * loads names from a file laid out like /etc/hosts: an IPv4 address on each
+ *   line, followed by the names that resolve to it. everything after a '#' is
+ *   a comment, and lines with other addresses are skipped. the names never
+ *   expire, and take precedence over DNS.
+ *
+ * @param resolver resolver to load into.
+ * @param path path of the file.
+ *
+ * @return number of names loaded; -1 if the file can't be read, check errno
+ *   for details.
+ */
+int resolver_load_hosts(Resolver* resolver, const char* path)
+{
+    FILE* file = fopen(path,"r");
+    if(file == 0)
+    {
+        return -1;
+    }
+
+    int numNames = 0;
+    char line[512];
+    while(fgets(line,sizeof(line),file) != 0)
+    {
+        char* comment = strchr(line,'#');
+        if(comment != 0)
+        {
+            *comment = 0;
+        }
+
+        char* save;
+        char* token = strtok_r(line," \t\r\n",&save);
+        ResolverEntry entry;
+        if(token == 0 || inet_pton(AF_INET,token,&entry.addr) != 1)
+        {
+            continue;
+        }
+        entry.result = RESOLVE_OK;
+        entry.expires = 0;
+
+        pthread_mutex_lock(&resolver->lock);
+        while((token = strtok_r(0," \t\r\n",&save)) != 0)
+        {
+            resolver->cache[token] = entry;
+            ++numNames;
+        }
+        pthread_mutex_unlock(&resolver->lock);
+    }
+    fclose(file);
+    return numNames;
+}
+
+/**
+ * resolves a host name to an address. numeric addresses, and names that are
+ *   cached, are passed to the callback right away, on the calling thread;
+ *   other names are passed to it by the helper thread once they are looked
+ *   up, so it must not block for long. may be called from any thread.
+ *
+ * @param resolver resolver to use.
+ * @param name name, or dotted address, to resolve.
+ * @param callback called with the result.
+ * @param arg passed to {callback}.
+ */
+void resolver_resolve(Resolver* resolver, const char* name,
+    ResolveCallback callback, void* arg)
+{
+    // dotted addresses need no lookup
+    struct in_addr addr;
+    if(inet_pton(AF_INET,name,&addr) == 1)
+    {
+        callback(arg,RESOLVE_OK,&addr);
+        return;
+    }
+
+    pthread_mutex_lock(&resolver->lock);
+    if(resolver->stopping)
+    {
+        pthread_mutex_unlock(&resolver->lock);
+        callback(arg,EAI_AGAIN,0);
+        return;
+    }
+
+    // answer from the cache while the entry is fresh
+    auto found = resolver->cache.find(name);
+    if(found != resolver->cache.end() && (found->second.expires == 0 ||
+        found->second.expires > now_ms()))
+    {
+        ResolverEntry entry = found->second;
+        ++resolver->hits;
+        pthread_mutex_unlock(&resolver->lock);
+        callback(arg,entry.result,(entry.result == RESOLVE_OK) ?
+            &entry.addr : 0);
+        return;
+    }
+    ++resolver->misses;
+
+    // wait for the lookup of the name, starting one if there is none yet
+    ResolveWaiter waiter;
+    waiter.callback = callback;
+    waiter.arg = arg;
+    std::vector<ResolveWaiter>& waiters = resolver->waiting[name];
+    waiters.push_back(waiter);
+    if(waiters.size() == 1)
+    {
+        resolver->queue.push_back(name);
+        if(resolver->thread == 0)
+        {
+            pthread_create(&resolver->thread,0,resolve_routine,resolver);
+        }
+        pthread_cond_signal(&resolver->wakeup);
+    }
+    pthread_mutex_unlock(&resolver->lock);
+}
+
+/**
+ * function run by the helper thread; looks up the queued names one at a time,
+ *   caches them, and calls back everyone waiting for them.
+ *
+ * @param params points to the resolver.
+ */
+static void* resolve_routine(void* params)
+{
+    Resolver* resolver = (Resolver*) params;
+
+    pthread_mutex_lock(&resolver->lock);
+    while(1)
+    {
+        while(resolver->queue.empty() && !resolver->stopping)
+        {
+            pthread_cond_wait(&resolver->wakeup,&resolver->lock);
+        }
+        if(resolver->stopping)
+        {
+            break;
+        }
+        std::string name = resolver->queue.front();
+        resolver->queue.pop_front();
+        pthread_mutex_unlock(&resolver->lock);
+
+        ResolverEntry entry = lookup(name.c_str());
+
+        pthread_mutex_lock(&resolver->lock);
+        entry.expires = now_ms()+((entry.result == RESOLVE_OK) ?
+            resolver->ttl : RESOLVER_NEGATIVE_TTL);
+        resolver->cache[name] = entry;
+        std::vector<ResolveWaiter> waiters;
+        waiters.swap(resolver->waiting[name]);
+        resolver->waiting.erase(name);
+        pthread_mutex_unlock(&resolver->lock);
+
+        for(size_t i = 0; i < waiters.size(); ++i)
+        {
+            waiters[i].callback(waiters[i].arg,entry.result,
+                (entry.result == RESOLVE_OK) ? &entry.addr : 0);
+        }
+
+        pthread_mutex_lock(&resolver->lock);
+    }
+    pthread_mutex_unlock(&resolver->lock);
+    return 0;
+}
+
+/**
+ * looks a name up with getaddrinfo; blocks for as long as that takes.
+ *
+ * @param name name to look up.
+ *
+ * @return the result, without an expiry time.
+ */
+static ResolverEntry lookup(const char* name)
+{
+    ResolverEntry entry;
+    memset(&entry,0,sizeof(entry));
+
+    struct addrinfo hints;
+    memset(&hints,0,sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* results;
+    entry.result = getaddrinfo(name,0,&hints,&results);
+    if(entry.result == RESOLVE_OK)
+    {
+        entry.addr = ((struct sockaddr_in*) results->ai_addr)->sin_addr;
+        freeaddrinfo(results);
+    }
+    return entry;
+}
+
+/**
+ * returns the current time in milliseconds.
+ */
+static unsigned long long now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return now.tv_sec*1000ULL+now.tv_nsec/1000000;
+}
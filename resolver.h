@@ -0,0 +1,84 @@
+#ifndef _RESOLVER_H_
+#define _RESOLVER_H_
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <pthread.h>
+#include <netinet/in.h>
+
+/**
+ * default time that a resolved name is cached for, in milliseconds.
+ */
+#define RESOLVER_DEFAULT_TTL (60*1000)
+
+/**
+ * time that a name that failed to resolve is cached for, in milliseconds; so
+ *   a burst of connects to a bad name costs one lookup, but a name that comes
+ *   back is retried soon.
+ */
+#define RESOLVER_NEGATIVE_TTL (5*1000)
+
+/**
+ * result of a lookup; anything else is the EAI_ error of getaddrinfo.
+ */
+#define RESOLVE_OK 0
+
+/**
+ * called with the result of a lookup, and the address if it is RESOLVE_OK.
+ */
+typedef void (*ResolveCallback)(void* arg, int result,
+    const struct in_addr* addr);
+
+/**
+ * result of a lookup, as it is cached.
+ */
+typedef struct
+{
+    int result;                 // RESOLVE_OK, or the EAI_ error
+    struct in_addr addr;        // address, if it resolved
+    unsigned long long expires; // time it expires at, in milliseconds; 0 if
+                                // it never does, like the hosts file's
+} ResolverEntry;
+
+/**
+ * someone waiting for a name to resolve.
+ */
+typedef struct
+{
+    ResolveCallback callback;
+    void* arg;
+} ResolveWaiter;
+
+/**
+ * caching resolver of host names to IPv4 addresses. names that aren't cached
+ *   are looked up with getaddrinfo by a helper thread, started on the first
+ *   miss, so the callers never block on DNS; callers that ask for a name that
+ *   is being looked up already wait for the same lookup.
+ *
+ * entries loaded from a hosts file take precedence, and never expire, so
+ *   tests can resolve names of their own without touching DNS.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;       // guards everything below
+    pthread_cond_t wakeup;      // signalled when a name is queued
+    pthread_t thread;           // helper thread; 0 until it is started
+    int stopping;               // non-zero once resolver_stop is called
+    int ttl;                    // time that resolved names are cached for
+    std::map<std::string,ResolverEntry> cache;
+    std::map<std::string,std::vector<ResolveWaiter> > waiting;
+    std::deque<std::string> queue; // names for the helper thread to look up
+    unsigned long long hits;    // lookups answered from the cache
+    unsigned long long misses;  // lookups that waited for the helper thread
+} Resolver;
+
+void resolver_init(Resolver* resolver, int ttl);
+void resolver_stop(Resolver* resolver);
+void resolver_destroy(Resolver* resolver);
+int resolver_load_hosts(Resolver* resolver, const char* path);
+void resolver_resolve(Resolver* resolver, const char* name,
+    ResolveCallback callback, void* arg);
+
+#endif
@@ -0,0 +1,199 @@
+#include "ring_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/**
+ * initializes an empty ring buffer.
+ *
+ * @param ring ring buffer to initialize.
+ * @param capacity number of bytes the buffer can hold; rounded up to a power
+ *   of two.
+ */
+void ring_init(RingBuffer* ring, unsigned int capacity)
+{
+    unsigned int roundedCapacity = 1;
+    while(roundedCapacity < capacity)
+    {
+        roundedCapacity <<= 1;
+    }
+
+    ring->data = (char*) malloc(roundedCapacity);
+    ring->capacity = roundedCapacity;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/**
+ * frees the storage of the ring buffer.
+ *
+ * @param ring ring buffer to destroy.
+ */
+void ring_destroy(RingBuffer* ring)
+{
+    free(ring->data);
+    ring->data = 0;
+    ring->capacity = 0;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/**
+ * @param ring ring buffer to query.
+ *
+ * @return number of bytes in the buffer that haven't been consumed yet.
+ */
+unsigned int ring_size(RingBuffer* ring)
+{
+    return ring->head-ring->tail;
+}
+
+/**
+ * @param ring ring buffer to query.
+ *
+ * @return number of bytes that can be written into the buffer.
+ */
+unsigned int ring_space(RingBuffer* ring)
+{
+    return ring->capacity-ring_size(ring);
+}
+
+/**
+ * does a single read from the socket into all the free space of the buffer,
+ *   including the part that wraps around to the front of the storage.
+ *
+ * @param ring ring buffer to read into.
+ * @param socket socket to read from.
+ * @param prefix optional. memory that is filled before the ring buffer is,
+ *   within the same read; used to complete a frame that is too large for the
+ *   buffer.
+ * @param prefixLen number of bytes to read into {prefix}.
+ *
+ * @return number of bytes read, including the ones read into {prefix}. 0 when
+ *   the socket is closed, and -1 on error; check errno for details.
+ */
+int ring_fill(RingBuffer* ring, int socket, void* prefix, int prefixLen)
+{
+    struct iovec iov[3];
+    int iovCount = 0;
+
+    // fill the caller's memory first, if any
+    if(prefixLen > 0)
+    {
+        iov[iovCount].iov_base = prefix;
+        iov[iovCount].iov_len = prefixLen;
+        ++iovCount;
+    }
+
+    // then fill from head to the end of the storage, then from the front of
+    // the storage to tail
+    unsigned int space = ring_space(ring);
+    unsigned int headIndex = ring->head&(ring->capacity-1);
+    unsigned int firstPart = ring->capacity-headIndex;
+    if(firstPart > space)
+    {
+        firstPart = space;
+    }
+    if(firstPart > 0)
+    {
+        iov[iovCount].iov_base = ring->data+headIndex;
+        iov[iovCount].iov_len = firstPart;
+        ++iovCount;
+    }
+    if(space-firstPart > 0)
+    {
+        iov[iovCount].iov_base = ring->data;
+        iov[iovCount].iov_len = space-firstPart;
+        ++iovCount;
+    }
+
+    int bytesRead = readv(socket,iov,iovCount);
+    if(bytesRead > prefixLen)
+    {
+        ring->head += bytesRead-prefixLen;
+    }
+    return bytesRead;
+}
+
+/**
+ * copies bytes into the free space of the buffer.
+ *
+ * @param ring ring buffer to write into.
+ * @param src bytes to copy.
+ * @param len number of bytes to copy.
+ *
+ * @return number of bytes copied; less than {len} if the buffer fills up.
+ */
+unsigned int ring_write(RingBuffer* ring, const void* src, unsigned int len)
+{
+    unsigned int space = ring_space(ring);
+    if(len > space)
+    {
+        len = space;
+    }
+
+    unsigned int headIndex = ring->head&(ring->capacity-1);
+    unsigned int firstPart = ring->capacity-headIndex;
+    if(firstPart > len)
+    {
+        firstPart = len;
+    }
+    memcpy(ring->data+headIndex,src,firstPart);
+    memcpy(ring->data,(const char*) src+firstPart,len-firstPart);
+    ring->head += len;
+    return len;
+}
+
+/**
+ * copies bytes from the front of the buffer without consuming them.
+ *
+ * @param ring ring buffer to copy from.
+ * @param dest memory to copy the bytes to.
+ * @param len number of bytes to copy; must not be more than ring_size.
+ */
+void ring_peek(RingBuffer* ring, void* dest, unsigned int len)
+{
+    unsigned int tailIndex = ring->tail&(ring->capacity-1);
+    unsigned int firstPart = ring->capacity-tailIndex;
+    if(firstPart > len)
+    {
+        firstPart = len;
+    }
+    memcpy(dest,ring->data+tailIndex,firstPart);
+    memcpy((char*) dest+firstPart,ring->data,len-firstPart);
+}
+
+/**
+ * returns a pointer to the bytes at the front of the buffer if they don't wrap
+ *   around the end of the storage.
+ *
+ * @param ring ring buffer to look into.
+ * @param len number of bytes needed; must not be more than ring_size.
+ *
+ * @return pointer to the first of {len} contiguous bytes; 0 if they wrap.
+ */
+char* ring_contiguous(RingBuffer* ring, unsigned int len)
+{
+    unsigned int tailIndex = ring->tail&(ring->capacity-1);
+    return (tailIndex+len <= ring->capacity) ? ring->data+tailIndex : 0;
+}
+
+/**
+ * discards bytes from the front of the buffer.
+ *
+ * @param ring ring buffer to consume from.
+ * @param len number of bytes to discard; must not be more than ring_size.
+ */
+void ring_consume(RingBuffer* ring, unsigned int len)
+{
+    ring->tail += len;
+
+    // rewind an empty buffer, so the next fill starts at the front of the
+    // storage and frames are less likely to wrap
+    if(ring->tail == ring->head)
+    {
+        ring->tail = 0;
+        ring->head = 0;
+    }
+}
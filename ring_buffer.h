@@ -0,0 +1,22 @@
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+typedef struct
+{
+    char* data;             // storage for the buffered bytes
+    unsigned int capacity;  // size of data; always a power of two
+    unsigned int head;      // running count of bytes written into the buffer
+    unsigned int tail;      // running count of bytes consumed from the buffer
+} RingBuffer;
+
+void ring_init(RingBuffer* ring, unsigned int capacity);
+void ring_destroy(RingBuffer* ring);
+unsigned int ring_size(RingBuffer* ring);
+unsigned int ring_space(RingBuffer* ring);
+int ring_fill(RingBuffer* ring, int socket, void* prefix, int prefixLen);
+unsigned int ring_write(RingBuffer* ring, const void* src, unsigned int len);
+void ring_peek(RingBuffer* ring, void* dest, unsigned int len);
+char* ring_contiguous(RingBuffer* ring, unsigned int len);
+void ring_consume(RingBuffer* ring, unsigned int len);
+
+#endif
@@ -0,0 +1,209 @@
+#include "room_index.h"
+
+#include <stddef.h>
+
+/**
+ * initializes an index without any rooms.
+ *
+ * @param index index to initialize.
+ */
+void rooms_init(RoomIndex* index)
+{
+    names_init(&index->names);
+}
+
+/**
+ * frees the index, and every room in it.
+ *
+ * @param index index to destroy.
+ */
+void rooms_destroy(RoomIndex* index)
+{
+    index->rooms.clear();
+    index->joined.clear();
+    names_destroy(&index->names);
+}
+
+/**
+ * finds a room by its name.
+ *
+ * @param index index to search.
+ * @param name name of the room; need not be null-terminated, and is cut short
+ *   to MAX_NAME_LEN.
+ * @param len length of {name}.
+ *
+ * @return id of the room; NO_ROOM if it doesn't exist.
+ */
+int rooms_find(RoomIndex* index, const char* name, int len)
+{
+    if(len > MAX_NAME_LEN)
+    {
+        len = MAX_NAME_LEN;
+    }
+    return (len > 0) ? names_find(&index->names,name,len) : NO_ROOM;
+}
+
+/**
+ * adds a socket to a room, creating the room if it doesn't exist.
+ *
+ * @param index index to add to.
+ * @param socket socket that joins.
+ * @param name name of the room; as for rooms_find, and must not be empty.
+ * @param len length of {name}.
+ *
+ * @return id of the room; NO_ROOM if the socket is in it already, the name is
+ *   empty, or the socket is in MAX_ROOMS_PER_SOCKET rooms already.
+ */
+int rooms_join(RoomIndex* index, int socket, const char* name, int len)
+{
+    if(len > MAX_NAME_LEN)
+    {
+        len = MAX_NAME_LEN;
+    }
+    if(len <= 0)
+    {
+        return NO_ROOM;
+    }
+    if(socket >= (int) index->joined.size())
+    {
+        index->joined.resize(socket+1);
+    }
+    std::vector<Membership>& memberships = index->joined[socket];
+    if(memberships.size() >= MAX_ROOMS_PER_SOCKET)
+    {
+        return NO_ROOM;
+    }
+
+    int room = names_find(&index->names,name,len);
+    if(room == NO_NAME)
+    {
+        room = names_claim(&index->names,name,len);
+        if(room >= (int) index->rooms.size())
+        {
+            index->rooms.resize(room+1);
+        }
+    }
+    else if(rooms_is_member(index,socket,room))
+    {
+        return NO_ROOM;
+    }
+
+    std::vector<int>& members = index->rooms[room].members;
+    Membership membership;
+    membership.room = room;
+    membership.pos = (int) members.size();
+    members.push_back(socket);
+    memberships.push_back(membership);
+    return room;
+}
+
+/**
+ * returns the socket's membership of a room; 0 if it isn't in the room.
+ */
+static Membership* find_membership(RoomIndex* index, int socket, int room)
+{
+    if(socket < 0 || socket >= (int) index->joined.size())
+    {
+        return 0;
+    }
+    std::vector<Membership>& memberships = index->joined[socket];
+    for(size_t i = 0; i < memberships.size(); ++i)
+    {
+        if(memberships[i].room == room)
+        {
+            return &memberships[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * removes a socket from a room. a room that is left empty is removed, and its
+ *   name is freed.
+ *
+ * @param index index to remove from.
+ * @param socket socket that leaves.
+ * @param room id of the room.
+ *
+ * @return number of members that the room has left; NO_ROOM if the socket
+ *   wasn't in it.
+ */
+int rooms_leave(RoomIndex* index, int socket, int room)
+{
+    Membership* membership = find_membership(index,socket,room);
+    if(membership == 0)
+    {
+        return NO_ROOM;
+    }
+
+    // move the room's last member into the leaving socket's place
+    std::vector<int>& members = index->rooms[room].members;
+    int pos = membership->pos;
+    int last = members.back();
+    members[pos] = last;
+    members.pop_back();
+    if(last != socket)
+    {
+        find_membership(index,last,room)->pos = pos;
+    }
+
+    // the socket's memberships are unordered too
+    std::vector<Membership>& memberships = index->joined[socket];
+    *membership = memberships.back();
+    memberships.pop_back();
+
+    if(members.empty())
+    {
+        std::vector<int>().swap(members);
+        names_release(&index->names,room);
+    }
+    return (int) members.size();
+}
+
+/**
+ * returns non-zero if the socket is in the room.
+ *
+ * @param index index to search.
+ * @param socket socket to look for.
+ * @param room id of the room.
+ */
+int rooms_is_member(RoomIndex* index, int socket, int room)
+{
+    return find_membership(index,socket,room) != 0;
+}
+
+/**
+ * lists the rooms that a socket is in.
+ *
+ * @param index index to search.
+ * @param socket socket to list the rooms of.
+ * @param rooms set to the ids of the rooms; must have room for
+ *   MAX_ROOMS_PER_SOCKET of them.
+ *
+ * @return number of rooms that the socket is in.
+ */
+int rooms_joined(RoomIndex* index, int socket, int* rooms)
+{
+    if(socket < 0 || socket >= (int) index->joined.size())
+    {
+        return 0;
+    }
+    std::vector<Membership>& memberships = index->joined[socket];
+    for(size_t i = 0; i < memberships.size(); ++i)
+    {
+        rooms[i] = memberships[i].room;
+    }
+    return (int) memberships.size();
+}
+
+/**
+ * returns the name of a room, null-terminated. it stays valid until a room is
+ *   created or removed.
+ *
+ * @param index index that holds the room.
+ * @param room id of the room.
+ */
+const char* rooms_name(RoomIndex* index, int room)
+{
+    return names_get(&index->names,room);
+}
@@ -0,0 +1,62 @@
+#ifndef _ROOM_INDEX_H_
+#define _ROOM_INDEX_H_
+
+#include <vector>
+
+#include "name_registry.h"
+
+/**
+ * returned by rooms_find for a room that doesn't exist, and by rooms_join and
+ *   rooms_leave when the membership doesn't change.
+ */
+#define NO_ROOM -1
+
+/**
+ * most rooms that one socket may be in at a time.
+ */
+#define MAX_ROOMS_PER_SOCKET 64
+
+/**
+ * a socket's place in a room.
+ */
+typedef struct
+{
+    int room;               // id of the room
+    int pos;                // position of the socket in the room's members
+} Membership;
+
+/**
+ * the sockets in a room, packed in no particular order.
+ */
+typedef struct
+{
+    std::vector<int> members;
+} Room;
+
+/**
+ * the chat rooms, and the sockets subscribed to each of them.
+ *
+ * a room's id is the id of its name in names; it exists for as long as it
+ *   has members. its members are a packed array, so a message to the room
+ *   touches its subscribers only. every socket keeps its memberships, with
+ *   its position in each room, so joining and leaving cost a few array
+ *   operations whatever the size of the room; a leaving socket's place is
+ *   taken by the room's last member.
+ */
+typedef struct
+{
+    NameRegistry names;                             // name of each room
+    std::vector<Room> rooms;                        // indexed by room id
+    std::vector<std::vector<Membership> > joined;   // indexed by socket
+} RoomIndex;
+
+void rooms_init(RoomIndex* index);
+void rooms_destroy(RoomIndex* index);
+int rooms_find(RoomIndex* index, const char* name, int len);
+int rooms_join(RoomIndex* index, int socket, const char* name, int len);
+int rooms_leave(RoomIndex* index, int socket, int room);
+int rooms_is_member(RoomIndex* index, int socket, int room);
+int rooms_joined(RoomIndex* index, int socket, int* rooms);
+const char* rooms_name(RoomIndex* index, int room);
+
+#endif
@@ -1,21 +1,119 @@
 #include "select_helper.h"
 
-void files_init(Files* files)
+#include <errno.h>
+#include <unistd.h>
+
+/**
+ * initializes the file set, creating the epoll instance that backs it.
+ *
+ * @param files file set to initialize.
+ * @param triggerMode FILES_LEVEL_TRIGGERED or FILES_EDGE_TRIGGERED; applies to
+ *   every file added to the set.
+ */
+void files_init(Files* files, int triggerMode)
+{
+#ifdef DEBUG
+    printf("files_init(%p,%d)\n",files,triggerMode);
+#endif
+    files->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    files->triggerMode = triggerMode;
+    files->numReady = 0;
+}
+
+/**
+ * releases the epoll instance that backs the file set. files in the set are
+ *   not closed.
+ *
+ * @param files file set to destroy.
+ */
+void files_destroy(Files* files)
 {
 #ifdef DEBUG
-    printf("files_init(%p)\n",files);
+    printf("files_destroy(%p)\n",files);
 #endif
-    FD_ZERO(&files->_selectFds);
-    files->maxFd = 0;
+    close(files->epollFd);
+    files->epollFd = -1;
+    files->fdSet.clear();
+    files->numReady = 0;
 }
 
-int files_select(Files* files)
+/**
+ * blocks until at least one file in the set is ready.
+ *
+ * @param files file set to wait on.
+ * @param timeout longest time to block for, in milliseconds; -1 to block until
+ *   a file is ready, and 0 to only check which files are ready.
+ *
+ * @return number of ready files, which can be looked up with files_ready_fd;
+ *   -1 on failure.
+ */
+int files_select(Files* files, int timeout)
 {
 #ifdef DEBUG
-    printf("files_select(%p)\n",files);
+    printf("files_select(%p,%d)\n",files,timeout);
 #endif
-    files->selectFds = files->_selectFds;
-    return select(files->maxFd+1 , &files->selectFds, 0, 0, 0);
+    int result;
+    do
+    {
+        result = epoll_wait(files->epollFd,files->readyEvents,FILES_MAX_EVENTS,timeout);
+    }
+    while(result == -1 && errno == EINTR);
+
+    files->numReady = (result == -1) ? 0 : result;
+    return result;
+}
+
+/**
+ * returns the file descriptor of a ready file from the last files_select call.
+ *
+ * @param files file set that was selected.
+ * @param index index of the ready file; must be less than the value returned
+ *   by the last files_select call.
+ *
+ * @return file descriptor of the ready file; -1 if the file has been removed
+ *   from the set since it was selected.
+ */
+int files_ready_fd(Files* files, int index)
+{
+    return files->readyEvents[index].data.fd;
+}
+
+/**
+ * returns the events that made a file ready in the last files_select call.
+ *
+ * @param files file set that was selected.
+ * @param index index of the ready file; must be less than the value returned
+ *   by the last files_select call.
+ *
+ * @return bitmask of EPOLLIN, EPOLLOUT, EPOLLRDHUP, EPOLLHUP and EPOLLERR.
+ */
+unsigned int files_ready_events(Files* files, int index)
+{
+    return files->readyEvents[index].events;
+}
+
+/**
+ * starts or stops reporting a file in the set as ready when it is writable.
+ *   unlike the other operations, this may be called from any thread.
+ *
+ * @param files file set that holds the file.
+ * @param fd file to change.
+ * @param watch non-zero to report writability; 0 to stop reporting it.
+ */
+void files_watch_writable(Files* files, int fd, int watch)
+{
+#ifdef DEBUG
+    printf("files_watch_writable(%p,%d,%d)\n",files,fd,watch);
+#endif
+    struct epoll_event event;
+    event.events = EPOLLIN|EPOLLRDHUP|(watch ? (unsigned int) EPOLLOUT : 0);
+    if(files->triggerMode == FILES_EDGE_TRIGGERED)
+    {
+        event.events |= EPOLLET;
+    }
+    event.data.fd = fd;
+
+    epoll_ctl(files->epollFd,EPOLL_CTL_MOD,fd,&event);
 }
 
 void files_add_file(Files* files, int newFd)
@@ -23,15 +121,17 @@ void files_add_file(Files* files, int newFd)
 #ifdef DEBUG
     printf("files_add_file(%p,%d)\n",files,newFd);
 #endif
-    // add the file to our sets
-    FD_SET(newFd, &files->_selectFds);
-    files->fdSet.insert(newFd);
-
-    // update maxFd if needed
-    if(newFd > files->maxFd)
+    struct epoll_event event;
+    event.events = EPOLLIN|EPOLLRDHUP;
+    if(files->triggerMode == FILES_EDGE_TRIGGERED)
     {
-        files->maxFd = newFd;
+        event.events |= EPOLLET;
     }
+    event.data.fd = newFd;
+
+    // add the file to our sets
+    epoll_ctl(files->epollFd,EPOLL_CTL_ADD,newFd,&event);
+    files->fdSet.insert(newFd);
 }
 
 void files_rm_file(Files* files, int fd)
@@ -40,19 +140,16 @@ void files_rm_file(Files* files, int fd)
     printf("files_rm_file(%p,%d)\n",files,fd);
 #endif
     // remove the file from our sets
-    FD_CLR(fd, &files->_selectFds);
+    epoll_ctl(files->epollFd,EPOLL_CTL_DEL,fd,0);
     files->fdSet.erase(fd);
 
-    // update maxFd if needed
-    if(fd == files->maxFd)
+    // drop any event still pending for the file from the last select, so a
+    // reused descriptor isn't mistaken for being ready
+    for(int i = 0; i < files->numReady; ++i)
     {
-        files->maxFd = 0;
-        for(auto fd = files->fdSet.begin(); fd != files->fdSet.end(); ++fd)
+        if(files->readyEvents[i].data.fd == fd)
         {
-            if(*fd > files->maxFd)
-            {
-                files->maxFd = *fd;
-            }
+            files->readyEvents[i].data.fd = -1;
         }
     }
 }
@@ -2,19 +2,42 @@
 #define _SELECT_HELPER_H_
 
 #include <stdio.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <set>
 
+/**
+ * maximum number of ready events that a single call to files_select returns.
+ *   any events beyond this are reported by the next call.
+ */
+#define FILES_MAX_EVENTS 256
+
+/**
+ * files are watched in level-triggered mode; a file is reported as ready by
+ *   every files_select call for as long as it has unread data.
+ */
+#define FILES_LEVEL_TRIGGERED 0
+
+/**
+ * files are watched in edge-triggered mode; a file is reported as ready only
+ *   when new data arrives, so the caller must drain it until EAGAIN.
+ */
+#define FILES_EDGE_TRIGGERED 1
+
 typedef struct
 {
     std::set<int> fdSet;    // set of all file descriptors
-    fd_set _selectFds;      // set of all file descriptors for internal uses
-    fd_set selectFds;       // set of selected file descriptors
-    int maxFd;              // integer corresponding to biggest file descriptor
+    int epollFd;            // epoll instance watching all file descriptors
+    int triggerMode;        // FILES_LEVEL_TRIGGERED or FILES_EDGE_TRIGGERED
+    int numReady;           // number of ready events from the last select
+    struct epoll_event readyEvents[FILES_MAX_EVENTS]; // events from last select
 } Files;
 
-void files_init(Files* files);
-int files_select(Files* files);
+void files_init(Files* files, int triggerMode = FILES_LEVEL_TRIGGERED);
+void files_destroy(Files* files);
+int files_select(Files* files, int timeout = -1);
+int files_ready_fd(Files* files, int index);
+unsigned int files_ready_events(Files* files, int index);
+void files_watch_writable(Files* files, int fd, int watch);
 void files_add_file(Files* files, int newFd);
 void files_rm_file(Files* files, int fd);
 
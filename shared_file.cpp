@@ -0,0 +1,46 @@
+#include "shared_file.h"
+
+#include <unistd.h>
+
+/**
+ * takes ownership of an open file, so it can be shared. the caller owns the
+ *   only reference to it.
+ *
+ * @param fd the open file; closed along with the last reference.
+ *
+ * @return the shared file.
+ */
+SharedFile* file_share(int fd)
+{
+    SharedFile* file = new SharedFile;
+    file->refs.store(1,std::memory_order_relaxed);
+    file->fd = fd;
+    return file;
+}
+
+/**
+ * adds a reference to the file.
+ *
+ * @param file file to retain.
+ *
+ * @return the file.
+ */
+SharedFile* file_retain(SharedFile* file)
+{
+    file->refs.fetch_add(1,std::memory_order_relaxed);
+    return file;
+}
+
+/**
+ * drops a reference to the file, closing it once nothing refers to it.
+ *
+ * @param file file to release.
+ */
+void file_release(SharedFile* file)
+{
+    if(file->refs.fetch_sub(1,std::memory_order_acq_rel) == 1)
+    {
+        close(file->fd);
+        delete file;
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef _SHARED_FILE_H_
+#define _SHARED_FILE_H_
+
+#include <atomic>
+
+/**
+ * an open file that frames are sent straight out of, with sendfile. it stays
+ *   open for as long as a send queue refers to it, even after its owner is
+ *   done with it, and its name is removed.
+ */
+typedef struct SharedFile
+{
+    std::atomic<int> refs;  // number of owners; closed when it drops to 0
+    int fd;                 // the open file
+} SharedFile;
+
+SharedFile* file_share(int fd);
+SharedFile* file_retain(SharedFile* file);
+void file_release(SharedFile* file);
+
+#endif
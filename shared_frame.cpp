@@ -0,0 +1,175 @@
+#include "shared_frame.h"
+#include "buffer_pool.h"
+#include "lz_block.h"
+
+#include <new>
+#include <string.h>
+
+/**
+ * number of bytes in front of a compressed payload, holding the length that
+ *   it expands to, little-endian.
+ */
+#define PACKED_PREFIX_LEN 4
+
+/**
+ * encodes a message into a new immutable frame, ready to be sent to any number
+ *   of sockets. the caller owns the only reference to it.
+ *
+ * @param msg message to encode.
+ *
+ * @return the encoded frame; 0 if it couldn't be allocated.
+ */
+SharedFrame* frame_encode(const Net::Message& msg)
+{
+    SharedFrame* frame = frame_alloc(FRAME_HEADER_LEN+msg.len);
+    if(frame == 0)
+    {
+        return 0;
+    }
+    frame_write_header(frame,msg.type,msg.len);
+    memcpy(frame->data+FRAME_HEADER_LEN,msg.data,msg.len);
+    return frame;
+}
+
+/**
+ * compresses a message's payload into a new immutable frame, which is sent
+ *   with the WIRE_COMPRESSED flag. its header holds the message's type and
+ *   the compressed length. the caller owns the only reference to it.
+ *
+ * @param msg message to compress.
+ *
+ * @return the compressed frame; 0 if the payload doesn't get any smaller,
+ *   or it couldn't be allocated.
+ */
+SharedFrame* frame_compress(const Net::Message& msg)
+{
+    SharedFrame* frame = frame_alloc(FRAME_HEADER_LEN+msg.len);
+    if(frame == 0)
+    {
+        return 0;
+    }
+    unsigned char* prefix =
+        (unsigned char*) frame->data+FRAME_HEADER_LEN;
+    int packedLen = lz_compress((const char*) msg.data,msg.len,
+        (char*) prefix+PACKED_PREFIX_LEN,msg.len-PACKED_PREFIX_LEN-1);
+    if(packedLen == 0)
+    {
+        frame_release(frame);
+        return 0;
+    }
+
+    for(int i = 0; i < PACKED_PREFIX_LEN; ++i)
+    {
+        prefix[i] = (unsigned char) (msg.len >> (i*8));
+    }
+    frame->len = FRAME_HEADER_LEN+PACKED_PREFIX_LEN+packedLen;
+    frame_write_header(frame,msg.type,PACKED_PREFIX_LEN+packedLen);
+    return frame;
+}
+
+/**
+ * expands a payload made by frame_compress into a new frame. the caller owns
+ *   the only reference to it.
+ *
+ * @param type type of the message.
+ * @param data compressed payload, as received.
+ * @param len number of bytes of {data}.
+ *
+ * @return the expanded frame; 0 if the payload is invalid, or the frame
+ *   couldn't be allocated.
+ */
+SharedFrame* frame_decompress(int type, const void* data, int len)
+{
+    const unsigned char* prefix = (const unsigned char*) data;
+    if(len < PACKED_PREFIX_LEN)
+    {
+        return 0;
+    }
+    unsigned int unpackedLen = 0;
+    for(int i = 0; i < PACKED_PREFIX_LEN; ++i)
+    {
+        unpackedLen |= (unsigned int) prefix[i] << (i*8);
+    }
+    if(unpackedLen > FRAME_MAX_UNPACKED_LEN)
+    {
+        return 0;
+    }
+
+    SharedFrame* frame = frame_alloc(FRAME_HEADER_LEN+unpackedLen);
+    if(frame == 0)
+    {
+        return 0;
+    }
+    frame_write_header(frame,type,unpackedLen);
+    if(lz_decompress((const char*) prefix+PACKED_PREFIX_LEN,
+        len-PACKED_PREFIX_LEN,frame->data+FRAME_HEADER_LEN,unpackedLen)
+        != (int) unpackedLen)
+    {
+        frame_release(frame);
+        return 0;
+    }
+    return frame;
+}
+
+/**
+ * allocates an uninitialized frame from the buffer pool. the caller owns the
+ *   only reference to it, and fills in its data before sharing it.
+ *
+ * @param len number of bytes of data in the frame.
+ *
+ * @return the new frame; 0 if it couldn't be allocated.
+ */
+SharedFrame* frame_alloc(int len)
+{
+    int sizeClass;
+    SharedFrame* frame = (SharedFrame*) pool_alloc(sizeof(SharedFrame)+len,
+        &sizeClass);
+    if(frame == 0)
+    {
+        return 0;
+    }
+    new (&frame->refs) std::atomic<int>(1);
+    frame->sizeClass = sizeClass;
+    frame->len = len;
+    return frame;
+}
+
+/**
+ * writes the header of a frame's message in front of its payload.
+ *
+ * @param frame frame to write to.
+ * @param type type of the message.
+ * @param len length of the message's payload.
+ */
+void frame_write_header(SharedFrame* frame, int type, int len)
+{
+    memcpy(frame->data,&type,sizeof(type));
+    memcpy(frame->data+sizeof(type),&len,sizeof(len));
+}
+
+/**
+ * adds a reference to the frame.
+ *
+ * @param frame frame to reference.
+ *
+ * @return {frame}.
+ */
+SharedFrame* frame_retain(SharedFrame* frame)
+{
+    frame->refs.fetch_add(1,std::memory_order_relaxed);
+    return frame;
+}
+
+/**
+ * drops a reference to the frame, returning it to the buffer pool once nothing
+ *   refers to it.
+ *
+ * @param frame frame to release.
+ */
+void frame_release(SharedFrame* frame)
+{
+    if(frame->refs.fetch_sub(1,std::memory_order_acq_rel) == 1)
+    {
+        pool_free(frame,frame->sizeClass);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef _SHARED_FRAME_H_
+#define _SHARED_FRAME_H_
+
+#include <atomic>
+
+#include "Message.h"
+
+/**
+ * number of bytes in a frame's header; its type and len fields. frames are
+ *   kept in WIRE_V0 form, and peers that use another framing are sent the
+ *   payload behind a header of their own.
+ */
+#define FRAME_HEADER_LEN ((int) (sizeof(int)+sizeof(int)))
+
+/**
+ * largest payload that a compressed frame may expand to; larger ones are
+ *   invalid, so a small frame can't make the receiver allocate without bound.
+ */
+#define FRAME_MAX_UNPACKED_LEN (16*1024*1024)
+
+/**
+ * largest payload that a received frame may have; larger ones are invalid, so
+ *   a peer can't make the receiver allocate without bound, or overflow the
+ *   size of the buffer that holds the frame.
+ */
+#define FRAME_MAX_LEN FRAME_MAX_UNPACKED_LEN
+
+typedef struct SharedFrame
+{
+    std::atomic<int> refs;  // number of owners; pooled when it drops to 0
+    int sizeClass;          // size class of the frame's pooled memory
+    int len;                // number of bytes in data
+    char data[1];           // frame bytes; allocated to len bytes
+} SharedFrame;
+
+SharedFrame* frame_encode(const Net::Message& msg);
+SharedFrame* frame_compress(const Net::Message& msg);
+SharedFrame* frame_decompress(int type, const void* data, int len);
+SharedFrame* frame_alloc(int len);
+void frame_write_header(SharedFrame* frame, int type, int len);
+SharedFrame* frame_retain(SharedFrame* frame);
+void frame_release(SharedFrame* frame);
+
+#endif
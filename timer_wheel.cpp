@@ -0,0 +1,279 @@
+#include "timer_wheel.h"
+
+#include <string.h>
+
+/**
+ * mask of a slot number within a level.
+ */
+#define SLOT_MASK (WHEEL_SLOTS-1)
+
+/**
+ * initializes a wheel without any timers.
+ *
+ * @param wheel wheel to initialize.
+ * @param now current tick.
+ * @param context passed to the callback of every timer that fires.
+ */
+void wheel_init(TimerWheel* wheel, unsigned long long now, void* context)
+{
+    memset(wheel->slots,0,sizeof(wheel->slots));
+    wheel->now = now;
+    wheel->count = 0;
+    wheel->context = context;
+}
+
+/**
+ * initializes a timer that isn't armed.
+ *
+ * @param timer timer to initialize.
+ * @param callback called with the wheel's context, and {arg}, when the timer
+ *   fires. it may arm the timer again, or arm and cancel any other.
+ * @param arg passed to {callback}.
+ */
+void wheel_timer_init(Timer* timer, void (*callback)(void*, void*),
+    void* arg)
+{
+    timer->next = 0;
+    timer->link = 0;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+/**
+ * puts an armed timer in the slot for its tick.
+ */
+static void insert_timer(TimerWheel* wheel, Timer* timer)
+{
+    unsigned long long expires = timer->expires;
+    if(expires < wheel->now)
+    {
+        expires = wheel->now;
+    }
+    unsigned long long delay = expires-wheel->now;
+
+    // the lowest level whose span reaches the tick
+    int level = 0;
+    while(level < WHEEL_LEVELS-1 &&
+        delay >= (1ULL << ((level+1)*WHEEL_SLOT_BITS)))
+    {
+        ++level;
+    }
+    Timer** slot = &wheel->slots[level]
+        [(expires >> (level*WHEEL_SLOT_BITS))&SLOT_MASK];
+
+    timer->next = *slot;
+    if(*slot != 0)
+    {
+        (*slot)->link = &timer->next;
+    }
+    *slot = timer;
+    timer->link = slot;
+}
+
+/**
+ * arms a timer to fire at a tick, or moves it there if it is armed already.
+ *   a tick that has passed fires at the next advance.
+ *
+ * @param wheel wheel to arm the timer in.
+ * @param timer timer to arm.
+ * @param expires tick to fire at; at most WHEEL_MAX_DELAY from now.
+ */
+void wheel_arm(TimerWheel* wheel, Timer* timer, unsigned long long expires)
+{
+    if(timer->link != 0)
+    {
+        wheel_cancel(wheel,timer);
+    }
+    if(expires > wheel->now+WHEEL_MAX_DELAY)
+    {
+        expires = wheel->now+WHEEL_MAX_DELAY;
+    }
+    timer->expires = expires;
+    insert_timer(wheel,timer);
+    ++wheel->count;
+}
+
+/**
+ * disarms a timer, if it is armed.
+ *
+ * @param wheel wheel that the timer is armed in.
+ * @param timer timer to disarm.
+ */
+void wheel_cancel(TimerWheel* wheel, Timer* timer)
+{
+    if(timer->link == 0)
+    {
+        return;
+    }
+    *timer->link = timer->next;
+    if(timer->next != 0)
+    {
+        timer->next->link = timer->link;
+    }
+    timer->next = 0;
+    timer->link = 0;
+    --wheel->count;
+}
+
+/**
+ * @return non-zero if the timer is armed.
+ */
+int wheel_armed(Timer* timer)
+{
+    return timer->link != 0;
+}
+
+/**
+ * moves the timers of a slot of an upper level down to the levels below it,
+ *   now that its span has come.
+ */
+static void cascade(TimerWheel* wheel, int level)
+{
+    int index = (wheel->now >> (level*WHEEL_SLOT_BITS))&SLOT_MASK;
+    Timer* timer = wheel->slots[level][index];
+    wheel->slots[level][index] = 0;
+    while(timer != 0)
+    {
+        Timer* next = timer->next;
+        insert_timer(wheel,timer);
+        timer = next;
+    }
+}
+
+/**
+ * fires every timer whose tick has come, in order of their ticks.
+ *
+ * @param wheel wheel to advance.
+ * @param now current tick.
+ *
+ * @return number of timers fired.
+ */
+int wheel_advance(TimerWheel* wheel, unsigned long long now)
+{
+    int numFired = 0;
+    while(wheel->now <= now)
+    {
+        if(wheel->count == 0)
+        {
+            // nothing to fire, or move down, on the way
+            wheel->now = now+1;
+            break;
+        }
+
+        // bring down the timers of every level whose next span starts here
+        for(int level = 1; level < WHEEL_LEVELS; ++level)
+        {
+            if(((wheel->now >> ((level-1)*WHEEL_SLOT_BITS))&SLOT_MASK) != 0)
+            {
+                break;
+            }
+            cascade(wheel,level);
+        }
+
+        // take the tick's timers before firing them, so timers that their
+        // callbacks arm for this tick fire at the next one instead
+        Timer** slot = &wheel->slots[0][wheel->now&SLOT_MASK];
+        Timer* timer = *slot;
+        *slot = 0;
+        if(timer != 0)
+        {
+            timer->link = &timer;
+        }
+        ++wheel->now;
+
+        while(timer != 0)
+        {
+            Timer* fired = timer;
+            timer = fired->next;
+            if(timer != 0)
+            {
+                timer->link = &timer;
+            }
+            fired->next = 0;
+            fired->link = 0;
+            --wheel->count;
+            ++numFired;
+            fired->callback(wheel->context,fired->arg);
+        }
+    }
+    return numFired;
+}
+
+/**
+ * returns the next tick that the wheel has to be advanced to, to bound how
+ *   long to wait on I/O: the first tick with timers to fire in the next
+ *   WHEEL_SLOTS ticks, or the tick that a slot of an upper level comes due
+ *   at, if that is sooner; advancing to that only moves the slot's timers
+ *   down.
+ *
+ * @param wheel wheel to check.
+ *
+ * @return the tick; -1 if no timer is armed.
+ */
+long long wheel_next_expiry(TimerWheel* wheel)
+{
+    if(wheel->count == 0)
+    {
+        return -1;
+    }
+
+    // the lowest level holds exactly the next WHEEL_SLOTS ticks
+    long long nearest = -1;
+    for(int i = 0; i < WHEEL_SLOTS; ++i)
+    {
+        if(wheel->slots[0][(wheel->now+i)&SLOT_MASK] != 0)
+        {
+            nearest = (long long) (wheel->now+i);
+            break;
+        }
+    }
+
+    // a slot of an upper level may cascade before then
+    for(int level = 1; level < WHEEL_LEVELS; ++level)
+    {
+        // slots cascade at the multiples of their span, starting with the
+        // first one that hasn't been advanced past yet
+        int shift = level*WHEEL_SLOT_BITS;
+        unsigned long long base =
+            (wheel->now+(1ULL << shift)-1) >> shift;
+        for(int i = 0; i < WHEEL_SLOTS; ++i)
+        {
+            if(wheel->slots[level][(base+i)&SLOT_MASK] != 0)
+            {
+                long long due = (long long) ((base+i) << shift);
+                if(nearest == -1 || due < nearest)
+                {
+                    nearest = due;
+                }
+                break;
+            }
+        }
+    }
+    return nearest;
+}
+
+/**
+ * disarms and returns any armed timer, without firing it; to empty a wheel
+ *   whose timers own memory.
+ *
+ * @param wheel wheel to take from.
+ *
+ * @return the timer; 0 if no timer is armed.
+ */
+Timer* wheel_take(TimerWheel* wheel)
+{
+    for(int level = 0; level < WHEEL_LEVELS && wheel->count > 0; ++level)
+    {
+        for(int i = 0; i < WHEEL_SLOTS; ++i)
+        {
+            Timer* timer = wheel->slots[level][i];
+            if(timer != 0)
+            {
+                wheel_cancel(wheel,timer);
+                return timer;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+/**
+ * number of levels in a wheel, and of slots in each level; a level's slot
+ *   spans all the slots of the level below it.
+ */
+#define WHEEL_LEVELS 4
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+
+/**
+ * furthest ahead that a timer can be armed, in ticks; timers armed further
+ *   ahead fire this many ticks from now, and should be armed again then.
+ */
+#define WHEEL_MAX_DELAY ((1ULL << (WHEEL_LEVELS*WHEEL_SLOT_BITS))-1)
+
+/**
+ * something to do at a tick. the memory of a timer is the caller's, typically
+ *   part of what it acts on, so arming it allocates nothing.
+ */
+typedef struct Timer
+{
+    struct Timer* next;         // next timer in the same slot
+    struct Timer** link;        // pointer that points at this timer; 0 while
+                                // it isn't armed
+    unsigned long long expires; // tick that the timer fires at
+    void (*callback)(void* context, void* arg); // called when it fires
+    void* arg;                  // passed to callback
+} Timer;
+
+/**
+ * hierarchical timing wheel; the timers to fire in the next WHEEL_SLOTS ticks
+ *   are kept by tick in the lowest level, and later ones in coarser slots of
+ *   the levels above, which are moved down a level as their time comes. so
+ *   arming and cancelling a timer are a few pointer operations, and each tick
+ *   only touches the timers that fire in it, or move down in it.
+ */
+typedef struct
+{
+    Timer* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    unsigned long long now;     // next tick whose timers haven't fired
+    int count;                  // number of armed timers
+    void* context;              // passed to every callback
+} TimerWheel;
+
+void wheel_init(TimerWheel* wheel, unsigned long long now, void* context);
+void wheel_timer_init(Timer* timer, void (*callback)(void*, void*),
+    void* arg);
+void wheel_arm(TimerWheel* wheel, Timer* timer, unsigned long long expires);
+void wheel_cancel(TimerWheel* wheel, Timer* timer);
+int wheel_armed(Timer* timer);
+int wheel_advance(TimerWheel* wheel, unsigned long long now);
+long long wheel_next_expiry(TimerWheel* wheel);
+Timer* wheel_take(TimerWheel* wheel);
+
+#endif
@@ -0,0 +1,385 @@
+#include "uring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return (int) syscall(__NR_io_uring_setup,entries,params);
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+    unsigned flags, void* arg, size_t argSize)
+{
+    return (int) syscall(__NR_io_uring_enter,fd,toSubmit,minComplete,flags,
+        arg,argSize);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void* arg,
+    unsigned numArgs)
+{
+    return (int) syscall(__NR_io_uring_register,fd,opcode,arg,numArgs);
+}
+
+/**
+ * returns non-zero if the running kernel supports everything that the io_uring
+ *   backend uses: multishot receives into provided buffer rings, and
+ *   multishot accepts. these first appeared together in Linux 6.0, along with
+ *   IORING_OP_SEND_ZC, which is what is probed for.
+ */
+int uring_supported()
+{
+    Uring ring;
+    if(uring_init(&ring,4,1,64) == -1)
+    {
+        return 0;
+    }
+
+    int numOps = IORING_OP_SEND_ZC+1;
+    size_t probeSize = sizeof(struct io_uring_probe)+
+        numOps*sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe =
+        (struct io_uring_probe*) calloc(1,probeSize);
+    int supported = io_uring_register(ring.fd,IORING_REGISTER_PROBE,probe,
+        numOps) == 0 && probe->last_op >= IORING_OP_SEND_ZC;
+    free(probe);
+
+    uring_destroy(&ring);
+    return supported;
+}
+
+/**
+ * creates an io_uring instance, and gives it a ring of buffers for receives
+ *   to pick from.
+ *
+ * @param ring ring to initialize.
+ * @param entries number of submission queue entries; a power of two.
+ * @param numBuffers number of provided buffers; a power of two, or 0 if
+ *   nothing is received with the ring.
+ * @param bufferSize size of each provided buffer.
+ *
+ * @return 0 on success; -1 on failure, check errno for details.
+ */
+int uring_init(Uring* ring, unsigned entries, int numBuffers, int bufferSize)
+{
+    memset(ring,0,sizeof(*ring));
+
+    struct io_uring_params params;
+    memset(&params,0,sizeof(params));
+    if((ring->fd = io_uring_setup(entries,&params)) == -1)
+    {
+        return -1;
+    }
+
+    // map the submission and completion queues
+    ring->sqRingSize = params.sq_off.array+params.sq_entries*sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes+
+        params.cq_entries*sizeof(struct io_uring_cqe);
+    ring->sqesSize = params.sq_entries*sizeof(struct io_uring_sqe);
+    ring->sqRing = mmap(0,ring->sqRingSize,PROT_READ|PROT_WRITE,
+        MAP_SHARED|MAP_POPULATE,ring->fd,IORING_OFF_SQ_RING);
+    ring->cqRing = mmap(0,ring->cqRingSize,PROT_READ|PROT_WRITE,
+        MAP_SHARED|MAP_POPULATE,ring->fd,IORING_OFF_CQ_RING);
+    ring->sqes = (struct io_uring_sqe*) mmap(0,ring->sqesSize,
+        PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,ring->fd,
+        IORING_OFF_SQES);
+    if(ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED ||
+        ring->sqes == MAP_FAILED)
+    {
+        uring_destroy(ring);
+        return -1;
+    }
+
+    char* sq = (char*) ring->sqRing;
+    ring->sqHead = (unsigned*) (sq+params.sq_off.head);
+    ring->sqTail = (unsigned*) (sq+params.sq_off.tail);
+    ring->sqMask = (unsigned*) (sq+params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*) (sq+params.sq_off.array);
+    char* cq = (char*) ring->cqRing;
+    ring->cqHead = (unsigned*) (cq+params.cq_off.head);
+    ring->cqTail = (unsigned*) (cq+params.cq_off.tail);
+    ring->cqMask = (unsigned*) (cq+params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq+params.cq_off.cqes);
+
+    // register the provided buffer ring, and hand it every buffer
+    if(numBuffers == 0)
+    {
+        return 0;
+    }
+    ring->numBuffers = numBuffers;
+    ring->bufferSize = bufferSize;
+    ring->bufRingSize = numBuffers*sizeof(struct io_uring_buf);
+    ring->bufRing = (struct io_uring_buf*) mmap(0,ring->bufRingSize,
+        PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+    ring->buffers = (char*) malloc((size_t) numBuffers*bufferSize);
+    if(ring->bufRing == MAP_FAILED || ring->buffers == 0)
+    {
+        uring_destroy(ring);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg,0,sizeof(reg));
+    reg.ring_addr = (unsigned long long) ring->bufRing;
+    reg.ring_entries = numBuffers;
+    reg.bgid = URING_BUFFER_GROUP;
+    if(io_uring_register(ring->fd,IORING_REGISTER_PBUF_RING,&reg,1) == -1)
+    {
+        uring_destroy(ring);
+        return -1;
+    }
+    for(int i = 0; i < numBuffers; ++i)
+    {
+        uring_recycle_buffer(ring,i);
+    }
+
+    return 0;
+}
+
+/**
+ * closes the io_uring instance, cancelling everything still in flight, and
+ *   frees its buffers.
+ *
+ * @param ring ring to destroy.
+ */
+void uring_destroy(Uring* ring)
+{
+    if(ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+    if(ring->sqRing != 0 && ring->sqRing != MAP_FAILED)
+    {
+        munmap(ring->sqRing,ring->sqRingSize);
+    }
+    if(ring->cqRing != 0 && ring->cqRing != MAP_FAILED)
+    {
+        munmap(ring->cqRing,ring->cqRingSize);
+    }
+    if(ring->sqes != 0 && ring->sqes != MAP_FAILED)
+    {
+        munmap(ring->sqes,ring->sqesSize);
+    }
+    if(ring->bufRing != 0 && ring->bufRing != MAP_FAILED)
+    {
+        munmap(ring->bufRing,ring->bufRingSize);
+    }
+    free(ring->buffers);
+    memset(ring,0,sizeof(*ring));
+    ring->fd = -1;
+}
+
+/**
+ * returns a cleared submission queue entry to fill in. if the queue is full,
+ *   the entries queued so far are submitted first.
+ *
+ * @param ring ring to queue the entry on.
+ *
+ * @return the entry; it is submitted by the next uring_submit.
+ */
+struct io_uring_sqe* uring_get_sqe(Uring* ring)
+{
+    unsigned tail = *ring->sqTail;
+    while(tail-__atomic_load_n(ring->sqHead,__ATOMIC_ACQUIRE) > *ring->sqMask)
+    {
+        uring_submit(ring,0);
+    }
+
+    unsigned index = tail&*ring->sqMask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe,0,sizeof(*sqe));
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail,tail+1,__ATOMIC_RELEASE);
+    ++ring->numUnsubmitted;
+    return sqe;
+}
+
+/**
+ * submits every queued entry, and waits for completions, all in one system
+ *   call.
+ *
+ * @param ring ring to submit on.
+ * @param waitFor number of completions to wait for; 0 to return right away.
+ *
+ * @return number of entries submitted; -1 on failure, check errno for details.
+ */
+int uring_submit(Uring* ring, unsigned waitFor)
+{
+    int result;
+    do
+    {
+        result = io_uring_enter(ring->fd,ring->numUnsubmitted,waitFor,
+            waitFor ? IORING_ENTER_GETEVENTS : 0,0,0);
+    }
+    while(result == -1 && errno == EINTR);
+
+    if(result > 0)
+    {
+        ring->numUnsubmitted -= result;
+    }
+    return result;
+}
+
+/**
+ * submits every queued entry, and waits for completions for no longer than a
+ *   timeout, all in one system call; the timeout doesn't take up an entry,
+ *   unlike a timeout request.
+ *
+ * @param ring ring to submit on.
+ * @param waitFor number of completions to wait for.
+ * @param timeout longest time to wait for.
+ *
+ * @return number of entries submitted, which is 0 if nothing was queued and
+ *   the wait timed out; -1 on failure, check errno for details.
+ */
+int uring_submit_timeout(Uring* ring, unsigned waitFor,
+    struct __kernel_timespec* timeout)
+{
+    struct io_uring_getevents_arg arg;
+    memset(&arg,0,sizeof(arg));
+    arg.ts = (unsigned long long) (uintptr_t) timeout;
+
+    int result;
+    do
+    {
+        result = io_uring_enter(ring->fd,ring->numUnsubmitted,waitFor,
+            IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG,&arg,sizeof(arg));
+    }
+    while(result == -1 && errno == EINTR);
+
+    if(result == -1 && errno == ETIME)
+    {
+        result = 0;
+    }
+    if(result > 0)
+    {
+        ring->numUnsubmitted -= result;
+    }
+    return result;
+}
+
+/**
+ * returns the oldest completion that hasn't been seen yet, or 0 if there is
+ *   none. uring_cqe_seen must be called before peeking again.
+ */
+struct io_uring_cqe* uring_peek_cqe(Uring* ring)
+{
+    unsigned head = *ring->cqHead;
+    if(head == __atomic_load_n(ring->cqTail,__ATOMIC_ACQUIRE))
+    {
+        return 0;
+    }
+    return &ring->cqes[head&*ring->cqMask];
+}
+
+/**
+ * hands the completion returned by uring_peek_cqe back to the kernel.
+ */
+void uring_cqe_seen(Uring* ring)
+{
+    __atomic_store_n(ring->cqHead,*ring->cqHead+1,__ATOMIC_RELEASE);
+}
+
+/**
+ * returns the memory of a provided buffer that a receive picked.
+ *
+ * @param ring ring that owns the buffer.
+ * @param bufferId id from the completion's flags.
+ */
+char* uring_buffer(Uring* ring, int bufferId)
+{
+    return ring->buffers+(size_t) bufferId*ring->bufferSize;
+}
+
+/**
+ * gives a provided buffer back to the kernel, once its data has been used.
+ *
+ * @param ring ring that owns the buffer.
+ * @param bufferId id of the buffer.
+ */
+void uring_recycle_buffer(Uring* ring, int bufferId)
+{
+    // the ring's tail overlays the reserved field of its first entry; struct
+    // io_uring_buf_ring's flexible array doesn't lay out the same in C++
+    unsigned short* tail = &ring->bufRing[0].resv;
+    struct io_uring_buf* buf =
+        &ring->bufRing[*tail&(ring->numBuffers-1)];
+    buf->addr = (unsigned long long) uring_buffer(ring,bufferId);
+    buf->len = ring->bufferSize;
+    buf->bid = bufferId;
+    __atomic_store_n(tail,(unsigned short) (*tail+1),__ATOMIC_RELEASE);
+}
+
+/**
+ * accepts connections on a listening socket until it fails; each connection
+ *   completes with the accepted socket.
+ */
+void uring_prep_accept_multishot(struct io_uring_sqe* sqe, int socket,
+    unsigned long long userData)
+{
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = userData;
+}
+
+/**
+ * receives from a socket until it closes, or runs out of provided buffers;
+ *   each receive completes with the number of bytes put into a buffer of
+ *   URING_BUFFER_GROUP.
+ */
+void uring_prep_recv_multishot(struct io_uring_sqe* sqe, int socket,
+    unsigned long long userData)
+{
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = userData;
+}
+
+/**
+ * waits for a file to become ready for any of the poll events; a multishot
+ *   poll completes every time it does.
+ */
+void uring_prep_poll(struct io_uring_sqe* sqe, int fd, unsigned events,
+    int multishot, unsigned long long userData)
+{
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = userData;
+}
+
+/**
+ * cancels every request in flight on a file, so it can be closed.
+ */
+void uring_prep_cancel_fd(struct io_uring_sqe* sqe, int fd,
+    unsigned long long userData)
+{
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD|IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = userData;
+}
+
+/**
+ * completes with -ETIME once the timeout has passed. the timeout is read when
+ *   the entry is submitted, so it only has to live until then.
+ */
+void uring_prep_timeout(struct io_uring_sqe* sqe,
+    struct __kernel_timespec* timeout, unsigned long long userData)
+{
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (unsigned long long) timeout;
+    sqe->len = 1;
+    sqe->user_data = userData;
+}
@@ -0,0 +1,65 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/**
+ * id of the group of provided buffers that receives pick their memory from.
+ */
+#define URING_BUFFER_GROUP 0
+
+/**
+ * io_uring instance, driven with raw system calls. a ring must only be used by
+ *   one thread at a time.
+ */
+typedef struct
+{
+    int fd;                         // the io_uring instance
+    void* sqRing;                   // mapped submission queue ring
+    size_t sqRingSize;
+    void* cqRing;                   // mapped completion queue ring
+    size_t cqRingSize;
+    struct io_uring_sqe* sqes;      // mapped submission queue entries
+    size_t sqesSize;
+    unsigned* sqHead;               // advanced by the kernel
+    unsigned* sqTail;               // advanced by uring_get_sqe
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;               // advanced by uring_cqe_seen
+    unsigned* cqTail;               // advanced by the kernel
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned numUnsubmitted;        // entries queued since the last submit
+
+    struct io_uring_buf* bufRing;   // ring of buffers given to the kernel
+    size_t bufRingSize;
+    char* buffers;                  // memory of the provided buffers
+    int numBuffers;                 // always a power of two
+    int bufferSize;
+} Uring;
+
+int uring_supported();
+int uring_init(Uring* ring, unsigned entries, int numBuffers, int bufferSize);
+void uring_destroy(Uring* ring);
+struct io_uring_sqe* uring_get_sqe(Uring* ring);
+int uring_submit(Uring* ring, unsigned waitFor);
+int uring_submit_timeout(Uring* ring, unsigned waitFor,
+    struct __kernel_timespec* timeout);
+struct io_uring_cqe* uring_peek_cqe(Uring* ring);
+void uring_cqe_seen(Uring* ring);
+char* uring_buffer(Uring* ring, int bufferId);
+void uring_recycle_buffer(Uring* ring, int bufferId);
+
+void uring_prep_accept_multishot(struct io_uring_sqe* sqe, int socket,
+    unsigned long long userData);
+void uring_prep_recv_multishot(struct io_uring_sqe* sqe, int socket,
+    unsigned long long userData);
+void uring_prep_poll(struct io_uring_sqe* sqe, int fd, unsigned events,
+    int multishot, unsigned long long userData);
+void uring_prep_cancel_fd(struct io_uring_sqe* sqe, int fd,
+    unsigned long long userData);
+void uring_prep_timeout(struct io_uring_sqe* sqe,
+    struct __kernel_timespec* timeout, unsigned long long userData);
+
+#endif
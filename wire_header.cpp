@@ -0,0 +1,153 @@
+#include "wire_header.h"
+
+#include <string.h>
+
+/**
+ * number of bytes that a varint takes, indexed by the number of significant
+ *   bits of its value.
+ */
+static const unsigned char VARINT_LEN[33] =
+{
+    1,1,1,1,1,1,1,1,
+    2,2,2,2,2,2,2,
+    3,3,3,3,3,3,3,
+    4,4,4,4,4,4,4,
+    5,5,5,5
+};
+
+/**
+ * bits of a value that a varint of the index's number of bytes holds.
+ */
+static const unsigned long long VARINT_MASK[6] =
+{
+    0,0x7fULL,0x3fffULL,0x1fffffULL,0xfffffffULL,0x7ffffffffULL
+};
+
+/**
+ * writes a frame header.
+ *
+ * @param header written to; must have room for WIRE_MAX_HEADER_LEN bytes,
+ *   even if the header turns out shorter.
+ * @param version WIRE_V0 or WIRE_V1.
+ * @param type message type; at most WIRE_MAX_TYPE for WIRE_V1.
+ * @param flags flags of the frame; always 0 for WIRE_V0.
+ * @param len payload length; must not be negative.
+ *
+ * @return number of bytes written.
+ */
+int wire_encode_header(char* header, int version, int type, int flags,
+    int len)
+{
+    if(version == WIRE_V0)
+    {
+        memcpy(header,&type,sizeof(type));
+        memcpy(header+sizeof(type),&len,sizeof(len));
+        return sizeof(type)+sizeof(len);
+    }
+
+    // the flags byte is only there when a flag is set
+    unsigned char* out = (unsigned char*) header;
+    int hasFlags = (flags != 0);
+    out[0] = (unsigned char) (type|(hasFlags ? WIRE_HAS_FLAGS : 0));
+    out[1] = (unsigned char) flags;
+    out += 1+hasFlags;
+
+    // every byte of the varint but the last has its top bit set; all five
+    // are written, so mixed lengths don't cost a mispredicted branch each
+    unsigned int value = (unsigned int) len;
+    int numBytes = VARINT_LEN[32-__builtin_clz(value|1)];
+    out[0] = (unsigned char) (value|0x80);
+    out[1] = (unsigned char) ((value >> 7)|0x80);
+    out[2] = (unsigned char) ((value >> 14)|0x80);
+    out[3] = (unsigned char) ((value >> 21)|0x80);
+    out[4] = (unsigned char) (value >> 28);
+    out[numBytes-1] &= 0x7f;
+
+    return 1+hasFlags+numBytes;
+}
+
+/**
+ * reads a frame header.
+ *
+ * @param header the bytes received so far, starting at the header.
+ * @param avail number of bytes in {header}.
+ * @param version WIRE_V0 or WIRE_V1.
+ * @param type set to the message type.
+ * @param flags set to the flags of the frame.
+ * @param len set to the payload length.
+ *
+ * @return length of the header; 0 if {avail} doesn't hold all of it yet, and
+ *   -1 if it is invalid.
+ */
+int wire_decode_header(const char* header, int avail, int version, int* type,
+    int* flags, int* len)
+{
+    if(version == WIRE_V0)
+    {
+        if(avail < (int) (sizeof(*type)+sizeof(*len)))
+        {
+            return 0;
+        }
+        memcpy(type,header,sizeof(*type));
+        memcpy(len,header+sizeof(*type),sizeof(*len));
+        *flags = 0;
+        return (*len < 0) ? -1 : (int) (sizeof(*type)+sizeof(*len));
+    }
+
+    const unsigned char* in = (const unsigned char*) header;
+    if(avail < 2)
+    {
+        return 0;
+    }
+    int hasFlags = (in[0]&WIRE_HAS_FLAGS) != 0;
+    *type = in[0]&WIRE_MAX_TYPE;
+    *flags = hasFlags ? in[1] : 0;
+    int pos = 1+hasFlags;
+
+    // with all five bytes a varint may take at hand, find its end from the
+    // continuation bits, and gather its groups without branching on them
+    if(avail-pos >= 5)
+    {
+        const unsigned char* bytes = in+pos;
+        unsigned int more = (bytes[0] >> 7)|(bytes[1] >> 7 << 1)|
+            (bytes[2] >> 7 << 2)|(bytes[3] >> 7 << 3)|(bytes[4] >> 7 << 4);
+        int numBytes = __builtin_ctz(~more)+1;
+        if(numBytes > 5)
+        {
+            return -1;
+        }
+        unsigned long long value = (unsigned long long) (bytes[0]&0x7f)|
+            (unsigned long long) (bytes[1]&0x7f) << 7|
+            (unsigned long long) (bytes[2]&0x7f) << 14|
+            (unsigned long long) (bytes[3]&0x7f) << 21|
+            (unsigned long long) bytes[4] << 28;
+        value &= VARINT_MASK[numBytes];
+        if(value > 0x7fffffff)
+        {
+            return -1;
+        }
+        *len = (int) value;
+        return pos+numBytes;
+    }
+
+    unsigned long long value = 0;
+    for(int shift = 0; shift < 35; shift += 7)
+    {
+        if(pos >= avail)
+        {
+            return 0;
+        }
+        unsigned char byte = in[pos++];
+        value |= (unsigned long long) (byte&0x7f) << shift;
+        if(byte < 0x80)
+        {
+            if(value > 0x7fffffff)
+            {
+                return -1;
+            }
+            *len = (int) value;
+            return pos;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,54 @@
+#ifndef _WIRE_HEADER_H_
+#define _WIRE_HEADER_H_
+
+/**
+ * original framing; the header is the message's type and len fields, as raw
+ *   host-endian ints.
+ */
+#define WIRE_V0 0
+
+/**
+ * compact framing; the header is a type byte, an optional flags byte, and the
+ *   payload length as a little-endian base 128 varint. every field is a
+ *   byte sequence, so it reads the same on any architecture.
+ */
+#define WIRE_V1 1
+
+/**
+ * newest framing that this build understands.
+ */
+#define WIRE_MAX_VERSION WIRE_V1
+
+/**
+ * most bytes that a header of any version takes.
+ */
+#define WIRE_MAX_HEADER_LEN 8
+
+/**
+ * largest message type that fits a WIRE_V1 header.
+ */
+#define WIRE_MAX_TYPE 0x7f
+
+/**
+ * set in a WIRE_V1 type byte when a flags byte follows it.
+ */
+#define WIRE_HAS_FLAGS 0x80
+
+/**
+ * set in a WIRE_V1 flags byte when the payload is compressed, as made by
+ *   frame_compress. only sent to peers that said they read it.
+ */
+#define WIRE_COMPRESSED 0x01
+
+/**
+ * flags that this build knows how to handle; frames with any other flag set
+ *   are invalid.
+ */
+#define WIRE_KNOWN_FLAGS WIRE_COMPRESSED
+
+int wire_encode_header(char* header, int version, int type, int flags,
+    int len);
+int wire_decode_header(const char* header, int avail, int version, int* type,
+    int* flags, int* len);
+
+#endif
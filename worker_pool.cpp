@@ -0,0 +1,193 @@
+#include "worker_pool.h"
+
+/**
+ * parameters of a worker thread.
+ */
+typedef struct
+{
+    Workers* workers;
+    int index;
+} WorkerParams;
+
+/**
+ * pool and index of the worker that the calling thread is, if any; tasks
+ *   submitted by a worker go onto its own deque.
+ */
+static thread_local Workers* curWorkers = 0;
+static thread_local int curIndex = 0;
+
+/**
+ * takes the newest task of the worker's own deque, or failing that, steals the
+ *   oldest task of another worker's deque.
+ *
+ * @return non-zero if a task was taken.
+ */
+static int take_task(Workers* workers, int self, Task* task)
+{
+    for(int i = 0; i < workers->numWorkers; ++i)
+    {
+        WorkDeque* deque = &workers->deques[(self+i)%workers->numWorkers];
+        int taken = 0;
+        pthread_mutex_lock(&deque->lock);
+        if(!deque->tasks.empty())
+        {
+            if(i == 0)
+            {
+                *task = deque->tasks.back();
+                deque->tasks.pop_back();
+            }
+            else
+            {
+                *task = deque->tasks.front();
+                deque->tasks.pop_front();
+            }
+            workers->numQueued.fetch_sub(1);
+            taken = 1;
+        }
+        pthread_mutex_unlock(&deque->lock);
+
+        if(taken)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * function run on each worker thread. it runs tasks until the pool is stopped
+ *   and every submitted task has run, sleeping whenever there are none.
+ *
+ * @param params points to the worker's WorkerParams.
+ */
+static void* worker_routine(void* params)
+{
+    WorkerParams* workerParams = (WorkerParams*) params;
+    Workers* workers = workerParams->workers;
+    int self = workerParams->index;
+    delete workerParams;
+
+    curWorkers = workers;
+    curIndex = self;
+
+    Task task;
+    while(1)
+    {
+        if(take_task(workers,self,&task))
+        {
+            task.func(task.arg);
+            continue;
+        }
+
+        // nothing to do; sleep until a task is submitted. numSleeping is
+        // raised before numQueued is checked, so a submitter either sees
+        // the sleeper, or the sleeper sees the task
+        pthread_mutex_lock(&workers->sleepLock);
+        workers->numSleeping.fetch_add(1);
+        while(workers->numQueued.load() == 0 && !workers->stopping)
+        {
+            pthread_cond_wait(&workers->wakeup,&workers->sleepLock);
+        }
+        workers->numSleeping.fetch_sub(1);
+        int terminate = workers->stopping && workers->numQueued.load() == 0;
+        pthread_mutex_unlock(&workers->sleepLock);
+
+        if(terminate)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * starts the worker threads of a pool.
+ *
+ * @param workers pool to start.
+ * @param numWorkers number of worker threads.
+ */
+void workers_start(Workers* workers, int numWorkers)
+{
+    workers->numWorkers = numWorkers;
+    workers->threads = new pthread_t[numWorkers];
+    workers->deques = new WorkDeque[numWorkers];
+    workers->numQueued = 0;
+    workers->numSleeping = 0;
+    workers->nextDeque = 0;
+    pthread_mutex_init(&workers->sleepLock,0);
+    pthread_cond_init(&workers->wakeup,0);
+    workers->stopping = 0;
+
+    for(int i = 0; i < numWorkers; ++i)
+    {
+        pthread_mutex_init(&workers->deques[i].lock,0);
+    }
+    for(int i = 0; i < numWorkers; ++i)
+    {
+        WorkerParams* params = new WorkerParams;
+        params->workers = workers;
+        params->index = i;
+        pthread_create(&workers->threads[i],0,worker_routine,params);
+    }
+}
+
+/**
+ * runs every task that is still queued, including the ones they submit, then
+ *   stops the worker threads.
+ *
+ * @param workers pool to stop.
+ */
+void workers_stop(Workers* workers)
+{
+    pthread_mutex_lock(&workers->sleepLock);
+    workers->stopping = 1;
+    pthread_cond_broadcast(&workers->wakeup);
+    pthread_mutex_unlock(&workers->sleepLock);
+
+    for(int i = 0; i < workers->numWorkers; ++i)
+    {
+        pthread_join(workers->threads[i],0);
+        pthread_mutex_destroy(&workers->deques[i].lock);
+    }
+    pthread_cond_destroy(&workers->wakeup);
+    pthread_mutex_destroy(&workers->sleepLock);
+    delete[] workers->deques;
+    delete[] workers->threads;
+    workers->deques = 0;
+    workers->threads = 0;
+    workers->numWorkers = 0;
+}
+
+/**
+ * queues a task to run on one of the pool's workers. a worker queues onto its
+ *   own deque; other threads spread their tasks round-robin. may be called
+ *   from any thread.
+ *
+ * @param workers pool to run the task on.
+ * @param func function to run.
+ * @param arg argument to pass to it.
+ */
+void workers_submit(Workers* workers, TaskFunc func, void* arg)
+{
+    int index = (curWorkers == workers) ? curIndex :
+        (int) (workers->nextDeque.fetch_add(1)%workers->numWorkers);
+
+    Task task;
+    task.func = func;
+    task.arg = arg;
+
+    WorkDeque* deque = &workers->deques[index];
+    pthread_mutex_lock(&deque->lock);
+    deque->tasks.push_back(task);
+    workers->numQueued.fetch_add(1);
+    pthread_mutex_unlock(&deque->lock);
+
+    // wake up a sleeping worker to run, or steal, the task
+    if(workers->numSleeping.load() > 0)
+    {
+        pthread_mutex_lock(&workers->sleepLock);
+        pthread_cond_signal(&workers->wakeup);
+        pthread_mutex_unlock(&workers->sleepLock);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#include <deque>
+#include <atomic>
+#include <pthread.h>
+
+typedef void (*TaskFunc)(void* arg);
+
+typedef struct
+{
+    TaskFunc func;          // function to run
+    void* arg;              // argument to pass to it
+} Task;
+
+/**
+ * tasks of one worker. the worker takes tasks from the back, so the task it
+ *   submitted last runs next, while its memory is still in the cache; idle
+ *   workers steal from the front.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    std::deque<Task> tasks;
+} WorkDeque;
+
+typedef struct
+{
+    int numWorkers;
+    pthread_t* threads;
+    WorkDeque* deques;              // one per worker
+    std::atomic<int> numQueued;     // tasks submitted, but not taken yet
+    std::atomic<int> numSleeping;   // workers waiting on wakeup
+    std::atomic<unsigned> nextDeque; // deque for the next outside submission
+    pthread_mutex_t sleepLock;      // guards wakeup and stopping
+    pthread_cond_t wakeup;
+    int stopping;                   // non-zero once workers_stop is called
+} Workers;
+
+void workers_start(Workers* workers, int numWorkers);
+void workers_stop(Workers* workers);
+void workers_submit(Workers* workers, TaskFunc func, void* arg);
+
+#endif